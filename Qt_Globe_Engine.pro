@@ -1,35 +1,13 @@
-QT       += core gui openglwidgets
-
-greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
-
-CONFIG += c++14
-
-# You can make your code fail to compile if it uses deprecated APIs.
-# In order to do so, uncomment the following line.
-#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
-
-SOURCES += \
-    camera.cpp \
-    globewidget.cpp \
-    main.cpp \
-    mainwindow.cpp \
-    planetgenerator.cpp \
-    shaderprogram.cpp
-
-HEADERS += \
-    camera.h \
-    globewidget.h \
-    mainwindow.h \
-    planetgenerator.h \
-    shaderprogram.h
-
-FORMS += \
-    mainwindow.ui
-
-# Default rules for deployment.
-qnx: target.path = /tmp/$${TARGET}/bin
-else: unix:!android: target.path = /opt/$${TARGET}/bin
-!isEmpty(target.path): INSTALLS += target
-
-RESOURCES += \
-    resources.qrc
+TEMPLATE = subdirs
+
+# The application and the tools that prepare its textures. The benchmarks stay standalone projects.
+SUBDIRS += \
+    app \
+    equirect_to_cubemap \
+    ktx_converter \
+    tilepack_builder
+
+app.file = app.pro
+equirect_to_cubemap.file = tools/equirect_to_cubemap.pro
+ktx_converter.file = tools/ktx_converter.pro
+tilepack_builder.file = tools/tilepack_builder.pro
@@ -0,0 +1,73 @@
+QT       += core gui openglwidgets
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+CONFIG += c++17
+
+TARGET = Qt_Globe_Engine
+
+# You can make your code fail to compile if it uses deprecated APIs.
+# In order to do so, uncomment the following line.
+#DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
+
+SOURCES += \
+    camera.cpp \
+    cameracontroller.cpp \
+    culling.cpp \
+    framestatistics.cpp \
+    globewidget.cpp \
+    ktxcubemap.cpp \
+    main.cpp \
+    mainwindow.cpp \
+    meshcache.cpp \
+    meshoptimization.cpp \
+    mipchain.cpp \
+    planetgenerator.cpp \
+    planetquadtree.cpp \
+    profiler.cpp \
+    programbinarycache.cpp \
+    renderqueue.cpp \
+    shaderprogram.cpp \
+    taskscheduler.cpp \
+    tilepack.cpp \
+    tilesource.cpp \
+    uniformbuffer.cpp \
+    vertexformat.cpp \
+    vertexkernels.cpp \
+    virtualtexture.cpp
+
+HEADERS += \
+    camera.h \
+    cameracontroller.h \
+    culling.h \
+    framestatistics.h \
+    globewidget.h \
+    ktxcubemap.h \
+    mainwindow.h \
+    meshcache.h \
+    meshoptimization.h \
+    mipchain.h \
+    planetgenerator.h \
+    planetquadtree.h \
+    profiler.h \
+    programbinarycache.h \
+    renderqueue.h \
+    shaderprogram.h \
+    taskscheduler.h \
+    tilepack.h \
+    tilesource.h \
+    uniformbuffer.h \
+    vertexformat.h \
+    vertexkernels.h \
+    virtualtexture.h
+
+FORMS += \
+    mainwindow.ui
+
+# Default rules for deployment.
+qnx: target.path = /tmp/$${TARGET}/bin
+else: unix:!android: target.path = /opt/$${TARGET}/bin
+!isEmpty(target.path): INSTALLS += target
+
+RESOURCES += \
+    resources.qrc
@@ -0,0 +1,84 @@
+#include "planetgenerator.h"
+#include "taskscheduler.h"
+#include "vertexkernels.h"
+
+#include <chrono>
+#include <cstdio>
+#include <thread>
+
+namespace
+{
+    constexpr uint32_t SUBDIVISION_COUNTS[] = { 15U, 127U, 511U, 1023U, 2047U };
+    constexpr auto REPETITIONS = 5U;
+}
+
+/**
+ * \brief The threading scheme generateSubdividedCube() used before the task scheduler: one freshly created
+ *        std::thread per face, joined at the end of every call.
+ */
+static std::pair<std::vector<float>, std::vector<uint32_t>>
+generate_with_thread_per_face(const uint32_t numberOfSubdivisions)
+{
+    const auto verticesPerSide = numberOfSubdivisions + 2U;
+
+    std::vector<float> vertices(((verticesPerSide * verticesPerSide * 3) * 6), 0.0f);
+    std::vector<uint32_t> indices((((verticesPerSide - 1) * (verticesPerSide - 1) * 6) * 6), 0UL);
+
+    std::vector<std::thread> threads;
+    for(auto face = 0U; face < NUMBER_OF_CUBE_FACES; ++face)
+    {
+        threads.emplace_back(generateCubeFaceRows, static_cast<CubeFace>(face), verticesPerSide, 0U, verticesPerSide,
+                             vertices.data(), indices.data());
+    }
+
+    for(auto& thread : threads)
+    {
+        thread.join();
+    }
+
+    return std::make_pair(std::move(vertices), std::move(indices));
+}
+
+/**
+ * \brief Returns the best of REPETITIONS runs of the generator, in milliseconds
+ */
+template<typename Generator>
+static double best_time(Generator generator)
+{
+    auto best = 0.0;
+
+    for(auto repetition = 0U; repetition < REPETITIONS; ++repetition)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const auto mesh = generator();
+        const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if(repetition == 0U || elapsed < best)
+        {
+            best = elapsed;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * \brief Compares the per-face threads against the work-stealing scheduler for a range of subdivision counts
+ */
+int main()
+{
+    auto& scheduler = TaskScheduler::instance();
+    std::printf("scheduler threads: %u\n", scheduler.numberOfThreads());
+    std::printf("vertex kernel: %s\n", vertexKernelName());
+    std::printf("%12s %18s %18s %10s\n", "subdivisions", "thread/face (ms)", "scheduler (ms)", "speedup");
+
+    for(const auto subdivisions : SUBDIVISION_COUNTS)
+    {
+        const auto baseline = best_time([subdivisions]() { return generate_with_thread_per_face(subdivisions); });
+        const auto pooled = best_time([subdivisions, &scheduler]() { return generateSubdividedCube(subdivisions, scheduler); });
+
+        std::printf("%12u %18.3f %18.3f %9.2fx\n", subdivisions, baseline, pooled, baseline / pooled);
+    }
+
+    return 0;
+}
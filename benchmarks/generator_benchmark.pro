@@ -0,0 +1,19 @@
+QT       += core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = generator_benchmark
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    generator_benchmark.cpp \
+    ../planetgenerator.cpp \
+    ../taskscheduler.cpp \
+    ../vertexkernels.cpp
+
+HEADERS += \
+    ../planetgenerator.h \
+    ../taskscheduler.h \
+    ../vertexkernels.h
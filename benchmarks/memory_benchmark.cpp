@@ -0,0 +1,117 @@
+#include "planetgenerator.h"
+
+#include <QCoreApplication>
+#include <QProcess>
+#include <QStringList>
+
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace
+{
+    constexpr uint32_t SUBDIVISION_COUNTS[] = { 127U, 511U, 1023U, 2047U };
+
+    const auto VECTOR_PATH = QStringLiteral("vector");
+    const auto CALLER_BUFFER_PATH = QStringLiteral("caller");
+}
+
+/**
+ * \brief Peak resident set size of this process so far, in kilobytes
+ */
+static uint64_t peak_resident_kilobytes()
+{
+#ifdef Q_OS_WIN
+    PROCESS_MEMORY_COUNTERS counters;
+    GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters));
+    return counters.PeakWorkingSetSize / 1024U;
+#else
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef Q_OS_MACOS
+    return static_cast<uint64_t>(usage.ru_maxrss) / 1024U; // bytes on macOS
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#endif
+#endif
+}
+
+/**
+ * \brief Builds the mesh one way into destination buffers that stand in for the storage glBufferData() or a
+ *        mapped buffer provides, then prints the peak RSS. Run in a child process so each path starts clean.
+ */
+static int measure_path(const QString& path, const uint32_t subdivisions)
+{
+    const auto vertexCount = subdividedCubeVertexCount(subdivisions) * 3UL;
+    const auto indexCount = subdividedCubeIndexCount(subdivisions);
+
+    // Deliberately uninitialized, so pages only become resident when the mesh is written into them
+    std::unique_ptr<float[]> vertexDestination(new float[vertexCount]);
+    std::unique_ptr<uint32_t[]> indexDestination(new uint32_t[indexCount]);
+
+    if(path == VECTOR_PATH)
+    {
+        // What initializePlanetMesh() did before: generate into vectors, then allocate() copies them
+        const auto [vertices, indices] = generateSubdividedCube(subdivisions);
+        std::memcpy(vertexDestination.get(), vertices.data(), vertices.size() * sizeof(float));
+        std::memcpy(indexDestination.get(), indices.data(), indices.size() * sizeof(uint32_t));
+    }
+    else if(!generateSubdividedCubeInto(subdivisions,
+                                        vertexDestination.get(), vertexCount,
+                                        indexDestination.get(), indexCount))
+    {
+        return 1;
+    }
+
+    std::printf("%llu\n", static_cast<unsigned long long>(peak_resident_kilobytes()));
+    return 0;
+}
+
+/**
+ * \brief Runs this executable again to measure one path and returns its peak RSS in kilobytes
+ */
+static uint64_t measure_in_child(const QString& path, const uint32_t subdivisions)
+{
+    QProcess child;
+    child.start(QCoreApplication::applicationFilePath(), { path, QString::number(subdivisions) });
+    child.waitForFinished(-1);
+
+    return child.readAllStandardOutput().trimmed().toULongLong();
+}
+
+/**
+ * \brief Compares the peak memory of generating into vectors and copying against generating into caller memory
+ */
+int main(int argc, char* argv[])
+{
+    QCoreApplication application(argc, argv);
+    const auto arguments = application.arguments();
+
+    if(arguments.size() == 3)
+    {
+        return measure_path(arguments.at(1), arguments.at(2).toUInt());
+    }
+
+    std::printf("%12s %12s %18s %18s\n", "subdivisions", "mesh (MB)", "vector peak (MB)", "caller peak (MB)");
+
+    for(const auto subdivisions : SUBDIVISION_COUNTS)
+    {
+        const auto meshBytes = (subdividedCubeVertexCount(subdivisions) * 3UL * sizeof(float)) +
+                               (subdividedCubeIndexCount(subdivisions) * sizeof(uint32_t));
+
+        const auto vectorPeak = measure_in_child(VECTOR_PATH, subdivisions);
+        const auto callerPeak = measure_in_child(CALLER_BUFFER_PATH, subdivisions);
+
+        std::printf("%12u %12.1f %18.1f %18.1f\n", subdivisions, meshBytes / (1024.0 * 1024.0),
+                    vectorPeak / 1024.0, callerPeak / 1024.0);
+    }
+
+    return 0;
+}
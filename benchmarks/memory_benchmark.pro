@@ -0,0 +1,21 @@
+QT       += core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = memory_benchmark
+
+INCLUDEPATH += ..
+
+win32: LIBS += -lpsapi
+
+SOURCES += \
+    memory_benchmark.cpp \
+    ../planetgenerator.cpp \
+    ../taskscheduler.cpp \
+    ../vertexkernels.cpp
+
+HEADERS += \
+    ../planetgenerator.h \
+    ../taskscheduler.h \
+    ../vertexkernels.h
@@ -0,0 +1,333 @@
+#include "camera.h"
+#include "cameracontroller.h"
+#include "culling.h"
+#include "planetgenerator.h"
+#include "taskscheduler.h"
+#include "vertexkernels.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t SUBDIVISION_COUNTS[] = { 15U, 127U, 511U, 1023U, 2047U, 4096U };
+
+    // The largest meshes take seconds and gigabytes each, so they are only timed once
+    constexpr auto REPETITIONS = 5U;
+    constexpr auto LARGE_MESH_REPETITIONS = 1U;
+    constexpr auto LARGE_MESH_SUBDIVISIONS = 2047U;
+
+    // Camera math is timed over a ring of positions so that no two neighbouring calls see the same input
+    constexpr auto CAMERA_ITERATIONS = 1000000U;
+    constexpr auto CAMERA_POSITIONS = 1024U;
+    constexpr auto CAMERA_ASPECT_RATIO = 16.0f / 9.0f;
+    constexpr auto CAMERA_FIELD_OF_VIEW = 20.0f;
+    constexpr auto CAMERA_NEAR_PLANE_DISTANCE = 0.1f;
+    constexpr auto CAMERA_FAR_PLANE_DISTANCE = 10.0f;
+    constexpr auto CAMERA_FRAME_TIME = 1.0f / 60.0f; // seconds
+
+    constexpr auto BYTES_PER_MEGABYTE = 1024.0 * 1024.0;
+
+    // Every allocation made through operator new on any thread, which covers the vectors the generator returns
+    // and the tasks the scheduler queues
+    std::atomic<uint64_t> s_numberOfAllocations{0U};
+    std::atomic<uint64_t> s_allocatedBytes{0U};
+
+    // Keeps the results of the camera math alive so the compiler can't drop the calls
+    volatile float s_sink = 0.0f;
+}
+
+void* operator new(const std::size_t size)
+{
+    ++s_numberOfAllocations;
+    s_allocatedBytes += size;
+
+    if(auto* memory = std::malloc((size > 0U) ? size : 1U))
+    {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+/**
+ * \brief Counts the allocations made since it was constructed
+ */
+class AllocationCounter
+{
+public:
+    AllocationCounter() :
+        m_numberOfAllocations{s_numberOfAllocations.load()},
+        m_allocatedBytes{s_allocatedBytes.load()}
+    {
+
+    }
+
+    uint64_t numberOfAllocations() const
+    {
+        return s_numberOfAllocations.load() - m_numberOfAllocations;
+    }
+
+    uint64_t allocatedBytes() const
+    {
+        return s_allocatedBytes.load() - m_allocatedBytes;
+    }
+
+private:
+    uint64_t m_numberOfAllocations;
+    uint64_t m_allocatedBytes;
+};
+
+/**
+ * \brief Best time of a number of calls, and what the first call allocated
+ */
+struct Measurement
+{
+    double milliseconds;
+    uint64_t numberOfAllocations;
+    uint64_t allocatedBytes;
+};
+
+template<typename Body>
+static Measurement measure(const uint32_t repetitions, Body body)
+{
+    Measurement measurement{ 0.0, 0U, 0U };
+
+    for(auto repetition = 0U; repetition < repetitions; ++repetition)
+    {
+        const AllocationCounter allocations;
+        const auto start = std::chrono::steady_clock::now();
+
+        body();
+
+        const auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        if(repetition == 0U)
+        {
+            measurement = { elapsed, allocations.numberOfAllocations(), allocations.allocatedBytes() };
+        }
+        else if(elapsed < measurement.milliseconds)
+        {
+            measurement.milliseconds = elapsed;
+        }
+    }
+
+    return measurement;
+}
+
+/**
+ * \brief 1, 2, 4, ... up to and always including maximumThreads
+ */
+static std::vector<uint32_t> thread_counts(const uint32_t maximumThreads)
+{
+    std::vector<uint32_t> counts;
+    for(auto threads = 1U; threads < maximumThreads; threads *= 2U)
+    {
+        counts.push_back(threads);
+    }
+    counts.push_back(maximumThreads);
+
+    return counts;
+}
+
+static void print_generation_row(const uint32_t subdivisions, const uint32_t threads, const char* path,
+                                 const Measurement& measurement)
+{
+    const auto vertices = static_cast<double>(subdividedCubeVertexCount(subdivisions));
+    const auto bytes = (vertices * 3.0 * sizeof(float)) +
+                       (static_cast<double>(subdividedCubeIndexCount(subdivisions)) * sizeof(uint32_t));
+    const auto seconds = measurement.milliseconds / 1000.0;
+
+    std::printf("%12u %8u %8s %12.3f %14.1f %12.1f %12llu %14.1f\n", subdivisions, threads, path,
+                measurement.milliseconds, (vertices / seconds) / 1.0e6, (bytes / seconds) / BYTES_PER_MEGABYTE,
+                static_cast<unsigned long long>(measurement.numberOfAllocations),
+                measurement.allocatedBytes / BYTES_PER_MEGABYTE);
+}
+
+/**
+ * \brief Times generateSubdividedCube(), which allocates the vectors it returns, and generateSubdividedCubeInto(),
+ *        which writes into buffers allocated once up front, for every subdivision count and thread count
+ */
+static void benchmark_generation(const uint32_t maximumSubdivisions, const uint32_t maximumThreads)
+{
+    std::printf("vertex kernel: %s\n", vertexKernelName());
+    std::printf("%12s %8s %8s %12s %14s %12s %12s %14s\n", "subdivisions", "threads", "path", "best (ms)",
+                "vertices (M/s)", "bytes (MB/s)", "allocs/call", "alloc MB/call");
+
+    for(const auto subdivisions : SUBDIVISION_COUNTS)
+    {
+        if(subdivisions > maximumSubdivisions)
+        {
+            continue;
+        }
+
+        const auto repetitions = (subdivisions >= LARGE_MESH_SUBDIVISIONS) ? LARGE_MESH_REPETITIONS : REPETITIONS;
+
+        for(const auto threads : thread_counts(maximumThreads))
+        {
+            // The calling thread works too, so one worker fewer than the thread count
+            TaskScheduler scheduler(threads - 1U);
+
+            const auto returned = measure(repetitions, [&]()
+            {
+                const auto mesh = generateSubdividedCube(subdivisions, scheduler);
+                s_sink = mesh.first.back();
+            });
+            print_generation_row(subdivisions, threads, "vector", returned);
+        }
+
+        // Only allocated once the vectors are gone, so the largest mesh never needs room for two copies. Zeroed so
+        // that every page is resident before timing, as a mapped GL buffer would be.
+        const auto vertexCapacity = subdividedCubeVertexCount(subdivisions) * 3U;
+        const auto indexCapacity = subdividedCubeIndexCount(subdivisions);
+
+        std::unique_ptr<float[]> vertices(new float[vertexCapacity]());
+        std::unique_ptr<uint32_t[]> indices(new uint32_t[indexCapacity]());
+
+        for(const auto threads : thread_counts(maximumThreads))
+        {
+            TaskScheduler scheduler(threads - 1U);
+
+            const auto written = measure(repetitions, [&]()
+            {
+                generateSubdividedCubeInto(subdivisions, vertices.get(), vertexCapacity, indices.get(), indexCapacity,
+                                           scheduler);
+                s_sink = vertices[vertexCapacity - 1U];
+            });
+            print_generation_row(subdivisions, threads, "into", written);
+        }
+    }
+}
+
+static void print_camera_row(const char* name, const Measurement& measurement)
+{
+    const auto nanoseconds = (measurement.milliseconds * 1.0e6) / CAMERA_ITERATIONS;
+
+    std::printf("%-34s %12.2f %14.2f %12.3f\n", name, nanoseconds, 1000.0 / nanoseconds,
+                static_cast<double>(measurement.numberOfAllocations) / CAMERA_ITERATIONS);
+}
+
+/**
+ * \brief Times the per-frame camera math: placing the orbiting camera, building its view and projection matrices
+ *        and the frustum culled against, each over CAMERA_ITERATIONS calls
+ */
+static void benchmark_camera()
+{
+    std::vector<QVector3D> positions;
+    positions.reserve(CAMERA_POSITIONS);
+
+    CameraController controller;
+    controller.setRotationInput(1.0f, 0.5f);
+    for(auto i = 0U; i < CAMERA_POSITIONS; ++i)
+    {
+        controller.advance(CAMERA_FRAME_TIME);
+        positions.push_back(controller.position());
+    }
+
+    Camera camera(0.0f, 0.0f, 0.0f);
+    camera.setFieldOfView(CAMERA_FIELD_OF_VIEW);
+    camera.setDistanceToNearPlane(CAMERA_NEAR_PLANE_DISTANCE);
+    camera.setDistanceToFarPlane(CAMERA_FAR_PLANE_DISTANCE);
+
+    std::printf("%-34s %12s %14s %12s\n", "camera math", "ns/call", "calls (M/s)", "allocs/call");
+
+    print_camera_row("CameraController::advance+position", measure(REPETITIONS, [&]()
+    {
+        for(auto i = 0U; i < CAMERA_ITERATIONS; ++i)
+        {
+            controller.setRotationInput(((i & 1U) != 0U) ? 1.0f : -1.0f, 0.0f);
+            controller.advance(CAMERA_FRAME_TIME);
+            s_sink = controller.position().x();
+        }
+    }));
+
+    print_camera_row("Camera::viewMatrixAtPosition", measure(REPETITIONS, [&]()
+    {
+        for(auto i = 0U; i < CAMERA_ITERATIONS; ++i)
+        {
+            camera.setPosition(positions[i % CAMERA_POSITIONS]);
+            s_sink = camera.viewMatrixAtPosition()(0, 0);
+        }
+    }));
+
+    print_camera_row("Camera::projectionMatrix", measure(REPETITIONS, [&]()
+    {
+        for(auto i = 0U; i < CAMERA_ITERATIONS; ++i)
+        {
+            s_sink = camera.projectionMatrix(CAMERA_ASPECT_RATIO + (i % CAMERA_POSITIONS) * 1.0e-6f)(0, 0);
+        }
+    }));
+
+    print_camera_row("model-view-projection", measure(REPETITIONS, [&]()
+    {
+        for(auto i = 0U; i < CAMERA_ITERATIONS; ++i)
+        {
+            camera.setPosition(positions[i % CAMERA_POSITIONS]);
+            const auto modelViewProjection = camera.projectionMatrix(CAMERA_ASPECT_RATIO) *
+                                             camera.viewMatrixAtPosition() * QMatrix4x4();
+            s_sink = modelViewProjection(0, 0);
+        }
+    }));
+
+    print_camera_row("ViewFrustum construction", measure(REPETITIONS, [&]()
+    {
+        const auto projection = camera.projectionMatrix(CAMERA_ASPECT_RATIO);
+        for(auto i = 0U; i < CAMERA_ITERATIONS; ++i)
+        {
+            camera.setPosition(positions[i % CAMERA_POSITIONS]);
+            const ViewFrustum frustum(projection * camera.viewMatrixAtPosition());
+            s_sink = frustum.intersectsSphere(QVector3D(), 1.0f) ? 1.0f : 0.0f;
+        }
+    }));
+}
+
+/**
+ * \brief Micro-benchmarks for mesh generation, across subdivision and thread counts, and for the camera math
+ *        done every frame. Takes an optional --max-subdivisions n, since 4096 subdivisions need about 3.6 GB,
+ *        and --threads n to cap the thread counts at something other than the hardware threads.
+ */
+int main(int argc, char* argv[])
+{
+    auto maximumSubdivisions = SUBDIVISION_COUNTS[(sizeof(SUBDIVISION_COUNTS) / sizeof(uint32_t)) - 1U];
+    auto maximumThreads = qMax(std::thread::hardware_concurrency(), 1U);
+
+    for(auto i = 1; i < argc; ++i)
+    {
+        if(std::strcmp(argv[i], "--max-subdivisions") == 0 && i + 1 < argc)
+        {
+            maximumSubdivisions = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if(std::strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            maximumThreads = qMax(static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10)), 1U);
+        }
+        else
+        {
+            std::fprintf(stderr, "usage: micro_benchmark [--max-subdivisions n] [--threads n]\n");
+            return 1;
+        }
+    }
+
+    benchmark_generation(maximumSubdivisions, maximumThreads);
+    std::printf("\n");
+    benchmark_camera();
+
+    return 0;
+}
@@ -0,0 +1,25 @@
+QT       += core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = micro_benchmark
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    micro_benchmark.cpp \
+    ../camera.cpp \
+    ../cameracontroller.cpp \
+    ../culling.cpp \
+    ../planetgenerator.cpp \
+    ../taskscheduler.cpp \
+    ../vertexkernels.cpp
+
+HEADERS += \
+    ../camera.h \
+    ../cameracontroller.h \
+    ../culling.h \
+    ../planetgenerator.h \
+    ../taskscheduler.h \
+    ../vertexkernels.h
@@ -0,0 +1,407 @@
+#include "globewidget.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOpenGLContext>
+#include <QSurfaceFormat>
+#include <QtMath>
+
+namespace
+{
+    constexpr auto DEFAULT_WIDTH = 1280;
+    constexpr auto DEFAULT_HEIGHT = 720;
+    constexpr auto DEFAULT_FRAMES = 600U;
+
+    // Rendered at the start of the path before timing begins, while the first chunks and tiles are built
+    constexpr auto WARM_UP_FRAMES = 10U;
+
+    // The path circles the globe twice while nodding up and down three times, and dives from high above it to
+    // low orbit and back twice, so every kind of chunk split, merge and tile request is exercised
+    constexpr auto PATH_TURNS = 2.0f;
+    constexpr auto PATH_START_AZIMUTH = -180.0f; // degrees
+    constexpr auto PATH_ELEVATION_AMPLITUDE = 60.0f; // degrees
+    constexpr auto PATH_ELEVATION_CYCLES = 3.0f;
+    constexpr auto PATH_NEAREST_RADIUS = 2.4f;
+    constexpr auto PATH_FARTHEST_RADIUS = 7.5f;
+    constexpr auto PATH_RADIUS_CYCLES = 2.0f;
+
+    constexpr double FRAME_TIME_PERCENTILES[] = { 50.0, 95.0, 99.0 };
+
+    constexpr auto NANOSECONDS_PER_MILLISECOND = 1.0e6;
+}
+
+struct CameraPose
+{
+    float azimuth;   // degrees
+    float elevation; // degrees
+    float radius;
+};
+
+/**
+ * \brief Camera pose at a point along the scripted path, progress running from 0 to 1
+ */
+static CameraPose scripted_camera_pose(const float progress)
+{
+    const auto angle = qDegreesToRadians(360.0f * progress);
+    const auto middleRadius = (PATH_NEAREST_RADIUS + PATH_FARTHEST_RADIUS) / 2.0f;
+    const auto radiusAmplitude = (PATH_FARTHEST_RADIUS - PATH_NEAREST_RADIUS) / 2.0f;
+
+    return { PATH_START_AZIMUTH + (360.0f * PATH_TURNS * progress),
+             PATH_ELEVATION_AMPLITUDE * std::sin(PATH_ELEVATION_CYCLES * angle),
+             middleRadius + (radiusAmplitude * std::cos(PATH_RADIUS_CYCLES * angle)) };
+}
+
+/**
+ * \brief The globe widget, never shown. Grabbing its framebuffer makes Qt create its context on an offscreen
+ *        surface and render into its framebuffer object, after which frames are drawn straight into that object.
+ */
+class BenchmarkGlobeWidget : public GlobeWidget
+{
+public:
+    using GlobeWidget::GlobeWidget;
+
+    double renderFrame();
+};
+
+/**
+ * \brief Draws one frame and waits for the GPU to finish it. Returns the milliseconds that took.
+ */
+double BenchmarkGlobeWidget::renderFrame()
+{
+    makeCurrent();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    paintGL();
+    context()->functions()->glFinish();
+
+    const auto milliseconds = timer.nsecsElapsed() / NANOSECONDS_PER_MILLISECOND;
+
+    doneCurrent();
+    return milliseconds;
+}
+
+/**
+ * \brief Nearest-rank percentile of an ascending list of frame times
+ */
+static double percentile(const std::vector<double>& sortedFrameTimes, const double percent)
+{
+    const auto rank = static_cast<size_t>(std::ceil((percent / 100.0) * sortedFrameTimes.size()));
+    return sortedFrameTimes[qBound<size_t>(1U, rank, sortedFrameTimes.size()) - 1U];
+}
+
+/**
+ * \brief Time spent in each initialization span, summed over the spans of the same name. The GUI thread, the
+ *        GPU and the worker threads are kept apart, since the worker spans overlap each other.
+ */
+static QJsonObject startup_breakdown(const uint32_t guiTrack, const double totalMilliseconds)
+{
+    std::map<QString, double> guiThread;
+    std::map<QString, double> workers;
+    std::map<QString, double> gpu;
+
+    for(const auto& event : Profiler::instance().events())
+    {
+        if(event.frame != 0U)
+        {
+            continue;
+        }
+
+        auto& spans = (event.track == guiTrack) ? guiThread : (event.track == PROFILER_GPU_TRACK) ? gpu : workers;
+        spans[QString::fromLatin1(event.name)] += event.duration / NANOSECONDS_PER_MILLISECOND;
+    }
+
+    const auto toJson = [](const std::map<QString, double>& spans)
+    {
+        QJsonObject object;
+        for(const auto& span : spans)
+        {
+            object.insert(span.first, span.second);
+        }
+        return object;
+    };
+
+    return QJsonObject{
+        { "totalMilliseconds", totalMilliseconds },
+        { "guiThreadMilliseconds", toJson(guiThread) },
+        { "workerThreadMilliseconds", toJson(workers) },
+        { "gpuMilliseconds", toJson(gpu) }
+    };
+}
+
+/**
+ * \brief Prints how the frame time percentiles moved against an earlier report
+ */
+static void compare_with_baseline(const QString& path, const QJsonObject& frameTimes)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        std::fprintf(stderr, "could not read the baseline %s\n", qPrintable(path));
+        return;
+    }
+
+    const auto baseline = QJsonDocument::fromJson(file.readAll()).object().value("frameTimeMilliseconds").toObject();
+
+    for(const auto percent : FRAME_TIME_PERCENTILES)
+    {
+        const auto key = QStringLiteral("p%1").arg(percent);
+        const auto before = baseline.value(key).toDouble();
+        const auto after = frameTimes.value(key).toDouble();
+
+        if(before > 0.0)
+        {
+            std::fprintf(stderr, "%s: %.3f ms -> %.3f ms (%+.1f%%)\n", qPrintable(key), before, after,
+                         ((after - before) / before) * 100.0);
+        }
+    }
+}
+
+/**
+ * \brief Flies the camera along a scripted path through an offscreen GlobeWidget and reports the frame time
+ *        percentiles, the triangles and state changes submitted and how long startup took as JSON. Needs no
+ *        display, the offscreen platform is used unless QT_QPA_PLATFORM says otherwise.
+ */
+int main(int argc, char* argv[])
+{
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+    {
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
+
+    // The same context the application asks for, without waiting for vsync
+    QSurfaceFormat format;
+    format.setDepthBufferSize(24);
+    format.setStencilBufferSize(8);
+    format.setVersion(4, 1);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setSwapInterval(0);
+    QSurfaceFormat::setDefaultFormat(format);
+
+    QApplication application(argc, argv);
+    auto arguments = application.arguments();
+    arguments.removeFirst();
+
+    auto width = DEFAULT_WIDTH;
+    auto height = DEFAULT_HEIGHT;
+    auto numberOfFrames = DEFAULT_FRAMES;
+    auto levelOfDetail = true;
+    auto proceduralMesh = false;
+    QString outputPath;
+    QString baselinePath;
+
+    for(auto i = 0; i < arguments.size();)
+    {
+        const auto& argument = arguments.at(i);
+        const auto hasValue = (i + 1 < arguments.size());
+
+        if(argument == QStringLiteral("--fixed-mesh"))
+        {
+            levelOfDetail = false;
+            arguments.removeAt(i);
+        }
+        else if(argument == QStringLiteral("--procedural-mesh"))
+        {
+            levelOfDetail = false;
+            proceduralMesh = true;
+            arguments.removeAt(i);
+        }
+        else if(argument == QStringLiteral("--frames") && hasValue)
+        {
+            numberOfFrames = arguments.at(i + 1).toUInt();
+            arguments.removeAt(i);
+            arguments.removeAt(i);
+        }
+        else if(argument == QStringLiteral("--width") && hasValue)
+        {
+            width = arguments.at(i + 1).toInt();
+            arguments.removeAt(i);
+            arguments.removeAt(i);
+        }
+        else if(argument == QStringLiteral("--height") && hasValue)
+        {
+            height = arguments.at(i + 1).toInt();
+            arguments.removeAt(i);
+            arguments.removeAt(i);
+        }
+        else if(argument == QStringLiteral("--output") && hasValue)
+        {
+            outputPath = arguments.at(i + 1);
+            arguments.removeAt(i);
+            arguments.removeAt(i);
+        }
+        else if(argument == QStringLiteral("--baseline") && hasValue)
+        {
+            baselinePath = arguments.at(i + 1);
+            arguments.removeAt(i);
+            arguments.removeAt(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    if(!arguments.isEmpty() || numberOfFrames == 0U || width <= 0 || height <= 0)
+    {
+        std::fprintf(stderr, "usage: render_benchmark [--frames n] [--width n] [--height n] [--fixed-mesh] "
+                             "[--procedural-mesh] [--output report.json] [--baseline report.json]\n");
+        return 1;
+    }
+
+    BenchmarkGlobeWidget widget;
+    widget.resize(width, height);
+    const auto start = scripted_camera_pose(0.0f);
+    widget.setCameraPose(start.azimuth, start.elevation, start.radius);
+    if(!levelOfDetail)
+    {
+        widget.disableLevelOfDetail();
+    }
+
+    if(proceduralMesh)
+    {
+        widget.enableProceduralPlanetMesh();
+    }
+
+    // Creates the context and runs initializeGL(), then draws the first frame
+    QElapsedTimer startupTimer;
+    startupTimer.start();
+
+    if(widget.grabFramebuffer().isNull() || widget.context() == nullptr)
+    {
+        std::fprintf(stderr, "could not create an OpenGL 4.1 context, on a host without OpenGL in the offscreen "
+                             "platform try running under xvfb-run\n");
+        return 1;
+    }
+
+    const auto startupMilliseconds = startupTimer.nsecsElapsed() / NANOSECONDS_PER_MILLISECOND;
+
+    widget.makeCurrent();
+    auto* functions = widget.context()->functions();
+    const auto renderer = QString::fromLatin1(reinterpret_cast<const char*>(functions->glGetString(GL_RENDERER)));
+    const auto version = QString::fromLatin1(reinterpret_cast<const char*>(functions->glGetString(GL_VERSION)));
+    widget.doneCurrent();
+
+    for(auto frame = 0U; frame < WARM_UP_FRAMES; ++frame)
+    {
+        widget.renderFrame();
+    }
+
+    std::vector<double> frameTimes;
+    frameTimes.reserve(numberOfFrames);
+
+    auto totalTriangles = uint64_t{0};
+    auto maximumTriangles = 0U;
+
+    auto totalDraws = uint64_t{0};
+    auto totalStateChanges = uint64_t{0};
+    auto totalSkippedChanges = uint64_t{0};
+
+    for(auto frame = 0U; frame < numberOfFrames; ++frame)
+    {
+        const auto pose = scripted_camera_pose(static_cast<float>(frame) / numberOfFrames);
+        widget.setCameraPose(pose.azimuth, pose.elevation, pose.radius);
+
+        frameTimes.push_back(widget.renderFrame());
+
+        totalTriangles += widget.numberOfTrianglesSubmitted();
+        maximumTriangles = qMax(maximumTriangles, widget.numberOfTrianglesSubmitted());
+
+        const auto& statistics = widget.renderStatistics();
+        totalDraws += statistics.numberOfDraws;
+        totalStateChanges += statistics.stateChanges();
+        totalSkippedChanges += statistics.skippedChanges;
+    }
+
+    // Closes the last frame of the path so that the summary counts it. The GPU timings of the last few frames are
+    // still in flight and left out.
+    Profiler::instance().beginFrame();
+    const auto spans = Profiler::instance().summary(numberOfFrames);
+
+    auto sortedFrameTimes = frameTimes;
+    std::sort(sortedFrameTimes.begin(), sortedFrameTimes.end());
+
+    auto totalFrameTime = 0.0;
+    for(const auto frameTime : frameTimes)
+    {
+        totalFrameTime += frameTime;
+    }
+
+    QJsonObject frameTimeReport{
+        { "mean", totalFrameTime / numberOfFrames },
+        { "min", sortedFrameTimes.front() },
+        { "max", sortedFrameTimes.back() }
+    };
+
+    for(const auto percent : FRAME_TIME_PERCENTILES)
+    {
+        frameTimeReport.insert(QStringLiteral("p%1").arg(percent), percentile(sortedFrameTimes, percent));
+    }
+
+    QJsonArray spanReport;
+    for(const auto& span : spans)
+    {
+        spanReport.append(QJsonObject{
+            { "name", QString::fromLatin1(span.name) },
+            { "gpu", span.gpu },
+            { "averageMilliseconds", span.averageMilliseconds },
+            { "maximumMilliseconds", span.maximumMilliseconds }
+        });
+    }
+
+    const QJsonObject report{
+        { "renderer", renderer },
+        { "version", version },
+        { "width", width },
+        { "height", height },
+        { "levelOfDetail", levelOfDetail },
+        { "proceduralMesh", proceduralMesh },
+        { "frames", static_cast<int>(numberOfFrames) },
+        { "frameTimeMilliseconds", frameTimeReport },
+        { "trianglesSubmitted", QJsonObject{
+            { "total", static_cast<qint64>(totalTriangles) },
+            { "meanPerFrame", static_cast<double>(totalTriangles) / numberOfFrames },
+            { "maximumPerFrame", static_cast<qint64>(maximumTriangles) }
+        } },
+        { "renderState", QJsonObject{
+            { "drawsPerFrame", static_cast<double>(totalDraws) / numberOfFrames },
+            { "stateChangesPerFrame", static_cast<double>(totalStateChanges) / numberOfFrames },
+            { "skippedChangesPerFrame", static_cast<double>(totalSkippedChanges) / numberOfFrames }
+        } },
+        { "startup", startup_breakdown(Profiler::instance().currentTrack(), startupMilliseconds) },
+        { "spans", spanReport }
+    };
+
+    const auto json = QJsonDocument(report).toJson(QJsonDocument::Indented);
+
+    if(outputPath.isEmpty())
+    {
+        std::fwrite(json.constData(), 1, json.size(), stdout);
+    }
+    else
+    {
+        QFile output(outputPath);
+        if(!output.open(QIODevice::WriteOnly) || output.write(json) != json.size())
+        {
+            std::fprintf(stderr, "could not write %s\n", qPrintable(outputPath));
+            return 1;
+        }
+    }
+
+    if(!baselinePath.isEmpty())
+    {
+        compare_with_baseline(baselinePath, frameTimeReport);
+    }
+
+    return 0;
+}
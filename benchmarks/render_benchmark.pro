@@ -0,0 +1,60 @@
+QT       += core gui widgets openglwidgets
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = render_benchmark
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    render_benchmark.cpp \
+    ../camera.cpp \
+    ../cameracontroller.cpp \
+    ../culling.cpp \
+    ../framestatistics.cpp \
+    ../globewidget.cpp \
+    ../ktxcubemap.cpp \
+    ../meshcache.cpp \
+    ../meshoptimization.cpp \
+    ../mipchain.cpp \
+    ../planetgenerator.cpp \
+    ../planetquadtree.cpp \
+    ../profiler.cpp \
+    ../programbinarycache.cpp \
+    ../renderqueue.cpp \
+    ../shaderprogram.cpp \
+    ../taskscheduler.cpp \
+    ../tilepack.cpp \
+    ../tilesource.cpp \
+    ../uniformbuffer.cpp \
+    ../vertexformat.cpp \
+    ../vertexkernels.cpp \
+    ../virtualtexture.cpp
+
+HEADERS += \
+    ../camera.h \
+    ../cameracontroller.h \
+    ../culling.h \
+    ../framestatistics.h \
+    ../globewidget.h \
+    ../ktxcubemap.h \
+    ../meshcache.h \
+    ../meshoptimization.h \
+    ../mipchain.h \
+    ../planetgenerator.h \
+    ../planetquadtree.h \
+    ../profiler.h \
+    ../programbinarycache.h \
+    ../renderqueue.h \
+    ../shaderprogram.h \
+    ../taskscheduler.h \
+    ../tilepack.h \
+    ../tilesource.h \
+    ../uniformbuffer.h \
+    ../vertexformat.h \
+    ../vertexkernels.h \
+    ../virtualtexture.h
+
+RESOURCES += \
+    ../resources.qrc
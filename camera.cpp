@@ -1,5 +1,7 @@
 #include "camera.h"
 
+#include <QtMath>
+
 namespace
 {
     QVector3D ORIGIN { 0.0f, 0.0f, 0.0f };
@@ -52,6 +54,15 @@ QMatrix4x4 Camera::projectionMatrix(const float aspectRatio) const
     return projection;
 }
 
+/**
+ * \brief Number of pixels covered by one world unit placed one unit in front of the camera. Dividing a
+ *        world space length by its distance to the camera and multiplying by this value projects it to screen space.
+ */
+float Camera::projectionScale(const float viewportHeight) const
+{
+    return viewportHeight / (2.0f * qTan(qDegreesToRadians(m_fov) / 2.0f));
+}
+
 /**
  * \brief Accessor for the camera position
  */
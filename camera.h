@@ -13,6 +13,7 @@ public:
     QMatrix4x4 viewMatrixAtPosition() const;
     QMatrix4x4 viewMatrixAtOrigin() const;
     QMatrix4x4 projectionMatrix(float aspectRatio) const;
+    float projectionScale(float viewportHeight) const;
 
     QVector3D position() const;
     void setPosition(const QVector3D& position);
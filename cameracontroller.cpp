@@ -0,0 +1,185 @@
+#include "cameracontroller.h"
+
+#include <cmath>
+#include <QtMath>
+
+namespace
+{
+    // The simulation runs at a fixed rate regardless of how often the widget repaints
+    constexpr auto SIMULATION_STEP = 1.0f / 120.0f; // seconds
+
+    // A frame that took longer than this, after a stall or a breakpoint, is simulated as if it hadn't
+    constexpr auto MAXIMUM_FRAME_TIME = 0.1f; // seconds
+
+    constexpr auto MAXIMUM_ANGULAR_SPEED = 90.0f; // degrees per second
+
+    // Rates at which the velocities approach their target speed, and the radius its target radius. The time
+    // to cover 95% of the way there is 3 / rate.
+    constexpr auto ANGULAR_RESPONSE = 8.0f; // per second
+    constexpr auto ZOOM_RESPONSE = 10.0f;   // per second
+
+    // Below these the camera counts as stopped and is snapped to rest
+    constexpr auto RESTING_ANGULAR_SPEED = 0.01f; // degrees per second
+    constexpr auto RESTING_RADIUS_DIFFERENCE = 0.0001f;
+
+    constexpr auto RADIUS_LOWER_LIMIT = 2.4f;
+    constexpr auto RADIUS_UPPER_LIMIT = 7.5f;
+
+    constexpr auto AZIMUTH_ORIGIN = 0.0f;
+    constexpr auto AZIMUTH_HALF_TURN = 180.0f;
+
+    constexpr auto ELEVATION_ORIGIN = 0.0f;
+    constexpr auto ELEVATION_LOWER_LIMIT = -80.0f;
+    constexpr auto ELEVATION_UPPER_LIMIT = 80.0f;
+}
+
+/**
+ * \brief Share of the way to a target that exponential easing at the given rate covers in one step
+ */
+static float easing_factor(const float rate)
+{
+    return 1.0f - std::exp(-rate * SIMULATION_STEP);
+}
+
+/**
+ * \brief Constructor for the camera controller. The camera starts at rest, as far out as it can go.
+ */
+CameraController::CameraController() :
+    m_previous{AZIMUTH_ORIGIN, ELEVATION_ORIGIN, RADIUS_UPPER_LIMIT, 0.0f, 0.0f},
+    m_current{m_previous},
+    m_accumulator{0.0f},
+    m_horizontalInput{0.0f},
+    m_verticalInput{0.0f},
+    m_targetRadius{RADIUS_UPPER_LIMIT}
+{
+
+}
+
+/**
+ * \brief Mutator for the held rotation input. Each axis is between -1 and 1 and stays in effect until changed.
+ */
+void CameraController::setRotationInput(const float horizontalInput, const float verticalInput)
+{
+    m_horizontalInput = qBound(-1.0f, horizontalInput, 1.0f);
+    m_verticalInput = qBound(-1.0f, verticalInput, 1.0f);
+}
+
+/**
+ * \brief Moves the target radius, which the camera then eases towards
+ */
+void CameraController::zoom(const float radiusDifference)
+{
+    m_targetRadius = qBound(RADIUS_LOWER_LIMIT, m_targetRadius + radiusDifference, RADIUS_UPPER_LIMIT);
+}
+
+/**
+ * \brief Puts the camera at rest at the given azimuth and elevation, in degrees, and radius, all brought within
+ *        their limits. Any held input is dropped.
+ */
+void CameraController::jumpTo(const float azimuth, const float elevation, const float radius)
+{
+    const auto wrappedAzimuth = std::remainder(azimuth, 2.0f * AZIMUTH_HALF_TURN);
+    const auto boundedElevation = qBound(ELEVATION_LOWER_LIMIT, elevation, ELEVATION_UPPER_LIMIT);
+    const auto boundedRadius = qBound(RADIUS_LOWER_LIMIT, radius, RADIUS_UPPER_LIMIT);
+
+    m_current = {wrappedAzimuth, boundedElevation, boundedRadius, 0.0f, 0.0f};
+    m_previous = m_current;
+    m_accumulator = 0.0f;
+
+    m_horizontalInput = 0.0f;
+    m_verticalInput = 0.0f;
+    m_targetRadius = boundedRadius;
+}
+
+/**
+ * \brief Runs as many whole simulation steps as fit in the time passed since the last call. The remainder is
+ *        carried over to the next call and decides how far position() blends towards the latest step.
+ */
+void CameraController::advance(const float elapsedSeconds)
+{
+    m_accumulator += qBound(0.0f, elapsedSeconds, MAXIMUM_FRAME_TIME);
+
+    while(m_accumulator >= SIMULATION_STEP)
+    {
+        step();
+        m_accumulator -= SIMULATION_STEP;
+    }
+}
+
+/**
+ * \brief True while a key is held or the camera hasn't settled yet. The widget keeps repainting until this
+ *        turns false.
+ */
+bool CameraController::isMoving() const
+{
+    return m_horizontalInput != 0.0f || m_verticalInput != 0.0f ||
+           m_current.azimuthVelocity != 0.0f || m_current.elevationVelocity != 0.0f ||
+           m_current.radius != m_targetRadius ||
+           m_previous.azimuth != m_current.azimuth || m_previous.elevation != m_current.elevation ||
+           m_previous.radius != m_current.radius;
+}
+
+/**
+ * \brief Cartesian position of the camera, blended between the last two steps. Elevation is measured from the
+ *        XZ plane and azimuth around the Y axis from +Z.
+ */
+QVector3D CameraController::position() const
+{
+    const auto blend = m_accumulator / SIMULATION_STEP;
+
+    const auto azimuth = qDegreesToRadians(m_previous.azimuth + ((m_current.azimuth - m_previous.azimuth) * blend));
+    const auto elevation = qDegreesToRadians(m_previous.elevation +
+                                             ((m_current.elevation - m_previous.elevation) * blend));
+    const auto radius = m_previous.radius + ((m_current.radius - m_previous.radius) * blend);
+
+    const auto hypotenuse = radius * qCos(elevation);
+    return QVector3D(hypotenuse * qSin(azimuth), radius * qSin(elevation), hypotenuse * qCos(azimuth));
+}
+
+/**
+ * \brief Advances the simulation by one fixed step
+ */
+void CameraController::step()
+{
+    m_previous = m_current;
+    auto& state = m_current;
+
+    // Held keys pull the velocities up to the top speed, releasing them lets the camera coast to a stop
+    const auto angularEasing = easing_factor(ANGULAR_RESPONSE);
+    state.azimuthVelocity += ((m_horizontalInput * MAXIMUM_ANGULAR_SPEED) - state.azimuthVelocity) * angularEasing;
+    state.elevationVelocity += ((m_verticalInput * MAXIMUM_ANGULAR_SPEED) - state.elevationVelocity) * angularEasing;
+
+    if(m_horizontalInput == 0.0f && qAbs(state.azimuthVelocity) < RESTING_ANGULAR_SPEED)
+    {
+        state.azimuthVelocity = 0.0f;
+    }
+
+    if(m_verticalInput == 0.0f && qAbs(state.elevationVelocity) < RESTING_ANGULAR_SPEED)
+    {
+        state.elevationVelocity = 0.0f;
+    }
+
+    state.azimuth += state.azimuthVelocity * SIMULATION_STEP;
+    state.elevation += state.elevationVelocity * SIMULATION_STEP;
+
+    // Stop dead at the limits rather than pushing against them, so a released key doesn't leave it sliding back
+    if(state.elevation > ELEVATION_UPPER_LIMIT || state.elevation < ELEVATION_LOWER_LIMIT)
+    {
+        state.elevation = qBound(ELEVATION_LOWER_LIMIT, state.elevation, ELEVATION_UPPER_LIMIT);
+        state.elevationVelocity = 0.0f;
+    }
+
+    // Wrap both steps by the same whole turn so the blend between them never spins the long way round
+    if(state.azimuth > AZIMUTH_HALF_TURN || state.azimuth < -AZIMUTH_HALF_TURN)
+    {
+        const auto turn = (state.azimuth > 0.0f) ? (-2.0f * AZIMUTH_HALF_TURN) : (2.0f * AZIMUTH_HALF_TURN);
+        state.azimuth += turn;
+        m_previous.azimuth += turn;
+    }
+
+    state.radius += (m_targetRadius - state.radius) * easing_factor(ZOOM_RESPONSE);
+    if(qAbs(m_targetRadius - state.radius) < RESTING_RADIUS_DIFFERENCE)
+    {
+        state.radius = m_targetRadius;
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef CAMERACONTROLLER_H
+#define CAMERACONTROLLER_H
+
+#include <QVector3D>
+
+/**
+ * \brief Orbits the camera around the globe with a fixed-timestep simulation. Held keys accelerate the azimuth
+ *        and elevation towards a top speed and the camera coasts to a stop once they are released, while the
+ *        radius eases towards a target that the mouse wheel moves. advance() takes however much time has passed
+ *        and runs whole steps of it, so the motion is the same at any frame rate, and position() blends the last
+ *        two steps so it stays smooth between them.
+ */
+class CameraController
+{
+public:
+    CameraController();
+
+    void setRotationInput(float horizontalInput, float verticalInput);
+    void zoom(float radiusDifference);
+    void jumpTo(float azimuth, float elevation, float radius);
+
+    void advance(float elapsedSeconds);
+    bool isMoving() const;
+
+    QVector3D position() const;
+
+private:
+    struct State
+    {
+        float azimuth;           // degrees
+        float elevation;         // degrees
+        float radius;
+        float azimuthVelocity;   // degrees per second
+        float elevationVelocity; // degrees per second
+    };
+
+    void step();
+
+private:
+    State m_previous;
+    State m_current;
+    float m_accumulator;
+
+    float m_horizontalInput;
+    float m_verticalInput;
+    float m_targetRadius;
+};
+
+#endif // CAMERACONTROLLER_H
@@ -0,0 +1,508 @@
+#include "cubemapprojection.h"
+#include "taskscheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <QtGlobal>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CUBE_MAP_PROJECTION_X86
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr auto RGBA_CHANNELS = 4U;
+    constexpr auto PI = 3.14159265358979323846f;
+
+    // Face rows handed to a worker at a time, most of which fall outside any one band and cost nothing
+    constexpr auto ROWS_PER_TASK = 16U;
+
+    constexpr auto MAXIMUM_TAPS = 4U;
+    constexpr auto POSITIONS_PER_BATCH = 4U;
+
+    // atan() on [-tan(pi / 8), tan(pi / 8)], from Cephes, within 2e-7 radians: a thousandth of a texel across
+    // the 86400 texels around the equator of the largest Blue Marble
+    constexpr float ATAN_COEFFICIENTS[4] = { 8.05374449538e-2f, -1.38776856032e-1f, 1.99777106478e-1f,
+                                             -3.33329491539e-1f };
+    constexpr auto TAN_PI_OVER_8 = 0.414213562373f;
+}
+
+/**
+ * \brief atan2() by polynomial, which unlike the library call vectorizes. The scalar version does the same
+ *        arithmetic for builds without SSE.
+ */
+#ifdef CUBE_MAP_PROJECTION_X86
+static __m128 select_ps(const __m128 mask, const __m128 whenSet, const __m128 whenClear)
+{
+    return _mm_or_ps(_mm_and_ps(mask, whenSet), _mm_andnot_ps(mask, whenClear));
+}
+
+static __m128 atan2_ps(const __m128 y, const __m128 x)
+{
+    const auto signMask = _mm_set1_ps(-0.0f);
+    const auto absoluteX = _mm_andnot_ps(signMask, x);
+    const auto absoluteY = _mm_andnot_ps(signMask, y);
+
+    // Fold into the first octant, then around tan(pi / 8)
+    const auto swapped = _mm_cmpgt_ps(absoluteY, absoluteX);
+    const auto numerator = select_ps(swapped, absoluteX, absoluteY);
+    const auto denominator = _mm_max_ps(select_ps(swapped, absoluteY, absoluteX), _mm_set1_ps(1e-30f));
+    auto ratio = _mm_div_ps(numerator, denominator);
+
+    const auto reduced = _mm_cmpgt_ps(ratio, _mm_set1_ps(TAN_PI_OVER_8));
+    ratio = select_ps(reduced, _mm_div_ps(_mm_sub_ps(ratio, _mm_set1_ps(1.0f)), _mm_add_ps(ratio, _mm_set1_ps(1.0f))),
+                      ratio);
+
+    const auto squared = _mm_mul_ps(ratio, ratio);
+    auto polynomial = _mm_set1_ps(ATAN_COEFFICIENTS[0]);
+    for(auto i = 1U; i < 4U; ++i)
+    {
+        polynomial = _mm_add_ps(_mm_mul_ps(polynomial, squared), _mm_set1_ps(ATAN_COEFFICIENTS[i]));
+    }
+
+    auto angle = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(polynomial, squared), ratio), ratio);
+    angle = _mm_add_ps(angle, _mm_and_ps(reduced, _mm_set1_ps(PI / 4.0f)));
+    angle = select_ps(swapped, _mm_sub_ps(_mm_set1_ps(PI / 2.0f), angle), angle);
+    angle = select_ps(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(PI), angle), angle);
+
+    return select_ps(_mm_cmplt_ps(y, _mm_setzero_ps()), _mm_sub_ps(_mm_setzero_ps(), angle), angle);
+}
+#else
+static float atan2_approximation(const float y, const float x)
+{
+    const auto absoluteX = std::fabs(x);
+    const auto absoluteY = std::fabs(y);
+
+    const auto swapped = absoluteY > absoluteX;
+    auto ratio = (swapped ? absoluteX : absoluteY) / qMax(swapped ? absoluteY : absoluteX, 1e-30f);
+
+    const auto reduced = ratio > TAN_PI_OVER_8;
+    if(reduced)
+    {
+        ratio = (ratio - 1.0f) / (ratio + 1.0f);
+    }
+
+    const auto squared = ratio * ratio;
+    auto polynomial = ATAN_COEFFICIENTS[0];
+    for(auto i = 1U; i < 4U; ++i)
+    {
+        polynomial = (polynomial * squared) + ATAN_COEFFICIENTS[i];
+    }
+
+    auto angle = (polynomial * squared * ratio) + ratio;
+    angle += reduced ? (PI / 4.0f) : 0.0f;
+    angle = swapped ? ((PI / 2.0f) - angle) : angle;
+    angle = (x < 0.0f) ? (PI - angle) : angle;
+
+    return (y < 0.0f) ? -angle : angle;
+}
+#endif
+
+/**
+ * \brief Rows of the source a footprint reaches above and below the row it starts on
+ */
+static uint32_t rows_above(const ReprojectionFilter filter)
+{
+    return (filter == ReprojectionFilter::Bicubic) ? 1U : 0U;
+}
+
+static uint32_t rows_below(const ReprojectionFilter filter)
+{
+    return (filter == ReprojectionFilter::Bicubic) ? 2U : 1U;
+}
+
+/**
+ * \brief Catmull-Rom weights of the four taps around a sample a fraction of a texel past the second one
+ */
+static void catmull_rom_weights(const float fraction, float weights[MAXIMUM_TAPS])
+{
+    const auto f = fraction;
+    weights[0] = ((((-0.5f * f) + 1.0f) * f) - 0.5f) * f;
+    weights[1] = (((1.5f * f) - 2.5f) * f * f) + 1.0f;
+    weights[2] = ((((-1.5f * f) + 2.0f) * f) + 0.5f) * f;
+    weights[3] = ((0.5f * f) - 0.5f) * f * f;
+}
+
+/**
+ * \brief First index in [begin, end) for which the predicate holds, given that it holds for a suffix of the range
+ */
+template<typename Predicate>
+static uint32_t first_index_where(uint32_t begin, uint32_t end, Predicate predicate)
+{
+    while(begin < end)
+    {
+        const auto middle = begin + ((end - begin) / 2U);
+        if(predicate(middle))
+        {
+            end = middle;
+        }
+        else
+        {
+            begin = middle + 1U;
+        }
+    }
+
+    return begin;
+}
+
+/**
+ * \brief Weighted sum of a grid of RGBA8 texels, rounded and clamped back to RGBA8. One texel fills one SSE
+ *        register, so every tap is a widening load and a multiply-add.
+ */
+static void filter_taps(const uint8_t* const rows[MAXIMUM_TAPS], const uint32_t columns[MAXIMUM_TAPS],
+                        const float rowWeights[MAXIMUM_TAPS], const float columnWeights[MAXIMUM_TAPS],
+                        const uint32_t taps, uint8_t* output)
+{
+#ifdef CUBE_MAP_PROJECTION_X86
+    const auto zero = _mm_setzero_si128();
+    auto sum = _mm_setzero_ps();
+
+    for(auto r = 0U; r < taps; ++r)
+    {
+        auto rowSum = _mm_setzero_ps();
+        for(auto c = 0U; c < taps; ++c)
+        {
+            int32_t packed;
+            std::memcpy(&packed, rows[r] + columns[c], sizeof(packed));
+
+            const auto widened = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+            rowSum = _mm_add_ps(rowSum, _mm_mul_ps(_mm_cvtepi32_ps(widened), _mm_set1_ps(columnWeights[c])));
+        }
+        sum = _mm_add_ps(sum, _mm_mul_ps(rowSum, _mm_set1_ps(rowWeights[r])));
+    }
+
+    // The saturating packs clamp the overshoot of the bicubic filter
+    const auto rounded = _mm_cvtps_epi32(sum);
+    const auto narrowed = _mm_packus_epi16(_mm_packs_epi32(rounded, rounded), zero);
+    const auto packed = _mm_cvtsi128_si32(narrowed);
+    std::memcpy(output, &packed, sizeof(packed));
+#else
+    for(auto channel = 0U; channel < RGBA_CHANNELS; ++channel)
+    {
+        auto sum = 0.0f;
+        for(auto r = 0U; r < taps; ++r)
+        {
+            auto rowSum = 0.0f;
+            for(auto c = 0U; c < taps; ++c)
+            {
+                rowSum += rows[r][columns[c] + channel] * columnWeights[c];
+            }
+            sum += rowSum * rowWeights[r];
+        }
+        output[channel] = static_cast<uint8_t>(qBound(0L, std::lround(sum), 255L));
+    }
+#endif
+}
+
+/**
+ * \brief Direction from the centre of the cube through the point (s, t) of a face, both between 0 and 1. This is
+ *        the inverse of the face selection table of the OpenGL specification, so sampling a cubemap in the
+ *        returned direction lands back on (s, t).
+ */
+QVector3D cubeMapFaceDirection(const uint32_t face, const float s, const float t)
+{
+    const auto sc = (s * 2.0f) - 1.0f;
+    const auto tc = (t * 2.0f) - 1.0f;
+
+    switch(face)
+    {
+    case 0U:
+        return QVector3D(1.0f, -tc, -sc);
+    case 1U:
+        return QVector3D(-1.0f, -tc, sc);
+    case 2U:
+        return QVector3D(sc, 1.0f, tc);
+    case 3U:
+        return QVector3D(sc, -1.0f, -tc);
+    case 4U:
+        return QVector3D(sc, -tc, 1.0f);
+    default:
+        return QVector3D(-sc, -tc, -1.0f);
+    }
+}
+
+/**
+ * \brief Sets up a reprojection of a sourceWidth x sourceHeight equirectangular image onto faces of faceSize
+ *        texels a side. Along any face row the latitude changes monotonically from the edges to the middle, so
+ *        the source rows a face row needs are known from four texels, and found here for every row up front.
+ */
+CubeMapReprojector::CubeMapReprojector(const uint32_t sourceWidth, const uint32_t sourceHeight,
+                                       const uint32_t faceSize, const ReprojectionFilter filter) :
+    m_sourceWidth{sourceWidth},
+    m_sourceHeight{sourceHeight},
+    m_faceSize{faceSize},
+    m_filter{filter},
+    m_rowRanges(static_cast<size_t>(CUBE_MAP_PROJECTION_FACES) * faceSize)
+{
+    const auto middle = (faceSize + 1U) / 2U;
+
+    for(auto face = 0U; face < CUBE_MAP_PROJECTION_FACES; ++face)
+    {
+        for(auto row = 0U; row < faceSize; ++row)
+        {
+            const int32_t owners[4] = { ownerRow(face, 0U, row), ownerRow(face, middle - 1U, row),
+                                        ownerRow(face, qMin(middle, faceSize - 1U), row),
+                                        ownerRow(face, faceSize - 1U, row) };
+
+            // Widened by a row either way so rounding in the trigonometry can never drop a texel
+            m_rowRanges[(face * faceSize) + row] = { *std::min_element(owners, owners + 4) - 1,
+                                                     *std::max_element(owners, owners + 4) + 1 };
+        }
+    }
+}
+
+/**
+ * \brief A band that owns the source rows [firstOwnedRow, lastOwnedRow), with the rows around them that its
+ *        footprints reach. The caller points rgba at those rows before reprojecting it.
+ */
+EquirectangularBand CubeMapReprojector::band(const uint32_t firstOwnedRow, const uint32_t lastOwnedRow) const
+{
+    const auto firstRow = (firstOwnedRow > rows_above(m_filter)) ? (firstOwnedRow - rows_above(m_filter)) : 0U;
+    const auto lastRow = qMin(lastOwnedRow + rows_below(m_filter), m_sourceHeight);
+
+    return { nullptr, firstRow, lastRow - firstRow, firstOwnedRow, lastOwnedRow };
+}
+
+/**
+ * \brief Fills every face texel the band owns, face rows spread across the task scheduler. Bands that together
+ *        own every source row fill every texel exactly once, whatever their order.
+ */
+void CubeMapReprojector::reprojectBand(const EquirectangularBand& band,
+                                       const std::array<uint8_t*, CUBE_MAP_PROJECTION_FACES>& faces) const
+{
+    const auto rowBytes = static_cast<size_t>(m_sourceWidth) * RGBA_CHANNELS;
+    const auto lastSourceRow = static_cast<int32_t>(m_sourceHeight) - 1;
+    const auto taps = (m_filter == ReprojectionFilter::Bicubic) ? 4U : 2U;
+    const auto firstTap = (m_filter == ReprojectionFilter::Bicubic) ? -1 : 0;
+    const auto middle = (m_faceSize + 1U) / 2U;
+
+    const auto sourceRow = [&](const int32_t row)
+    {
+        const auto clamped = static_cast<uint32_t>(qBound(0, row, lastSourceRow));
+        Q_ASSERT(clamped >= band.firstRow && clamped < band.firstRow + band.numberOfRows);
+
+        return band.rgba + ((clamped - band.firstRow) * rowBytes);
+    };
+
+    // Longitude wraps around, so the columns either side of the seam are neighbours. Taps never land more than
+    // a couple of texels past either edge, which saves a division per tap.
+    const auto width = static_cast<int64_t>(m_sourceWidth);
+    const auto sourceColumn = [&](int64_t column)
+    {
+        while(column < 0)
+        {
+            column += width;
+        }
+        while(column >= width)
+        {
+            column -= width;
+        }
+
+        return static_cast<uint32_t>(column * RGBA_CHANNELS);
+    };
+
+    const auto weights = [&](const float fraction, float result[MAXIMUM_TAPS])
+    {
+        if(m_filter == ReprojectionFilter::Bicubic)
+        {
+            catmull_rom_weights(fraction, result);
+        }
+        else
+        {
+            result[0] = 1.0f - fraction;
+            result[1] = fraction;
+        }
+    };
+
+    TaskScheduler::instance().parallelFor(0U, CUBE_MAP_PROJECTION_FACES * m_faceSize, ROWS_PER_TASK,
+                                          [&](const uint32_t first, const uint32_t last)
+    {
+        for(auto index = first; index < last; ++index)
+        {
+            const auto& range = m_rowRanges[index];
+            if(range.second < static_cast<int32_t>(band.firstOwnedRow) ||
+               range.first >= static_cast<int32_t>(band.lastOwnedRow))
+            {
+                continue;
+            }
+
+            const auto face = index / m_faceSize;
+            const auto row = index % m_faceSize;
+            auto* output = faces[face] + (static_cast<size_t>(row) * m_faceSize * RGBA_CHANNELS);
+
+            const std::pair<uint32_t, uint32_t> halves[2] = { ownedColumns(face, row, 0U, middle, band),
+                                                              ownedColumns(face, row, middle, m_faceSize, band) };
+
+            for(const auto& columns : halves)
+            {
+                for(auto batch = columns.first; batch < columns.second; batch += POSITIONS_PER_BATCH)
+                {
+                    const auto positions = sourcePositions(face, batch, row);
+                    const auto count = qMin(POSITIONS_PER_BATCH, columns.second - batch);
+
+                    for(auto lane = 0U; lane < count; ++lane)
+                    {
+                        const auto x = std::floor(positions.x[lane]);
+                        const auto y = std::floor(positions.y[lane]);
+
+                        const uint8_t* rows[MAXIMUM_TAPS];
+                        uint32_t sourceColumns[MAXIMUM_TAPS];
+                        for(auto tap = 0U; tap < taps; ++tap)
+                        {
+                            rows[tap] = sourceRow(static_cast<int32_t>(y) + firstTap + static_cast<int32_t>(tap));
+                            sourceColumns[tap] = sourceColumn(static_cast<int64_t>(x) + firstTap + tap);
+                        }
+
+                        float rowWeights[MAXIMUM_TAPS];
+                        float columnWeights[MAXIMUM_TAPS];
+                        weights(positions.y[lane] - y, rowWeights);
+                        weights(positions.x[lane] - x, columnWeights);
+
+                        filter_taps(rows, sourceColumns, rowWeights, columnWeights, taps,
+                                    output + ((batch + lane) * RGBA_CHANNELS));
+                    }
+                }
+            }
+        }
+    });
+}
+
+uint32_t CubeMapReprojector::faceSize() const
+{
+    return m_faceSize;
+}
+
+/**
+ * \brief Where the centres of four neighbouring face texels, starting at firstColumn, land in the source, in
+ *        texels, with the centre of the first source texel at (0, 0). Longitude runs from -180 degrees at the left
+ *        edge and latitude from 90 at the top. Both the bands and the samples come from here, so the two always
+ *        agree on the row a footprint starts on.
+ */
+CubeMapReprojector::SourcePositions CubeMapReprojector::sourcePositions(const uint32_t face,
+                                                                        const uint32_t firstColumn,
+                                                                        const uint32_t row) const
+{
+    SourcePositions positions;
+    const auto t = (row + 0.5f) / m_faceSize;
+
+#ifdef CUBE_MAP_PROJECTION_X86
+    const auto columns = _mm_add_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(static_cast<int32_t>(firstColumn)),
+                                                                  _mm_setr_epi32(0, 1, 2, 3))),
+                                    _mm_set1_ps(0.5f));
+    const auto s = _mm_div_ps(columns, _mm_set1_ps(static_cast<float>(m_faceSize)));
+
+    // cubeMapFaceDirection() for four values of s at once
+    const auto sc = _mm_sub_ps(_mm_mul_ps(s, _mm_set1_ps(2.0f)), _mm_set1_ps(1.0f));
+    const auto negativeSc = _mm_sub_ps(_mm_setzero_ps(), sc);
+    const auto tc = (t * 2.0f) - 1.0f;
+
+    __m128 direction[3];
+    switch(face)
+    {
+    case 0U:
+        direction[0] = _mm_set1_ps(1.0f);
+        direction[1] = _mm_set1_ps(-tc);
+        direction[2] = negativeSc;
+        break;
+    case 1U:
+        direction[0] = _mm_set1_ps(-1.0f);
+        direction[1] = _mm_set1_ps(-tc);
+        direction[2] = sc;
+        break;
+    case 2U:
+        direction[0] = sc;
+        direction[1] = _mm_set1_ps(1.0f);
+        direction[2] = _mm_set1_ps(tc);
+        break;
+    case 3U:
+        direction[0] = sc;
+        direction[1] = _mm_set1_ps(-1.0f);
+        direction[2] = _mm_set1_ps(-tc);
+        break;
+    case 4U:
+        direction[0] = sc;
+        direction[1] = _mm_set1_ps(-tc);
+        direction[2] = _mm_set1_ps(1.0f);
+        break;
+    default:
+        direction[0] = negativeSc;
+        direction[1] = _mm_set1_ps(-tc);
+        direction[2] = _mm_set1_ps(-1.0f);
+        break;
+    }
+
+    const auto horizontal = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(direction[0], direction[0]),
+                                                   _mm_mul_ps(direction[2], direction[2])));
+    const auto longitude = atan2_ps(direction[0], direction[2]);
+    const auto latitude = atan2_ps(direction[1], horizontal);
+
+    const auto width = _mm_set1_ps(static_cast<float>(m_sourceWidth));
+    const auto height = _mm_set1_ps(static_cast<float>(m_sourceHeight));
+    const auto half = _mm_set1_ps(0.5f);
+
+    _mm_storeu_ps(positions.x, _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(longitude, _mm_set1_ps(0.5f / PI)), half),
+                                                     width), half));
+    _mm_storeu_ps(positions.y, _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(latitude, _mm_set1_ps(1.0f / PI))),
+                                                     height), half));
+#else
+    for(auto lane = 0U; lane < POSITIONS_PER_BATCH; ++lane)
+    {
+        const auto direction = cubeMapFaceDirection(face, (firstColumn + lane + 0.5f) / m_faceSize, t);
+
+        const auto horizontal = std::sqrt((direction.x() * direction.x()) + (direction.z() * direction.z()));
+        const auto longitude = atan2_approximation(direction.x(), direction.z());
+        const auto latitude = atan2_approximation(direction.y(), horizontal);
+
+        positions.x[lane] = (((longitude * (0.5f / PI)) + 0.5f) * m_sourceWidth) - 0.5f;
+        positions.y[lane] = ((0.5f - (latitude * (1.0f / PI))) * m_sourceHeight) - 0.5f;
+    }
+#endif
+
+    return positions;
+}
+
+/**
+ * \brief The source row a face texel's footprint starts on, which decides the band that fills it
+ */
+int32_t CubeMapReprojector::ownerRow(const uint32_t face, const uint32_t column, const uint32_t row) const
+{
+    const auto y = static_cast<int32_t>(std::floor(sourcePositions(face, column, row).y[0]));
+    return qBound(0, y, static_cast<int32_t>(m_sourceHeight) - 1);
+}
+
+/**
+ * \brief The columns in [begin, end) of a face row whose texels the band owns. Within either half of a row the
+ *        owner row only ever moves one way, so they are a single run found with two binary searches. Neighbouring
+ *        bands search with the same predicate at the row they share, so their runs meet without a gap.
+ */
+std::pair<uint32_t, uint32_t> CubeMapReprojector::ownedColumns(const uint32_t face, const uint32_t row,
+                                                               const uint32_t begin, const uint32_t end,
+                                                               const EquirectangularBand& band) const
+{
+    if(begin >= end)
+    {
+        return { begin, begin };
+    }
+
+    const auto owner = [&](const uint32_t column) { return ownerRow(face, column, row); };
+    const auto firstOwned = static_cast<int32_t>(band.firstOwnedRow);
+    const auto lastOwned = static_cast<int32_t>(band.lastOwnedRow);
+
+    uint32_t first;
+    uint32_t last;
+
+    if(owner(begin) <= owner(end - 1U))
+    {
+        first = first_index_where(begin, end, [&](const uint32_t column) { return owner(column) >= firstOwned; });
+        last = first_index_where(begin, end, [&](const uint32_t column) { return owner(column) >= lastOwned; });
+    }
+    else
+    {
+        first = first_index_where(begin, end, [&](const uint32_t column) { return owner(column) < lastOwned; });
+        last = first_index_where(begin, end, [&](const uint32_t column) { return owner(column) < firstOwned; });
+    }
+
+    return { first, qMax(first, last) };
+}
@@ -0,0 +1,71 @@
+#ifndef CUBEMAPPROJECTION_H
+#define CUBEMAPPROJECTION_H
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <QVector3D>
+
+constexpr auto CUBE_MAP_PROJECTION_FACES = 6U; // In the GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+
+enum class ReprojectionFilter
+{
+    Bilinear,
+    Bicubic // Catmull-Rom
+};
+
+/**
+ * \brief A run of rows of an equirectangular image, as tightly packed RGBA8. Every cubemap texel whose filter
+ *        footprint starts on a row in [firstOwnedRow, lastOwnedRow) is filled from this band, the rows around them
+ *        are only there for the footprints that spill over.
+ */
+struct EquirectangularBand
+{
+    const uint8_t* rgba;
+    uint32_t firstRow;
+    uint32_t numberOfRows;
+    uint32_t firstOwnedRow;
+    uint32_t lastOwnedRow;
+};
+
+/**
+ * \brief Resamples an equirectangular image onto the six faces of a cubemap one band of rows at a time, so the
+ *        source never has to be in memory at once. Longitude 0 faces +Z and 90 degrees east faces +X, with north
+ *        up +Y, which puts the faces in the same orientation the engine samples them in.
+ */
+class CubeMapReprojector
+{
+public:
+    CubeMapReprojector(uint32_t sourceWidth, uint32_t sourceHeight, uint32_t faceSize, ReprojectionFilter filter);
+
+    EquirectangularBand band(uint32_t firstOwnedRow, uint32_t lastOwnedRow) const;
+    void reprojectBand(const EquirectangularBand& band, const std::array<uint8_t*, CUBE_MAP_PROJECTION_FACES>& faces) const;
+
+    uint32_t faceSize() const;
+
+private:
+    // Where four neighbouring texels of a face row land in the source
+    struct SourcePositions
+    {
+        float x[4];
+        float y[4];
+    };
+
+    SourcePositions sourcePositions(uint32_t face, uint32_t firstColumn, uint32_t row) const;
+    int32_t ownerRow(uint32_t face, uint32_t column, uint32_t row) const;
+    std::pair<uint32_t, uint32_t> ownedColumns(uint32_t face, uint32_t row, uint32_t begin, uint32_t end,
+                                               const EquirectangularBand& band) const;
+
+    uint32_t m_sourceWidth;
+    uint32_t m_sourceHeight;
+    uint32_t m_faceSize;
+    ReprojectionFilter m_filter;
+
+    // First and last source row that owns a texel of each face row, face by face
+    std::vector<std::pair<int32_t, int32_t>> m_rowRanges;
+};
+
+QVector3D cubeMapFaceDirection(uint32_t face, float s, float t);
+
+#endif // CUBEMAPPROJECTION_H
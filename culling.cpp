@@ -0,0 +1,74 @@
+#include "culling.h"
+
+#include <QtMath>
+
+namespace
+{
+    constexpr auto NUMBER_OF_PLANES = 6U;
+}
+
+/**
+ * \brief Extracts the planes from the rows of the combined matrix (Gribb and Hartmann). A point is inside the
+ *        OpenGL clip volume when -w <= x, y, z <= w, and each of those six inequalities is a plane in world space.
+ */
+ViewFrustum::ViewFrustum(const QMatrix4x4& viewProjection) :
+    m_planes()
+{
+    const auto w = viewProjection.row(3);
+
+    for(auto axis = 0U; axis < 3U; ++axis)
+    {
+        const auto row = viewProjection.row(static_cast<int>(axis));
+        m_planes[axis * 2U] = w + row;
+        m_planes[(axis * 2U) + 1U] = w - row;
+    }
+
+    for(auto& plane : m_planes)
+    {
+        const auto length = plane.toVector3D().length();
+        if(length > 0.0f)
+        {
+            plane = plane / length;
+        }
+    }
+}
+
+/**
+ * \brief False only when the sphere lies entirely behind one of the planes. Spheres near a corner of the frustum
+ *        can pass without touching it, which costs a draw but never a missing chunk.
+ */
+bool ViewFrustum::intersectsSphere(const QVector3D& center, const float radius) const
+{
+    for(auto i = 0U; i < NUMBER_OF_PLANES; ++i)
+    {
+        if(QVector4D::dotProduct(m_planes[i], QVector4D(center, 1.0f)) < -radius)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * \brief True when every surface normal in the cone faces away from the camera, seen over a sphere of
+ *        lowestRadius centered on the origin. A point of a sphere of radius r with normal n is only visible from
+ *        c when n . c > r, and over the cone the largest n . c is |c| cos(max(0, angle to c - coneAngle)). Using
+ *        the lowest radius the geometry reaches, rather than the surface, only ever keeps more of it.
+ */
+bool isBeyondHorizon(const QVector3D& cameraPosition,
+                     const QVector3D& coneAxis,
+                     const float coneAngle,
+                     const float lowestRadius)
+{
+    const auto cameraDistance = cameraPosition.length();
+    if(cameraDistance <= lowestRadius)
+    {
+        return false;
+    }
+
+    const auto cosine = qBound(-1.0f, QVector3D::dotProduct(coneAxis, cameraPosition) / cameraDistance, 1.0f);
+    const auto angleToCamera = qAcos(cosine);
+
+    return cameraDistance * qCos(qMax(0.0f, angleToCamera - coneAngle)) <= lowestRadius;
+}
@@ -0,0 +1,29 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <array>
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QVector4D>
+
+/**
+ * \brief The six clipping planes of a view frustum, in world space. Every plane is normalized with its normal
+ *        pointing into the frustum, so plane . (p, 1) is the signed distance of p from it.
+ */
+class ViewFrustum
+{
+public:
+    explicit ViewFrustum(const QMatrix4x4& viewProjection);
+
+    bool intersectsSphere(const QVector3D& center, float radius) const;
+
+private:
+    std::array<QVector4D, 6> m_planes;
+};
+
+bool isBeyondHorizon(const QVector3D& cameraPosition,
+                     const QVector3D& coneAxis,
+                     float coneAngle,
+                     float lowestRadius);
+
+#endif // CULLING_H
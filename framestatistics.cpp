@@ -0,0 +1,79 @@
+#include "framestatistics.h"
+
+#include <cmath>
+#include <QtGlobal>
+
+/**
+ * \brief Constructor for the frame statistics, which start out empty
+ */
+FrameStatistics::FrameStatistics() :
+    m_numberOfFrames{0},
+    m_mean{0.0},
+    m_sumOfSquaredDeviations{0.0},
+    m_maximum{0.0}
+{
+
+}
+
+/**
+ * \brief Forgets every frame recorded so far
+ */
+void FrameStatistics::reset()
+{
+    *this = FrameStatistics();
+}
+
+/**
+ * \brief Records the time one frame took. Uses Welford's update, which unlike summing the squares directly
+ *        doesn't lose the variance to rounding when it is tiny next to the mean.
+ */
+void FrameStatistics::addFrame(const double milliseconds)
+{
+    ++m_numberOfFrames;
+
+    const auto deviation = milliseconds - m_mean;
+    m_mean += deviation / m_numberOfFrames;
+    m_sumOfSquaredDeviations += deviation * (milliseconds - m_mean);
+
+    m_maximum = qMax(m_maximum, milliseconds);
+}
+
+/**
+ * \brief Accessor for the number of frames recorded since the last reset()
+ */
+uint32_t FrameStatistics::numberOfFrames() const
+{
+    return m_numberOfFrames;
+}
+
+/**
+ * \brief Mean frame time, in milliseconds
+ */
+double FrameStatistics::mean() const
+{
+    return m_mean;
+}
+
+/**
+ * \brief Sample variance of the frame times, in milliseconds squared
+ */
+double FrameStatistics::variance() const
+{
+    return (m_numberOfFrames > 1U) ? (m_sumOfSquaredDeviations / (m_numberOfFrames - 1U)) : 0.0;
+}
+
+/**
+ * \brief Sample standard deviation of the frame times, in milliseconds
+ */
+double FrameStatistics::standardDeviation() const
+{
+    return std::sqrt(variance());
+}
+
+/**
+ * \brief Longest frame time recorded, in milliseconds
+ */
+double FrameStatistics::maximum() const
+{
+    return m_maximum;
+}
@@ -0,0 +1,31 @@
+#ifndef FRAMESTATISTICS_H
+#define FRAMESTATISTICS_H
+
+#include <cstdint>
+
+/**
+ * \brief Running mean, variance and worst case of a series of frame times, kept in constant memory. A smooth
+ *        animation shows up as a standard deviation that is small next to the mean.
+ */
+class FrameStatistics
+{
+public:
+    FrameStatistics();
+
+    void reset();
+    void addFrame(double milliseconds);
+
+    uint32_t numberOfFrames() const;
+    double mean() const;
+    double variance() const;
+    double standardDeviation() const;
+    double maximum() const;
+
+private:
+    uint32_t m_numberOfFrames;
+    double m_mean;
+    double m_sumOfSquaredDeviations;
+    double m_maximum;
+};
+
+#endif // FRAMESTATISTICS_H
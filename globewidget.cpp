@@ -1,7 +1,30 @@
 #include "globewidget.h"
+#include "culling.h"
+#include "ktxcubemap.h"
 #include "planetgenerator.h"
+#include "profiler.h"
+#include "meshcache.h"
+#include "meshoptimization.h"
+#include "mipchain.h"
+#include "taskscheduler.h"
+#include "tilepack.h"
+#include "vertexformat.h"
+#include "virtualtexture.h"
 
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <functional>
 #include <QtMath>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFontDatabase>
+#include <QFile>
+#include <QImageReader>
+#include <QStandardPaths>
+#include <QOpenGLContext>
+#include <QPainter>
+#include <QOpenGLVersionFunctionsFactory>
 
 // Local constants
 namespace
@@ -9,6 +32,9 @@ namespace
     const auto VERTEX_SHADER_PATH = ":/shaders/cube-map.vert";
     const auto FRAGMENT_SHADER_PATH = ":/shaders/cube-map.frag";
 
+    // Linked programs are kept in the user's cache directory, keyed by their sources and the driver
+    constexpr auto USE_PROGRAM_BINARY_CACHE = true;
+
     const auto CUBEMAP_POSITIVE_X_PATH = ":/textures/asia.png";
     const auto CUBEMAP_NEGATIVE_X_PATH = ":/textures/americas.png";
     const auto CUBEMAP_POSITIVE_Y_PATH = ":/textures/arctic.png";
@@ -16,49 +42,378 @@ namespace
     const auto CUBEMAP_POSITIVE_Z_PATH = ":/textures/africa.png";
     const auto CUBEMAP_NEGATIVE_Z_PATH = ":/textures/pacific.png";
 
-    const auto MVP_MATRIX_NAME_IN_SHADERS = "mvp";
+    // Built by tools/ktx_converter from the six images above, used in their place when present
+    const auto CUBEMAP_KTX_PATH = ":/textures/earth-bc1.ktx";
+
+    // Built by tools/tilepack_builder and read straight from disk rather than the resources, since it's memory
+    // mapped and can be far larger than the images above. Relative to the working directory.
+    const auto TILE_PACK_PATH = "textures/earth.tilepack";
+
+    // In the order of the GL_TEXTURE_CUBE_MAP_POSITIVE_X + i face targets
+    constexpr auto NUMBER_OF_CUBEMAP_FACES = 6U;
+    const char* const CUBEMAP_FACE_PATHS[NUMBER_OF_CUBEMAP_FACES] = {
+        CUBEMAP_POSITIVE_X_PATH, CUBEMAP_NEGATIVE_X_PATH,
+        CUBEMAP_POSITIVE_Y_PATH, CUBEMAP_NEGATIVE_Y_PATH,
+        CUBEMAP_POSITIVE_Z_PATH, CUBEMAP_NEGATIVE_Z_PATH
+    };
+
+    constexpr auto RGBA8888_BYTES_PER_PIXEL = 4U;
+
+    // Stored in the cached mip chain, bump the version when the filter changes to rebuild existing caches
+    constexpr auto MIP_CHAIN_CACHE_VERSION = 1;
+    const auto MIP_CHAIN_CACHE_KEY = QByteArrayLiteral("QtGlobeEngineSourceHash");
+
     const auto CUBEMAP_NAME_IN_SHADERS = "CubeMap";
+    const auto VERTEX_FORMAT_NAME_IN_SHADERS = "VertexFormat";
+    const auto QUADS_PER_FACE_SIDE_NAME_IN_SHADERS = "QuadsPerFaceSide";
+    const auto VIRTUAL_TEXTURING_NAME_IN_SHADERS = "VirtualTexturing";
+    const auto TILE_ATLAS_NAME_IN_SHADERS = "TileAtlas";
+    const auto PAGE_TABLE_NAME_IN_SHADERS = "PageTable";
+    const auto PAGE_TABLE_SIZE_NAME_IN_SHADERS = "PageTableSize";
+    const auto TILE_SIZE_NAME_IN_SHADERS = "TileSize";
+    const auto TILE_BORDER_NAME_IN_SHADERS = "TileBorder";
+    const auto ATLAS_SIZE_NAME_IN_SHADERS = "AtlasSize";
+
+    constexpr auto TILE_ATLAS_TEXTURE_UNIT = 1U;
+    constexpr auto PAGE_TABLE_TEXTURE_UNIT = 2U;
+
+    // The atlas holds 16 x 16 tiles of 130 x 130 texels, 17 MB, no matter how detailed the faces are
+    constexpr auto USE_VIRTUAL_TEXTURE = true;
+    constexpr auto VIRTUAL_TEXTURE_TILE_SIZE = 128U;
+    constexpr auto VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE = 16U;
+    constexpr auto VIRTUAL_TEXTURE_UPLOADS_PER_FRAME = 8U;
+
+    // Guards the tile level against division by zero when the camera is inside a chunk's bounding sphere
+    constexpr auto MINIMUM_TILE_REQUEST_DISTANCE = 0.0001f;
 
     constexpr auto NUMBER_OF_SUBDIVISIONS = 15;
+    constexpr auto OPTIMIZE_PLANET_MESH = true;
+    // VertexFormat::Procedural uploads nothing and has the vertex shader build the mesh, see
+    // enableProceduralPlanetMesh()
+    constexpr auto PLANET_VERTEX_FORMAT = VertexFormat::Octahedral16;
+    constexpr auto PLANET_MESH_TOPOLOGY = MeshTopology::TriangleList;
+    constexpr auto USE_PLANET_MESH_CACHE = true;
+
+    constexpr auto POSITION_ATTRIBUTE_LOCATION = 0;
+    constexpr auto OCTAHEDRAL_ATTRIBUTE_LOCATION = 1;
+    constexpr auto PATCH_ATTRIBUTE_LOCATION = 2;
+    constexpr auto CHUNK_ATTRIBUTE_LOCATION = 3;
+    constexpr auto FACE_ATTRIBUTE_LOCATION = 4;
+
+    constexpr auto EARTH_RADIUS_IN_METERS = 6371000.0f;
+
+    constexpr auto CHUNK_QUADS_PER_SIDE = 16U;
+    constexpr auto MAXIMUM_QUADTREE_DEPTH = 12U;
+    constexpr auto MAXIMUM_SCREEN_SPACE_ERROR = 1.0f; // pixels
 
-    constexpr auto RADIUS_LOWER_LIMIT = 2.4f;
-    constexpr auto RADIUS_UPPER_LIMIT = 7.5f;
+    // Skirts reach deep enough to cover the crack against a neighbour up to two levels coarser
+    constexpr auto CHUNK_SKIRT_DEPTH_SCALE = 16.0f;
+
+    // Every chunk is an instance of one shared grid patch, placed on the sphere by the vertex shader, rather than
+    // a mesh of its own
+    constexpr auto USE_INSTANCED_CHUNKS = true;
+
+    // Chunks outside the view frustum or past the horizon are dropped on the CPU before they are drawn
+    constexpr auto CULL_CHUNKS = true;
+
+    // Each wheel notch moves the radius the camera eases towards by this much
     constexpr auto RADIUS_INCREMENT = 0.2f;
 
-    constexpr auto AZIMUTH_ORIGIN = 0.0f;
-    constexpr auto AZIMUTH_LOWER_LIMIT = -360.0f;
-    constexpr auto AZIMUTH_UPPER_LIMIT = 360.0f;
-    constexpr auto AZIMUTH_INCREMENT = 10.0f;
+    // Frames slower than this while the camera moves are logged as hitches, 1.5 frames at 60 Hz
+    constexpr auto HITCH_FRAME_TIME = 25.0; // milliseconds
 
-    constexpr auto ELEVATION_ORIGIN = 0.0f;
-    constexpr auto ELEVATION_LOWER_LIMIT = -80.0f;
-    constexpr auto ELEVATION_UPPER_LIMIT = 80.0f;
-    constexpr auto ELEVATION_INCREMENT = 10.0f;
+    // The profiler overlay averages over a second of frames at 60 Hz
+    constexpr auto PROFILER_OVERLAY_FRAMES = 60U;
+    constexpr auto PROFILER_OVERLAY_MARGIN = 8; // pixels
+    constexpr auto PROFILER_OVERLAY_PADDING = 6; // pixels
+    constexpr auto PROFILER_OVERLAY_OPACITY = 160;
+    const auto GUI_THREAD_TRACK_NAME = "GUI thread";
 
     constexpr auto DEFAULT_FIELD_OF_VIEW = 20.0f;
     constexpr auto DEFAULT_NEAR_PLANE_DISTANCE = 0.1f;
     constexpr auto DEFAULT_FAR_PLANE_DISTANCE = 10.0f;
 }
 
+/**
+ * \brief Constructor for a chunk mesh. The OpenGL objects are created lazily by GlobeWidget::chunkMesh().
+ */
+ChunkMesh::ChunkMesh() :
+    vertexArrayObject(),
+    vertexBufferObject(QOpenGLBuffer::VertexBuffer),
+    lastFrameUsed{0}
+{
+
+}
+
+/**
+ * \brief Decodes one cubemap face from its encoded bytes and converts it to RGBA8888 in place, without the copy
+ *        convertToFormat() makes. Safe to call from worker threads. A face that is missing or not the expected
+ *        size comes back as an opaque black image so the other five still load.
+ */
+static QImage decode_cube_map_face(const QByteArray& encoded, const char* path, const QSize& size)
+{
+    auto image = QImage::fromData(encoded);
+
+    if(image.size() != size)
+    {
+        qDebug() << "Could not decode cubemap face" << path;
+
+        image = QImage(size, QImage::Format_RGBA8888);
+        image.fill(Qt::black);
+        return image;
+    }
+
+    image.convertTo(QImage::Format_RGBA8888);
+    return image;
+}
+
+/**
+ * \brief Copies the rows of an RGBA8888 image into tightly packed memory, dropping any scan line padding
+ */
+static void copy_image_pixels(const QImage& image, uchar* destination)
+{
+    const auto rowBytes = static_cast<size_t>(image.width()) * RGBA8888_BYTES_PER_PIXEL;
+
+    for(auto row = 0; row < image.height(); ++row)
+    {
+        std::memcpy(destination + (row * rowBytes), image.constScanLine(row), rowBytes);
+    }
+}
+
+/**
+ * \brief Immutable RGBA8 storage for a cubemap with the given number of mip levels, all of which are uploaded
+ *        by the caller rather than generated by the driver
+ */
+static void allocate_rgba8_cube_map(QOpenGLTexture& texture, const QSize& size, const uint32_t mipLevels)
+{
+    texture.create();
+    texture.setSize(size.width(), size.height());
+    texture.setFormat(QOpenGLTexture::RGBA8_UNorm);
+    texture.setMipLevels(mipLevels);
+    texture.setAutoMipMapGenerationEnabled(false);
+    texture.allocateStorage();
+}
+
+/**
+ * \brief Location of the cached mip chain for the given source hash, or an empty string without a cache directory
+ */
+static QString cube_map_cache_path(const QByteArray& sourceHash)
+{
+    const auto directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if(directory.isEmpty() || !QDir().mkpath(directory))
+    {
+        return QString();
+    }
+
+    return QStringLiteral("%1/cubemap-%2.ktx").arg(directory, QString::fromLatin1(sourceHash));
+}
+
+/**
+ * \brief Reads the encoded face images and returns the hex SHA-1 of them that identifies their cached mip chain.
+ *        A face that can't be read is left empty.
+ */
+static QByteArray read_cube_map_faces(std::array<QByteArray, NUMBER_OF_CUBEMAP_FACES>& encodedFaces)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(MIP_CHAIN_CACHE_VERSION));
+
+    for(auto face = 0U; face < NUMBER_OF_CUBEMAP_FACES; ++face)
+    {
+        QFile file(CUBEMAP_FACE_PATHS[face]);
+        if(file.open(QIODevice::ReadOnly))
+        {
+            encodedFaces[face] = file.readAll();
+        }
+        hash.addData(encodedFaces[face]);
+    }
+
+    return hash.result().toHex();
+}
+
+/**
+ * \brief Loads, or memory maps, the cached mip chain and checks that it was built from the same images at the
+ *        expected size
+ */
+static bool load_cached_cube_map(KtxCubeMap& cached,
+                                 const QString& cachePath,
+                                 const QSize& faceSize,
+                                 const uint32_t numberOfLevels,
+                                 const QByteArray& sourceHash,
+                                 const bool mapping = false)
+{
+    return !cachePath.isEmpty() && QFile::exists(cachePath) &&
+           (mapping ? cached.map(cachePath) : cached.load(cachePath)) &&
+           cached.glInternalFormat() == KTX_GL_RGBA8 && cached.mipLevels() == numberOfLevels &&
+           cached.width() == static_cast<uint32_t>(faceSize.width()) &&
+           cached.height() == static_cast<uint32_t>(faceSize.height()) &&
+           cached.value(MIP_CHAIN_CACHE_KEY) == sourceHash;
+}
+
+/**
+ * \brief Decodes the faces and builds their mip chains on the task scheduler. faceDecoded, when given, is called
+ *        on the worker thread as soon as each face's chain is complete.
+ */
+static std::vector<KtxCubeMapLevel> decode_cube_map_levels(const std::array<QByteArray, NUMBER_OF_CUBEMAP_FACES>& encodedFaces,
+                                                           const QSize& faceSize,
+                                                           const std::function<void(uint32_t face, const std::vector<KtxCubeMapLevel>& levels)>& faceDecoded)
+{
+    const auto numberOfLevels = mipLevelCount(faceSize.width(), faceSize.height());
+    std::vector<KtxCubeMapLevel> levels(numberOfLevels);
+
+    TaskScheduler::instance().parallelFor(0U, NUMBER_OF_CUBEMAP_FACES, 1U, [&](const uint32_t first, const uint32_t last)
+    {
+        for(auto face = first; face < last; ++face)
+        {
+            {
+                const ProfileScope profileScope("Decode cube map face");
+
+                const auto image = decode_cube_map_face(encodedFaces[face], CUBEMAP_FACE_PATHS[face], faceSize);
+
+                levels[0][face].resize(static_cast<size_t>(faceSize.width()) * faceSize.height() *
+                                       RGBA8888_BYTES_PER_PIXEL);
+                copy_image_pixels(image, levels[0][face].data());
+            }
+
+            {
+                const ProfileScope profileScope("Build cube map mip chain");
+
+                auto chain = generateMipChain(levels[0][face].data(), faceSize.width(), faceSize.height());
+                for(auto level = 1U; level < numberOfLevels; ++level)
+                {
+                    levels[level][face] = std::move(chain[level - 1U]);
+                }
+            }
+
+            if(faceDecoded)
+            {
+                faceDecoded(face, levels);
+            }
+        }
+    });
+
+    return levels;
+}
+
+/**
+ * \brief Saves a freshly built mip chain so the next launch can skip decoding and filtering
+ */
+static void store_cube_map_cache(const QString& cachePath,
+                                 const QSize& faceSize,
+                                 const std::vector<KtxCubeMapLevel>& levels,
+                                 const QByteArray& sourceHash)
+{
+    if(!cachePath.isEmpty() &&
+       !writeKtxCubeMap(cachePath, KTX_FORMAT_RGBA8, faceSize.width(), faceSize.height(), levels,
+                        MIP_CHAIN_CACHE_KEY, sourceHash))
+    {
+        qDebug() << "Could not cache the cubemap mip chain" << cachePath;
+    }
+}
+
+/**
+ * \brief Tile source cut from the cubemap faces and their mip chain, read from the same cache the decoded cubemap
+ *        uses. The cache is memory mapped so tiles are paged in as they are read, rather than every level being
+ *        kept in memory; the levels are only held whole when the cache can't be written. Returns nullptr if the
+ *        faces are missing.
+ */
+static std::unique_ptr<TileSource> create_cube_map_tile_source()
+{
+    const auto faceSize = QImageReader(CUBEMAP_FACE_PATHS[0]).size();
+    if(!faceSize.isValid())
+    {
+        qDebug() << "Could not read the cubemap faces for the virtual texture";
+        return nullptr;
+    }
+
+    const auto numberOfLevels = mipLevelCount(faceSize.width(), faceSize.height());
+
+    std::array<QByteArray, NUMBER_OF_CUBEMAP_FACES> encodedFaces;
+    const auto sourceHash = read_cube_map_faces(encodedFaces);
+    const auto cachePath = cube_map_cache_path(sourceHash);
+
+    const auto mapCachedCubeMap = [&]() -> std::unique_ptr<KtxCubeMap>
+    {
+        auto cached = std::make_unique<KtxCubeMap>();
+        if(load_cached_cube_map(*cached, cachePath, faceSize, numberOfLevels, sourceHash, true))
+        {
+            return cached;
+        }
+
+        return nullptr;
+    };
+
+    auto cached = mapCachedCubeMap();
+    if(cached == nullptr)
+    {
+        auto levels = decode_cube_map_levels(encodedFaces, faceSize, nullptr);
+        store_cube_map_cache(cachePath, faceSize, levels, sourceHash);
+
+        cached = mapCachedCubeMap();
+        if(cached == nullptr)
+        {
+            qDebug() << "Virtual texture tiles read from mip levels held in memory";
+            return std::make_unique<CubeMapTileSource>(std::move(levels), faceSize.width(), faceSize.height(),
+                                                       VIRTUAL_TEXTURE_TILE_SIZE);
+        }
+    }
+
+    return std::make_unique<CubeMapTileSource>(std::move(cached), VIRTUAL_TEXTURE_TILE_SIZE);
+}
+
 /**
  * \brief Constructor for the globe widget. Purely used for assignment, no functions should be called here.
  */
 GlobeWidget::GlobeWidget(QWidget* parent) :
     QOpenGLWidget(parent),
+    m_coreFunctions{nullptr},
     m_shaderProgram(),
+    m_vertexFormatUniform(),
+    m_quadsPerFaceSideUniform(),
+    m_frameUniformBuffer(),
+    m_renderQueue(),
+    m_renderStateCache(),
     m_vertexArrayObject(),
     m_vertexBufferObject(QOpenGLBuffer::VertexBuffer), // constructor is pass through, no OpenGL initialization required
     m_indexBufferObject(QOpenGLBuffer::IndexBuffer), // constructor is pass through, no OpenGL initialization required
+    m_edgeBufferObject(QOpenGLBuffer::IndexBuffer), // constructor is pass through, no OpenGL initialization required
     m_texture(QOpenGLTexture::TargetCubeMap), // Constructor is pass throguh, no OpenGL initialization required
-    m_camera(0.0f, 0.0f, RADIUS_UPPER_LIMIT),
-    m_cameraAzimuth{AZIMUTH_ORIGIN},
-    m_cameraElevation{ELEVATION_ORIGIN},
-    m_cameraRadius{RADIUS_UPPER_LIMIT},
+    m_virtualTexture{nullptr},
+    m_quadTree(CHUNK_QUADS_PER_SIDE, MAXIMUM_QUADTREE_DEPTH, MAXIMUM_SCREEN_SPACE_ERROR),
+    m_chunkIndexBufferObject(QOpenGLBuffer::IndexBuffer), // constructor is pass through, no OpenGL initialization required
+    m_chunkEdgeBufferObject(QOpenGLBuffer::IndexBuffer), // constructor is pass through, no OpenGL initialization required
+    m_chunkMeshes(),
+    m_chunkPatchVertexArrayObject(),
+    m_chunkPatchVertexBufferObject(QOpenGLBuffer::VertexBuffer), // constructor is pass through, no OpenGL initialization required
+    m_chunkInstanceBufferObject(QOpenGLBuffer::VertexBuffer), // constructor is pass through, no OpenGL initialization required
+    m_chunkInstances(),
+    m_instancingChunks{false},
+    m_numberOfChunkIndices{0},
+    m_numberOfChunkEdgeIndices{0},
+    m_frameNumber{0},
+    m_camera(0.0f, 0.0f, 0.0f),
+    m_cameraController(),
+    m_cameraAnimating{false},
+    m_frameTimer(),
+    m_frameStatistics(),
+    m_numberOfHitches{0},
+    m_gpuProfiler(),
+    m_showingProfilerOverlay{false},
     m_numberOfSubdivisions{NUMBER_OF_SUBDIVISIONS},
     m_numberOfIndices{0},
-    m_renderingWireframe{false}
+    m_numberOfEdgeIndices{0},
+    m_planetVertexFormat{PLANET_VERTEX_FORMAT},
+    m_planetMeshTopology{PLANET_MESH_TOPOLOGY},
+    m_planetIndexType{GL_UNSIGNED_INT},
+    m_numberOfFaceDraws{1},
+    m_verticesPerFaceDraw{0},
+    m_numberOfTrianglesSubmitted{0},
+    m_renderingWireframe{false},
+    m_levelOfDetailEnabled{true}
 {
+    m_camera.setPosition(m_cameraController.position());
 
+    // Frames are swapped on vsync, so repainting from here paces the animation to the display
+    connect(this, &QOpenGLWidget::frameSwapped, this, &GlobeWidget::continueCameraAnimation);
 }
 
 /**
@@ -72,32 +427,48 @@ GlobeWidget::~GlobeWidget()
     m_vertexArrayObject.destroy();
     m_vertexBufferObject.destroy();
     m_indexBufferObject.destroy();
+    m_edgeBufferObject.destroy();
     m_texture.destroy();
+    m_virtualTexture.reset();
+
+    m_chunkMeshes.clear();
+    m_chunkIndexBufferObject.destroy();
+    m_chunkEdgeBufferObject.destroy();
+    m_chunkPatchVertexArrayObject.destroy();
+    m_chunkPatchVertexBufferObject.destroy();
+    m_chunkInstanceBufferObject.destroy();
+
+    m_frameUniformBuffer.destroy();
+    m_gpuProfiler.destroy();
 }
 
 /**
- * \brief Mutator for the camera radius. Radius is updated, the camera position is
- *        recalculated, and then the scene is re-drawn
+ * \brief Moves the radius the camera eases towards by one wheel notch, in the direction of wheelInput
  */
 void GlobeWidget::updateCameraRadius(const float wheelInput)
 {
-    updateRadius(RADIUS_INCREMENT * wheelInput);
-    updateCameraPosition();
-
-    this->update();
+    m_cameraController.zoom(RADIUS_INCREMENT * wheelInput);
+    startCameraAnimation();
 }
 
 /**
- * \brief Mutator for the camera position angles. Azimuth and Elevation are updated, the
- *        camera position is recalculatued, and then the scene is re-drawn.
+ * \brief Mutator for the held rotation input, each axis between -1 and 1. The camera keeps turning until the
+ *        input goes back to zero, then coasts to a stop.
  */
-void GlobeWidget::updateCameraPositionAngles(const float horizontalInput, const float verticalInput)
+void GlobeWidget::setCameraRotationInput(const float horizontalInput, const float verticalInput)
 {
-    updateAzimuth(AZIMUTH_INCREMENT * horizontalInput);
-    updateElevation(ELEVATION_INCREMENT * verticalInput);
-
-    updateCameraPosition();
+    m_cameraController.setRotationInput(horizontalInput, verticalInput);
+    startCameraAnimation();
+}
 
+/**
+ * \brief Moves the camera straight to the given azimuth and elevation, in degrees, and radius, leaving it at
+ *        rest there. Calls the parent object's update function after making the change
+ */
+void GlobeWidget::setCameraPose(const float azimuth, const float elevation, const float radius)
+{
+    m_cameraController.jumpTo(azimuth, elevation, radius);
+    m_camera.setPosition(m_cameraController.position());
     this->update();
 }
 
@@ -121,6 +492,91 @@ void GlobeWidget::disableWireframe()
     this->update();
 }
 
+/**
+ * \brief Switches rendering to the quadtree chunks, whose detail follows the camera. Calls the parent object's
+ *        update function after making the change
+ */
+void GlobeWidget::enableLevelOfDetail()
+{
+    m_levelOfDetailEnabled = true;
+    this->update();
+}
+
+/**
+ * \brief Switches rendering back to the single mesh built with m_numberOfSubdivisions. Chunk meshes are kept
+ *        around until the next frame that draws chunks releases them.
+ */
+void GlobeWidget::disableLevelOfDetail()
+{
+    m_levelOfDetailEnabled = false;
+    this->update();
+}
+
+/**
+ * \brief Has the vertex shader build the fixed planet mesh from gl_VertexID and gl_InstanceID instead of uploading
+ *        one, so startup skips generating it and its subdivisions can change at any time. Must be called before
+ *        the widget is first shown.
+ */
+void GlobeWidget::enableProceduralPlanetMesh()
+{
+    Q_ASSERT(!isValid());
+
+    m_planetVertexFormat = VertexFormat::Procedural;
+    m_planetMeshTopology = MeshTopology::TriangleList;
+}
+
+/**
+ * \brief Sets the subdivisions of the fixed planet mesh. Once it's built only the procedural mesh can follow, where
+ *        the change is a single uniform. Calls the parent object's update function after making the change
+ */
+void GlobeWidget::setNumberOfSubdivisions(const uint32_t numberOfSubdivisions)
+{
+    if(isValid() && m_planetVertexFormat != VertexFormat::Procedural)
+    {
+        qDebug() << "The planet mesh has already been uploaded, its subdivisions can't change";
+        return;
+    }
+
+    m_numberOfSubdivisions = numberOfSubdivisions;
+    this->update();
+}
+
+/**
+ * \brief Shows the average and worst CPU and GPU time of each profiled span over the last second of frames on
+ *        top of the globe. Calls the parent object's update function after making the change
+ */
+void GlobeWidget::enableProfilerOverlay()
+{
+    m_showingProfilerOverlay = true;
+    this->update();
+}
+
+/**
+ * \brief Hides the profiler overlay, the spans are still recorded for the trace. Calls the parent object's
+ *        update function after making the change
+ */
+void GlobeWidget::disableProfilerOverlay()
+{
+    m_showingProfilerOverlay = false;
+    this->update();
+}
+
+/**
+ * \brief Accessor for the number of triangles the last frame drew, none when the wireframe is on
+ */
+uint32_t GlobeWidget::numberOfTrianglesSubmitted() const
+{
+    return m_numberOfTrianglesSubmitted;
+}
+
+/**
+ * \brief Draws and state changes of the last frame, with the changes the render state cache skipped
+ */
+const RenderStatistics& GlobeWidget::renderStatistics() const
+{
+    return m_renderStateCache.statistics();
+}
+
 /**
  * \brief Standardized function when using OpenGL with Qt. All initialization that requires
  *        OpenGL function calls should be done here.
@@ -130,6 +586,21 @@ void GlobeWidget::initializeGL()
     // Qt function that MUST be done prior to any OpenGL function calls
     initializeOpenGLFunctions();
 
+    // Created first so that the uploads below are timed too
+    Profiler::instance().nameCurrentTrack(GUI_THREAD_TRACK_NAME);
+    m_gpuProfiler.create();
+
+    const ProfileScope profileScope("Initialize GL");
+
+    // Primitive restart and base vertex draws are not part of QOpenGLFunctions, so fetch the 4.1 core set
+    m_coreFunctions = QOpenGLVersionFunctionsFactory::get<QOpenGLFunctions_4_1_Core>(context());
+    if(m_coreFunctions == nullptr)
+    {
+        qDebug() << "OpenGL 4.1 core functions unavailable, triangle strips disabled";
+        m_planetMeshTopology = MeshTopology::TriangleList;
+    }
+    m_renderStateCache.initialize(m_coreFunctions);
+
     // Enable backface culling. This prevents the far face of the sphere from being simulatneously visible with the front face
     glEnable(GL_CULL_FACE);
 
@@ -138,6 +609,7 @@ void GlobeWidget::initializeGL()
     initializePlanetMesh();
     initializeCubeMap();
     initializeCamera();
+    initializeLevelOfDetail();
 }
 
 /**
@@ -146,6 +618,35 @@ void GlobeWidget::initializeGL()
  */
 void GlobeWidget::paintGL()
 {
+    Profiler::instance().beginFrame();
+    m_gpuProfiler.beginFrame();
+
+    const ProfileScope profileScope("Frame");
+    const GpuProfileScope gpuProfileScope(m_gpuProfiler, "Frame");
+
+    // Catch the camera up with the time since the last frame. The first frame of an animation follows a stretch
+    // of idling rather than another frame, so it only starts the clock.
+    if(m_cameraAnimating)
+    {
+        const ProfileScope cameraProfileScope("Advance camera");
+
+        auto elapsedMilliseconds = 0.0;
+        if(m_frameTimer.isValid())
+        {
+            elapsedMilliseconds = m_frameTimer.nsecsElapsed() / 1.0e6;
+
+            m_frameStatistics.addFrame(elapsedMilliseconds);
+            if(elapsedMilliseconds > HITCH_FRAME_TIME)
+            {
+                ++m_numberOfHitches;
+            }
+        }
+        m_frameTimer.start();
+
+        m_cameraController.advance(static_cast<float>(elapsedMilliseconds / 1000.0));
+        m_camera.setPosition(m_cameraController.position());
+    }
+
     // Needed for every frame that's rendered to screen
     const auto retinaScale = devicePixelRatio();
     glViewport(0, 0, width() * retinaScale, height() * retinaScale);
@@ -154,34 +655,75 @@ void GlobeWidget::paintGL()
     glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // Bind the relevant OpenGL objects
-    m_shaderProgram.bind();
-    m_vertexArrayObject.bind();
-    m_texture.bind();
-
-    // Generate the MVP Matrix and pass it to the shaders
+    // Generate the MVP Matrix, the chunks are culled against it before anything is drawn
     QMatrix4x4 model;
     auto view = m_camera.viewMatrixAtPosition();
 
     auto aspectRatio = static_cast<float>(width()) / static_cast<float>(height());
     auto projection = m_camera.projectionMatrix(aspectRatio);
 
-    m_shaderProgram.setUniformMatrix(MVP_MATRIX_NAME_IN_SHADERS, projection * view * model);
+    const auto modelViewProjection = projection * view * model;
 
-    // now draw the two triangles via index drawing
-    if(m_renderingWireframe)
+    // The chunks picked by the quadtree also decide which virtual texture tiles are needed, so the tree is
+    // kept up to date under the fixed mesh too. Tiles are uploaded before anything is bound for drawing.
+    const auto viewportHeight = height() * retinaScale;
+    if(m_levelOfDetailEnabled || m_virtualTexture != nullptr)
+    {
+        {
+            const ProfileScope quadTreeProfileScope("Update quadtree");
+            m_quadTree.update(m_camera, viewportHeight);
+        }
+
+        if(CULL_CHUNKS)
+        {
+            const ProfileScope cullProfileScope("Cull chunks");
+            m_quadTree.cull(ViewFrustum(modelViewProjection), m_camera.position(), CHUNK_SKIRT_DEPTH_SCALE);
+        }
+    }
+
+    if(m_virtualTexture != nullptr)
+    {
+        requestVirtualTextureTiles(viewportHeight);
+    }
+
+    // Record the frame's draws, then sort them so that draws sharing state are submitted back to back
+    m_renderQueue.clear();
+    if(m_levelOfDetailEnabled)
     {
-        glDrawElements(GL_LINES, m_numberOfIndices, GL_UNSIGNED_INT, nullptr);
+        queueChunks();
     }
     else
     {
-        glDrawElements(GL_TRIANGLES, m_numberOfIndices, GL_UNSIGNED_INT, nullptr);
+        queuePlanetMesh();
     }
+    m_renderQueue.sort();
 
-    // Release the relevant OpenGL objects
-    m_texture.release();
-    m_vertexArrayObject.release();
-    m_shaderProgram.release();
+    {
+        const ProfileScope uniformProfileScope("Set frame uniforms");
+
+        FrameUniforms frameUniforms;
+        std::memcpy(frameUniforms.modelViewProjection, modelViewProjection.constData(),
+                    sizeof(frameUniforms.modelViewProjection));
+        m_frameUniformBuffer.update(&frameUniforms, sizeof(frameUniforms));
+    }
+
+    {
+        const ProfileScope submitProfileScope("Submit draw queue");
+        const GpuProfileScope drawProfileScope(m_gpuProfiler, "Draw planet");
+
+        m_renderQueue.submit(m_renderStateCache);
+    }
+
+    if(m_showingProfilerOverlay)
+    {
+        drawProfilerOverlay();
+    }
+
+    // Tiles past this frame's upload budget stream in over the following frames
+    if(m_virtualTexture != nullptr && m_virtualTexture->hasPendingTiles())
+    {
+        this->update();
+    }
 }
 
 /**
@@ -198,7 +740,21 @@ void GlobeWidget::resizeGL(int, int)
  */
 void GlobeWidget::initializeShaderProgram()
 {
-    m_shaderProgram.create(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH);
+    const ProfileScope profileScope("Initialize shader program");
+
+    m_shaderProgram.create(VERTEX_SHADER_PATH, FRAGMENT_SHADER_PATH, USE_PROGRAM_BINARY_CACHE);
+    if(!m_shaderProgram.isCreated())
+    {
+        return;
+    }
+
+    // Uniforms set while drawing are looked up once here, the rest are set once by name during initialization
+    m_vertexFormatUniform = m_shaderProgram.uniform<GLint>(VERTEX_FORMAT_NAME_IN_SHADERS);
+    m_quadsPerFaceSideUniform = m_shaderProgram.uniform<GLint>(QUADS_PER_FACE_SIDE_NAME_IN_SHADERS);
+
+    // The MVP goes to every program through one buffer, filled once per frame in paintGL()
+    m_frameUniformBuffer.create(FRAME_UNIFORMS_BINDING, sizeof(FrameUniforms));
+    m_shaderProgram.bindUniformBlock(FRAME_UNIFORMS_BLOCK_NAME, FRAME_UNIFORMS_BINDING);
 }
 
 /**
@@ -207,9 +763,17 @@ void GlobeWidget::initializeShaderProgram()
  */
 void GlobeWidget::initializePlanetMesh()
 {
+    const ProfileScope profileScope("Initialize planet mesh");
+
     // Ensure that m_shaderProgram has been initialized prior to continuing
     Q_ASSERT(m_shaderProgram.isCreated());
 
+    if(m_planetVertexFormat == VertexFormat::Procedural)
+    {
+        initializeProceduralPlanetMesh();
+        return;
+    }
+
     // Create the VBO
     m_vertexBufferObject.create();
     m_vertexBufferObject.setUsagePattern(QOpenGLBuffer::StaticDraw);
@@ -226,6 +790,14 @@ void GlobeWidget::initializePlanetMesh()
         qDebug() << "Could not create index buffer object";
     }
 
+    // Create the edge index buffer used for wireframe rendering
+    m_edgeBufferObject.create();
+    m_edgeBufferObject.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    if(!m_edgeBufferObject.isCreated())
+    {
+        qDebug() << "Could not create edge index buffer object";
+    }
+
     // Create the VAO
     m_vertexArrayObject.create();
     if(!m_vertexArrayObject.isCreated())
@@ -233,138 +805,1022 @@ void GlobeWidget::initializePlanetMesh()
         qDebug() << "Could not create VAO!";
     }
 
-    // Generate the model for the sphere
-    const auto [vertices, indices] = generateSubdividedCube(m_numberOfSubdivisions);
+    // Welding, reordering and re-encoding all need a CPU copy of the mesh. Without any of them the generator
+    // writes straight into the mapped GL buffers and the intermediate vectors are never allocated.
+    // Strips rely on each face keeping its own contiguous block of vertices, so they skip the optimization.
+    const auto optimizingMesh = OPTIMIZE_PLANET_MESH && m_planetMeshTopology == MeshTopology::TriangleList;
+    const auto uploadingAsGenerated = !optimizingMesh && m_planetVertexFormat == VertexFormat::Float32;
+
+    MeshCache cache({ m_numberOfSubdivisions, m_planetVertexFormat, m_planetMeshTopology, optimizingMesh });
+    const auto loadedFromCache = USE_PLANET_MESH_CACHE && cache.load();
+
+    std::vector<uint32_t> edges;
 
     m_vertexArrayObject.bind();
     m_vertexBufferObject.bind();
     m_indexBufferObject.bind();
 
-    // Allocate the memory needed for the vertex and index buffers respectively
-    m_vertexBufferObject.allocate(vertices.data(), vertices.size() * sizeof(float));
-    m_indexBufferObject.allocate(indices.data(), indices.size() * sizeof(uint32_t));
-
-    // NOTE: the following will assert if this function is called before the shaderProgram is initialized
-    // Assign position 0 to be the vertices of the globe
-    auto stride = (3 * sizeof(float));
-    m_shaderProgram.setAttribute(0, GL_FLOAT, 0, 3, stride);
+    if(loadedFromCache)
+    {
+        uploadCachedPlanetMesh(cache);
+    }
+    else if(uploadingAsGenerated && generatePlanetMeshIntoMappedBuffers())
+    {
+        edges = generateSubdividedCubeEdges(m_numberOfSubdivisions);
+        uploadPlanetStripIndices(nullptr);
+    }
+    else
+    {
+        edges = uploadGeneratedPlanetMesh(optimizingMesh, USE_PLANET_MESH_CACHE ? &cache : nullptr);
+    }
 
-    // Record the number of indices used in the operation above. Needed for glDrawElements()
-    m_numberOfIndices = indices.size();
+    // Assign the attribute matching the vertex format
+    // NOTE: setAttribute() will assert if this function is called before the shaderProgram is initialized
+    if(m_planetVertexFormat == VertexFormat::Octahedral16)
+    {
+        m_shaderProgram.setAttribute(OCTAHEDRAL_ATTRIBUTE_LOCATION, GL_SHORT, 0, 2, 2 * sizeof(int16_t));
+    }
+    else
+    {
+        m_shaderProgram.setAttribute(POSITION_ATTRIBUTE_LOCATION, GL_FLOAT, 0, 3, 3 * sizeof(float));
+    }
 
     m_vertexArrayObject.release();
     m_vertexBufferObject.release();
     m_indexBufferObject.release();
-}
 
-/**
-  * \brief Utility function to handle creation of m_camera.
-  */
-void GlobeWidget::initializeCamera()
-{
-    m_camera.setFieldOfView(DEFAULT_FIELD_OF_VIEW);
-    m_camera.setDistanceToNearPlane(DEFAULT_NEAR_PLANE_DISTANCE);
-    m_camera.setDistanceToFarPlane(DEFAULT_FAR_PLANE_DISTANCE);
+    // Every edge of the mesh once, drawn in place of the triangles when the wireframe is on
+    m_edgeBufferObject.bind();
+    if(loadedFromCache)
+    {
+        m_edgeBufferObject.allocate(cache.edges(), cache.edgeBytes());
+        m_numberOfEdgeIndices = cache.edgeBytes() / sizeof(uint32_t);
+    }
+    else
+    {
+        m_edgeBufferObject.allocate(edges.data(), edges.size() * sizeof(uint32_t));
+        m_numberOfEdgeIndices = edges.size();
+    }
+    m_edgeBufferObject.release();
 }
 
 /**
- * \brief Utility function to handle creation of m_texture as a cubemap.
+ * \brief The procedural planet mesh has no buffers at all, but the core profile only draws with a vertex array
+ *        bound, so an empty one is created for it
  */
-void GlobeWidget::initializeCubeMap()
+void GlobeWidget::initializeProceduralPlanetMesh()
 {
-    auto positiveX = QImage(CUBEMAP_POSITIVE_X_PATH).convertToFormat(QImage::Format_RGBA8888);
-    auto negativeX = QImage(CUBEMAP_NEGATIVE_X_PATH).convertToFormat(QImage::Format_RGBA8888);
-    auto positiveY = QImage(CUBEMAP_POSITIVE_Y_PATH).convertToFormat(QImage::Format_RGBA8888);
-    auto negativeY = QImage(CUBEMAP_NEGATIVE_Y_PATH).convertToFormat(QImage::Format_RGBA8888);
-    auto positiveZ = QImage(CUBEMAP_POSITIVE_Z_PATH).convertToFormat(QImage::Format_RGBA8888);
-    auto negativeZ = QImage(CUBEMAP_NEGATIVE_Z_PATH).convertToFormat(QImage::Format_RGBA8888);
-
-    m_texture.create();
-    m_texture.setSize(positiveX.width(), positiveX.height(), positiveX.depth());
-    m_texture.setFormat(QOpenGLTexture::RGBA8_UNorm);
-    m_texture.allocateStorage();
-
-    m_texture.setData(0, 0, QOpenGLTexture::CubeMapPositiveX, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, positiveX.constBits());
-    m_texture.setData(0, 0, QOpenGLTexture::CubeMapNegativeX, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, negativeX.constBits());
-    m_texture.setData(0, 0, QOpenGLTexture::CubeMapPositiveY, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, positiveY.constBits());
-    m_texture.setData(0, 0, QOpenGLTexture::CubeMapNegativeY, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, negativeY.constBits());
-    m_texture.setData(0, 0, QOpenGLTexture::CubeMapPositiveZ, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, positiveZ.constBits());
-    m_texture.setData(0, 0, QOpenGLTexture::CubeMapNegativeZ, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8, negativeZ.constBits());
-
-    m_texture.setWrapMode(QOpenGLTexture::ClampToEdge);
-    m_texture.setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
-    m_texture.setMagnificationFilter(QOpenGLTexture::LinearMipMapLinear);
+    m_vertexArrayObject.create();
+    if(!m_vertexArrayObject.isCreated())
+    {
+        qDebug() << "Could not create VAO!";
+    }
 
-    m_shaderProgram.setUniformValue(CUBEMAP_NAME_IN_SHADERS, 0);
+    qDebug() << "Planet mesh built by the vertex shader, no buffers uploaded";
 }
 
 /**
- * \brief Utility function to sanitize changes to m_cameraAzimuth.
+ * \brief Generates, optionally optimizes and encodes the planet mesh on the CPU and uploads it to the bound VBO
+ *        and IBO. Each buffer is also appended to the cache, when one is given, as soon as it is uploaded.
+ *        Returns the edge list, which is uploaded separately once the VAO is released.
  */
-void GlobeWidget::updateAzimuth(const float difference)
+std::vector<uint32_t> GlobeWidget::uploadGeneratedPlanetMesh(const bool optimizingMesh, MeshCache* cache)
 {
-    // Input sanitization
-    Q_ASSERT(difference <= AZIMUTH_UPPER_LIMIT && difference >= AZIMUTH_LOWER_LIMIT);
+    const auto storing = (cache != nullptr) && cache->beginStore();
 
-    // Wrap the azimuth once it's gone over
-    m_cameraAzimuth += difference;
-    if(m_cameraAzimuth > AZIMUTH_UPPER_LIMIT || m_cameraAzimuth < AZIMUTH_LOWER_LIMIT)
-    {
-        m_cameraAzimuth = AZIMUTH_ORIGIN;
+    // Generate the model for the sphere
+    auto [vertices, indices] = generateSubdividedCube(m_numberOfSubdivisions);
+    auto edges = generateSubdividedCubeEdges(m_numberOfSubdivisions);
+
+    // Optionally weld the seams between faces and reorder the triangles for the post-transform vertex cache
+    if(optimizingMesh)
+    {
+        const ProfileScope profileScope("Optimize planet mesh");
+
+        const auto report = optimizeMesh(vertices, indices, edges);
+        qDebug() << "Planet mesh vertices:" << report.verticesBefore << "->" << report.verticesAfter
+                 << "ACMR:" << report.acmrBefore << "->" << report.acmrAfter;
+    }
+
+    // Allocate the memory needed for the vertices in the selected format
+    if(m_planetVertexFormat == VertexFormat::Octahedral16)
+    {
+        const auto encoded = encodeOctahedral(vertices);
+        const auto report = octahedralEncodingReport(vertices, encoded);
+        qDebug() << "Planet vertex buffer bytes:" << report.bytesBefore << "->" << report.bytesAfter
+                 << "maximum error (m):" << report.maximumAngularError * EARTH_RADIUS_IN_METERS
+                 << "mean error (m):" << report.meanAngularError * EARTH_RADIUS_IN_METERS;
+
+        m_vertexBufferObject.allocate(encoded.data(), encoded.size() * sizeof(int16_t));
+        if(storing)
+        {
+            cache->storeVertices(encoded.data(), encoded.size() * sizeof(int16_t));
+        }
+    }
+    else
+    {
+        m_vertexBufferObject.allocate(vertices.data(), vertices.size() * sizeof(float));
+        if(storing)
+        {
+            cache->storeVertices(vertices.data(), vertices.size() * sizeof(float));
+        }
+    }
+
+    if(m_planetMeshTopology == MeshTopology::TriangleList)
+    {
+        m_indexBufferObject.allocate(indices.data(), indices.size() * sizeof(uint32_t));
+        if(storing)
+        {
+            cache->storeIndices(indices.data(), indices.size() * sizeof(uint32_t), sizeof(uint32_t));
+        }
+
+        m_numberOfIndices = indices.size();
+    }
+    else
+    {
+        uploadPlanetStripIndices(storing ? cache : nullptr);
+    }
+
+    if(storing)
+    {
+        cache->storeEdges(edges.data(), edges.size() * sizeof(uint32_t));
+        cache->commitStore();
+    }
+
+    return edges;
+}
+
+/**
+ * \brief Uploads the planet mesh from a loaded cache to the bound VBO and IBO. The cache holds the buffers
+ *        exactly as uploaded, so only the index type has to be recovered from it.
+ */
+void GlobeWidget::uploadCachedPlanetMesh(const MeshCache& cache)
+{
+    m_vertexBufferObject.allocate(cache.vertices(), cache.vertexBytes());
+    m_indexBufferObject.allocate(cache.indices(), cache.indexBytes());
+
+    m_numberOfIndices = cache.indexBytes() / cache.indexSize();
+
+    // 16-bit indices are only ever written for the per-face strips
+    if(cache.indexSize() == sizeof(uint16_t))
+    {
+        m_planetIndexType = GL_UNSIGNED_SHORT;
+        m_numberOfFaceDraws = NUMBER_OF_CUBE_FACES;
+        m_verticesPerFaceDraw = (m_numberOfSubdivisions + 2U) * (m_numberOfSubdivisions + 2U);
+    }
+
+    qDebug() << "Planet mesh loaded from cache:" << cache.vertexBytes() + cache.indexBytes() + cache.edgeBytes()
+             << "bytes";
+}
+
+/**
+ * \brief Strips of a face small enough for 16-bit indices are uploaded once and drawn six times with a base
+ *        vertex offset. Denser meshes fall back to a single strip buffer with 32-bit indices.
+ *        Records the number of indices uploaded in each case, needed for glDrawElements(). Does nothing for
+ *        triangle lists.
+ */
+void GlobeWidget::uploadPlanetStripIndices(MeshCache* cache)
+{
+    if(m_planetMeshTopology != MeshTopology::TriangleStrip)
+    {
+        return;
+    }
+
+    if(cubeFaceFitsIn16BitIndices(m_numberOfSubdivisions))
+    {
+        const auto faceIndices = generateCubeFaceStripIndices16(m_numberOfSubdivisions);
+        m_indexBufferObject.allocate(faceIndices.data(), faceIndices.size() * sizeof(uint16_t));
+        if(cache != nullptr)
+        {
+            cache->storeIndices(faceIndices.data(), faceIndices.size() * sizeof(uint16_t), sizeof(uint16_t));
+        }
+
+        m_numberOfIndices = faceIndices.size();
+        m_planetIndexType = GL_UNSIGNED_SHORT;
+        m_numberOfFaceDraws = NUMBER_OF_CUBE_FACES;
+        m_verticesPerFaceDraw = (m_numberOfSubdivisions + 2U) * (m_numberOfSubdivisions + 2U);
+    }
+    else
+    {
+        const auto stripIndices = generateSubdividedCubeStripIndices(m_numberOfSubdivisions);
+        m_indexBufferObject.allocate(stripIndices.data(), stripIndices.size() * sizeof(uint32_t));
+        if(cache != nullptr)
+        {
+            cache->storeIndices(stripIndices.data(), stripIndices.size() * sizeof(uint32_t), sizeof(uint32_t));
+        }
+
+        m_numberOfIndices = stripIndices.size();
+    }
+}
+
+/**
+ * \brief Sizes the bound VBO, and the bound IBO for triangle lists, then maps them and has the generator write
+ *        the mesh into them directly. Returns false, leaving nothing mapped, if the driver refuses to map or
+ *        loses the contents before they are unmapped, in which case the caller uploads from vectors instead.
+ */
+bool GlobeWidget::generatePlanetMeshIntoMappedBuffers()
+{
+    const auto writingIndices = (m_planetMeshTopology == MeshTopology::TriangleList);
+    const auto vertexCapacity = subdividedCubeVertexCount(m_numberOfSubdivisions) * 3UL;
+    const auto indexCapacity = writingIndices ? subdividedCubeIndexCount(m_numberOfSubdivisions) : 0UL;
+    const auto access = QOpenGLBuffer::RangeWrite | QOpenGLBuffer::RangeInvalidateBuffer;
+
+    m_vertexBufferObject.allocate(vertexCapacity * sizeof(float));
+    auto* vertices = static_cast<float*>(m_vertexBufferObject.mapRange(0, vertexCapacity * sizeof(float), access));
+
+    uint32_t* indices = nullptr;
+    if(writingIndices)
+    {
+        m_indexBufferObject.allocate(indexCapacity * sizeof(uint32_t));
+        indices = static_cast<uint32_t*>(m_indexBufferObject.mapRange(0, indexCapacity * sizeof(uint32_t), access));
+    }
+
+    auto generated = false;
+    if(vertices != nullptr && (!writingIndices || indices != nullptr))
+    {
+        generated = generateSubdividedCubeInto(m_numberOfSubdivisions, vertices, vertexCapacity, indices, indexCapacity);
+    }
+
+    // unmap() reports false if the buffer contents were lost while mapped, so both have to be unmapped and checked
+    if(vertices != nullptr && !m_vertexBufferObject.unmap())
+    {
+        generated = false;
+    }
+
+    if(indices != nullptr && !m_indexBufferObject.unmap())
+    {
+        generated = false;
+    }
+
+    if(!generated)
+    {
+        qDebug() << "Could not generate the planet mesh into mapped buffers";
+        return false;
+    }
+
+    m_numberOfIndices = indexCapacity;
+    return true;
+}
+
+/**
+  * \brief Utility function to handle creation of m_camera.
+  */
+void GlobeWidget::initializeCamera()
+{
+    m_camera.setFieldOfView(DEFAULT_FIELD_OF_VIEW);
+    m_camera.setDistanceToNearPlane(DEFAULT_NEAR_PLANE_DISTANCE);
+    m_camera.setDistanceToFarPlane(DEFAULT_FAR_PLANE_DISTANCE);
+}
+
+/**
+ * \brief Utility function to handle creation of m_virtualTexture, or of m_texture as a cubemap without it.
+ */
+void GlobeWidget::initializeCubeMap()
+{
+    const ProfileScope profileScope("Initialize cube map");
+
+    // The virtual texture streams tiles of the faces into a fixed-size atlas and takes the place of m_texture
+    if(USE_VIRTUAL_TEXTURE && initializeVirtualTexture())
+    {
+        return;
+    }
+
+    // A cubemap precompressed by tools/ktx_converter is uploaded as is, otherwise the face images are decoded
+    if(!initializeCompressedCubeMap())
+    {
+        initializeDecodedCubeMap();
+    }
+
+    m_texture.setWrapMode(QOpenGLTexture::ClampToEdge);
+    m_texture.setMinificationFilter(QOpenGLTexture::LinearMipMapLinear);
+    m_texture.setMagnificationFilter(QOpenGLTexture::Linear);
+
+    m_shaderProgram.setUniformValue(m_shaderProgram.uniform<GLint>(CUBEMAP_NAME_IN_SHADERS), 0);
+}
+
+/**
+ * \brief Loads the BC1 cubemap with all of its mip levels from CUBEMAP_KTX_PATH into m_texture. Returns false,
+ *        leaving m_texture untouched, if the file is absent, unreadable, in another format, or the driver can't
+ *        sample S3TC textures.
+ */
+bool GlobeWidget::initializeCompressedCubeMap()
+{
+    if(!QFile::exists(CUBEMAP_KTX_PATH))
+    {
+        return false;
+    }
+
+    if(!context()->hasExtension(QByteArrayLiteral("GL_EXT_texture_compression_s3tc")))
+    {
+        qDebug() << "S3TC textures are not supported, decoding the cubemap images instead";
+        return false;
+    }
+
+    KtxCubeMap cubeMap;
+    if(!cubeMap.load(CUBEMAP_KTX_PATH))
+    {
+        return false;
+    }
+
+    if(cubeMap.glInternalFormat() != KTX_GL_COMPRESSED_RGB_S3TC_DXT1)
+    {
+        qDebug() << "Unsupported compressed cubemap format" << cubeMap.glInternalFormat();
+        return false;
+    }
+
+    m_texture.create();
+    m_texture.setSize(cubeMap.width(), cubeMap.height());
+    m_texture.setFormat(QOpenGLTexture::RGB_DXT1);
+    m_texture.setMipLevels(cubeMap.mipLevels());
+    m_texture.setAutoMipMapGenerationEnabled(false); // Every level comes from the file
+    m_texture.allocateStorage();
+
+    for(auto level = 0U; level < cubeMap.mipLevels(); ++level)
+    {
+        for(auto face = 0U; face < NUMBER_OF_CUBEMAP_FACES; ++face)
+        {
+            const auto target = static_cast<QOpenGLTexture::CubeMapFace>(QOpenGLTexture::CubeMapPositiveX + face);
+            m_texture.setCompressedData(level, 0, target, cubeMap.faceSize(level), cubeMap.faceData(level, face));
+        }
+    }
+
+    return true;
+}
+
+/**
+ * \brief Fills m_texture as RGBA8 with a full, gamma-correct mip chain built on the CPU. The chain is keyed by a
+ *        hash of the encoded face images and saved to the cache directory, so later runs upload the saved file
+ *        without decoding or filtering anything. m_texture is left empty if the faces can't be read.
+ */
+void GlobeWidget::initializeDecodedCubeMap()
+{
+    // Every face has the same size, so the header of the first one is enough to size the texture
+    const auto faceSize = QImageReader(CUBEMAP_FACE_PATHS[0]).size();
+    if(!faceSize.isValid())
+    {
+        qDebug() << "Could not read the cubemap faces";
+        return;
+    }
+
+    const auto numberOfLevels = mipLevelCount(faceSize.width(), faceSize.height());
+
+    // Reading the encoded images is cheap next to decoding them, and identifies the cached chain
+    std::array<QByteArray, NUMBER_OF_CUBEMAP_FACES> encodedFaces;
+    const auto sourceHash = read_cube_map_faces(encodedFaces);
+    const auto cachePath = cube_map_cache_path(sourceHash);
+
+    KtxCubeMap cached;
+    if(load_cached_cube_map(cached, cachePath, faceSize, numberOfLevels, sourceHash))
+    {
+        allocate_rgba8_cube_map(m_texture, faceSize, numberOfLevels);
+
+        for(auto level = 0U; level < numberOfLevels; ++level)
+        {
+            for(auto face = 0U; face < NUMBER_OF_CUBEMAP_FACES; ++face)
+            {
+                const auto target = static_cast<QOpenGLTexture::CubeMapFace>(QOpenGLTexture::CubeMapPositiveX + face);
+                m_texture.setData(level, 0, target, QOpenGLTexture::RGBA, QOpenGLTexture::UInt8,
+                                  cached.faceData(level, face));
+            }
+        }
+
+        return;
+    }
+
+    // Level by level layout of the pixel buffer, every face of a level next to each other
+    std::vector<size_t> levelOffsets(numberOfLevels);
+    auto pixelBufferBytes = static_cast<size_t>(0U);
+
+    for(auto level = 0U; level < numberOfLevels; ++level)
+    {
+        levelOffsets[level] = pixelBufferBytes;
+        pixelBufferBytes += static_cast<size_t>(qMax(faceSize.width() >> level, 1)) *
+                            qMax(faceSize.height() >> level, 1) * RGBA8888_BYTES_PER_PIXEL * NUMBER_OF_CUBEMAP_FACES;
+    }
+
+    allocate_rgba8_cube_map(m_texture, faceSize, numberOfLevels);
+
+    // The faces are decoded and filtered on the task scheduler, each writing its chain straight into a mapped
+    // pixel buffer, so the GL thread only queues the transfers instead of blocking on each one
+    QOpenGLBuffer pixelBuffer(QOpenGLBuffer::PixelUnpackBuffer);
+    pixelBuffer.create();
+    pixelBuffer.setUsagePattern(QOpenGLBuffer::StreamDraw);
+    pixelBuffer.bind();
+    pixelBuffer.allocate(pixelBufferBytes);
+
+    auto* pixels = static_cast<uchar*>(pixelBuffer.mapRange(0, pixelBufferBytes,
+                                                            QOpenGLBuffer::RangeWrite |
+                                                            QOpenGLBuffer::RangeInvalidateBuffer));
+
+    const auto levels = decode_cube_map_levels(encodedFaces, faceSize, [&](const uint32_t face,
+                                                                           const std::vector<KtxCubeMapLevel>& decoded)
+    {
+        if(pixels != nullptr)
+        {
+            for(auto level = 0U; level < numberOfLevels; ++level)
+            {
+                const auto& data = decoded[level][face];
+                std::memcpy(pixels + levelOffsets[level] + (face * data.size()), data.data(), data.size());
+            }
+        }
+    });
+
+    // unmap() fails if the buffer contents were lost while mapped, in which case the chain is uploaded from
+    // client memory instead
+    const auto uploadingFromPixelBuffer = (pixels != nullptr) && pixelBuffer.unmap();
+    if(!uploadingFromPixelBuffer)
+    {
+        pixelBuffer.release();
+    }
+
+    const GpuProfileScope gpuProfileScope(m_gpuProfiler, "Upload cube map");
+
+    m_texture.bind();
+
+    for(auto level = 0U; level < numberOfLevels; ++level)
+    {
+        const auto levelWidth = qMax(faceSize.width() >> level, 1);
+        const auto levelHeight = qMax(faceSize.height() >> level, 1);
+
+        for(auto face = 0U; face < NUMBER_OF_CUBEMAP_FACES; ++face)
+        {
+            // With a pixel unpack buffer bound the data pointer is an offset into it
+            const auto& faceData = levels[level][face];
+            const auto* data = uploadingFromPixelBuffer
+                             ? reinterpret_cast<const void*>(levelOffsets[level] + (face * faceData.size()))
+                             : static_cast<const void*>(faceData.data());
+
+            glTexSubImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, 0, 0, levelWidth, levelHeight,
+                            GL_RGBA, GL_UNSIGNED_BYTE, data);
+        }
+    }
+
+    m_texture.release();
+
+    // Deleting the buffer only drops this reference, the driver keeps it alive until the transfers complete
+    if(uploadingFromPixelBuffer)
+    {
+        pixelBuffer.release();
+    }
+    pixelBuffer.destroy();
+
+    store_cube_map_cache(cachePath, faceSize, levels, sourceHash);
+}
+
+/**
+ * \brief Builds m_virtualTexture from the tile pack at TILE_PACK_PATH, or from the cubemap faces without one.
+ *        Only the tiles the camera needs are ever uploaded, so m_texture is left empty. Returns false if there
+ *        is nothing to build it from or the atlas could not be created.
+ */
+bool GlobeWidget::initializeVirtualTexture()
+{
+    // A tile pack is mapped and read a tile at a time, the cubemap faces are decoded whole
+    std::unique_ptr<TileSource> source;
+
+    auto tilePack = std::make_unique<TilePack>();
+    if(QFile::exists(TILE_PACK_PATH) && tilePack->load(TILE_PACK_PATH))
+    {
+        qDebug() << "Virtual texture tiles mapped from" << TILE_PACK_PATH;
+        source = std::move(tilePack);
+    }
+    else
+    {
+        source = create_cube_map_tile_source();
+    }
+
+    if(source == nullptr)
+    {
+        return false;
+    }
+
+    m_virtualTexture = std::make_unique<VirtualTexture>(std::move(source), VIRTUAL_TEXTURE_ATLAS_TILES_PER_SIDE,
+                                                        VIRTUAL_TEXTURE_UPLOADS_PER_FRAME);
+    if(!m_virtualTexture->create())
+    {
+        m_virtualTexture.reset();
+        return false;
+    }
+
+    const auto setUniform = [this](const char* name, const GLint value)
+    {
+        m_shaderProgram.setUniformValue(m_shaderProgram.uniform<GLint>(name), value);
+    };
+
+    setUniform(VIRTUAL_TEXTURING_NAME_IN_SHADERS, 1);
+    setUniform(TILE_ATLAS_NAME_IN_SHADERS, TILE_ATLAS_TEXTURE_UNIT);
+    setUniform(PAGE_TABLE_NAME_IN_SHADERS, PAGE_TABLE_TEXTURE_UNIT);
+    setUniform(PAGE_TABLE_SIZE_NAME_IN_SHADERS, m_virtualTexture->pageTableSize());
+    setUniform(TILE_SIZE_NAME_IN_SHADERS, m_virtualTexture->tileSize());
+    setUniform(TILE_BORDER_NAME_IN_SHADERS, VIRTUAL_TEXTURE_TILE_BORDER);
+    setUniform(ATLAS_SIZE_NAME_IN_SHADERS, m_virtualTexture->atlasSize());
+
+    return true;
+}
+
+/**
+ * \brief Utility function to handle creation of m_chunkIndexBufferObject. Every chunk has the same topology,
+ *        so one index buffer is shared by all of the chunk vertex array objects.
+ */
+void GlobeWidget::initializeLevelOfDetail()
+{
+    const ProfileScope profileScope("Initialize level of detail");
+
+    m_chunkIndexBufferObject.create();
+    m_chunkIndexBufferObject.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    if(!m_chunkIndexBufferObject.isCreated())
+    {
+        qDebug() << "Could not create chunk index buffer object";
+    }
+
+    const auto indices = generateCubeFaceChunkIndices(m_quadTree.quadsPerChunkSide());
+
+    m_chunkIndexBufferObject.bind();
+    m_chunkIndexBufferObject.allocate(indices.data(), indices.size() * sizeof(uint32_t));
+    m_chunkIndexBufferObject.release();
+
+    m_numberOfChunkIndices = indices.size();
+
+    m_chunkEdgeBufferObject.create();
+    m_chunkEdgeBufferObject.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    if(!m_chunkEdgeBufferObject.isCreated())
+    {
+        qDebug() << "Could not create chunk edge index buffer object";
+    }
+
+    const auto edges = generateCubeFaceChunkEdges(m_quadTree.quadsPerChunkSide());
+
+    m_chunkEdgeBufferObject.bind();
+    m_chunkEdgeBufferObject.allocate(edges.data(), edges.size() * sizeof(uint32_t));
+    m_chunkEdgeBufferObject.release();
+
+    m_numberOfChunkEdgeIndices = edges.size();
+
+    if(USE_INSTANCED_CHUNKS)
+    {
+        initializeChunkPatch();
+    }
+}
+
+/**
+ * \brief Uploads the grid patch every chunk is drawn from when instanced, and sets up m_chunkPatchVertexArrayObject
+ *        to read it per vertex and a ChunkInstance per instance. Chunks keep meshes of their own if this fails.
+ */
+void GlobeWidget::initializeChunkPatch()
+{
+    m_chunkPatchVertexArrayObject.create();
+    m_chunkPatchVertexBufferObject.create();
+    m_chunkInstanceBufferObject.create();
+    if(!m_chunkPatchVertexArrayObject.isCreated() || !m_chunkPatchVertexBufferObject.isCreated() ||
+       !m_chunkInstanceBufferObject.isCreated())
+    {
+        qDebug() << "Could not create the chunk patch buffers, chunks get meshes of their own";
+        return;
+    }
+
+    m_chunkPatchVertexBufferObject.setUsagePattern(QOpenGLBuffer::StaticDraw);
+    m_chunkInstanceBufferObject.setUsagePattern(QOpenGLBuffer::StreamDraw);
+
+    const auto patch = generateCubeFaceChunkPatch(m_quadTree.quadsPerChunkSide());
+
+    m_chunkPatchVertexArrayObject.bind();
+
+    m_chunkPatchVertexBufferObject.bind();
+    m_chunkPatchVertexBufferObject.allocate(patch.data(), patch.size() * sizeof(float));
+    m_shaderProgram.setAttribute(PATCH_ATTRIBUTE_LOCATION, GL_FLOAT, 0, 3, 3 * sizeof(float));
+
+    // The instance attributes advance once per chunk rather than once per vertex
+    auto* functions = context()->extraFunctions();
+
+    m_chunkInstanceBufferObject.bind();
+    m_shaderProgram.setAttribute(CHUNK_ATTRIBUTE_LOCATION, GL_FLOAT, offsetof(ChunkInstance, s), 4, sizeof(ChunkInstance));
+    functions->glVertexAttribDivisor(CHUNK_ATTRIBUTE_LOCATION, 1);
+
+    functions->glEnableVertexAttribArray(FACE_ATTRIBUTE_LOCATION);
+    functions->glVertexAttribIPointer(FACE_ATTRIBUTE_LOCATION, 1, GL_UNSIGNED_INT, sizeof(ChunkInstance),
+                                      reinterpret_cast<const void*>(offsetof(ChunkInstance, face)));
+    functions->glVertexAttribDivisor(FACE_ATTRIBUTE_LOCATION, 1);
+
+    m_chunkIndexBufferObject.bind();
+
+    m_chunkPatchVertexArrayObject.release();
+    m_chunkPatchVertexBufferObject.release();
+    m_chunkInstanceBufferObject.release();
+    m_chunkIndexBufferObject.release();
+
+    m_instancingChunks = true;
+}
+
+/**
+ * \brief The texture the planet is drawn with, as a binding for the render queue
+ */
+static TextureBinding texture_binding(const QOpenGLTexture& texture, const GLuint unit)
+{
+    return { static_cast<GLenum>(texture.target()), texture.textureId(), unit };
+}
+
+/**
+ * \brief Command with the program and textures every planet draw shares, the geometry is left to the caller
+ */
+DrawCommand GlobeWidget::planetDrawCommand()
+{
+    DrawCommand command{};
+    command.program = &m_shaderProgram;
+    command.uniform = m_vertexFormatUniform;
+
+    if(m_virtualTexture != nullptr)
+    {
+        command.textures[0] = texture_binding(m_virtualTexture->atlas(), TILE_ATLAS_TEXTURE_UNIT);
+        command.textures[1] = texture_binding(m_virtualTexture->pageTable(), PAGE_TABLE_TEXTURE_UNIT);
+    }
+    else
+    {
+        command.textures[0] = texture_binding(m_texture, 0U);
+    }
+
+    return command;
+}
+
+/**
+ * \brief Queues the single planet mesh built by initializePlanetMesh(), one draw per face for triangle strips
+ */
+void GlobeWidget::queuePlanetMesh()
+{
+    const ProfileScope profileScope("Queue planet mesh");
+
+    // Strips draw the same triangles as the list, so the list's size counts them for either topology
+    m_numberOfTrianglesSubmitted = m_renderingWireframe
+                                 ? 0U
+                                 : static_cast<uint32_t>(subdividedCubeIndexCount(m_numberOfSubdivisions) / 3U);
+
+    auto command = planetDrawCommand();
+    command.uniformValue = static_cast<GLint>(m_planetVertexFormat);
+    command.vertexArray = m_vertexArrayObject.objectId();
+
+    if(m_planetVertexFormat == VertexFormat::Procedural)
+    {
+        queueProceduralPlanetMesh(command);
+    }
+    else if(m_renderingWireframe)
+    {
+        command.elementBuffer = m_edgeBufferObject.bufferId();
+        command.mode = GL_LINES;
+        command.count = static_cast<GLsizei>(m_numberOfEdgeIndices);
+        command.indexType = GL_UNSIGNED_INT;
+        m_renderQueue.record(command);
+    }
+    else if(m_planetMeshTopology == MeshTopology::TriangleStrip)
+    {
+        command.elementBuffer = m_indexBufferObject.bufferId();
+        command.mode = GL_TRIANGLE_STRIP;
+        command.count = static_cast<GLsizei>(m_numberOfIndices);
+        command.indexType = m_planetIndexType;
+        command.primitiveRestart = true;
+        command.primitiveRestartIndex = (m_planetIndexType == GL_UNSIGNED_SHORT) ? PRIMITIVE_RESTART_INDEX_16
+                                                                                 : PRIMITIVE_RESTART_INDEX_32;
+
+        for(auto face = 0U; face < m_numberOfFaceDraws; ++face)
+        {
+            command.baseVertex = static_cast<GLint>(face * m_verticesPerFaceDraw);
+            m_renderQueue.record(command);
+        }
+    }
+    else
+    {
+        command.elementBuffer = m_indexBufferObject.bufferId();
+        command.mode = GL_TRIANGLES;
+        command.count = static_cast<GLsizei>(m_numberOfIndices);
+        command.indexType = GL_UNSIGNED_INT;
+        m_renderQueue.record(command);
+    }
+}
+
+/**
+ * \brief Queues the procedural planet mesh as a draw without indices, one instance per face. The vertex counts
+ *        match the index counts of the uploaded mesh, since every index becomes a vertex of its own.
+ */
+void GlobeWidget::queueProceduralPlanetMesh(DrawCommand command)
+{
+    const auto verticesPerSide = m_numberOfSubdivisions + 2U;
+
+    // Skipped by the program whenever the subdivisions haven't changed
+    m_shaderProgram.setUniformValue(m_quadsPerFaceSideUniform, static_cast<GLint>(verticesPerSide - 1U));
+
+    command.indexType = GL_NONE;
+    command.instanceCount = static_cast<GLsizei>(NUMBER_OF_CUBE_FACES);
+
+    if(m_renderingWireframe)
+    {
+        // Three edges for every vertex of a face, the ones that would leave it are collapsed by the shader
+        command.uniformValue = static_cast<GLint>(VertexFormat::ProceduralEdges);
+        command.mode = GL_LINES;
+        command.count = static_cast<GLsizei>(verticesPerSide * verticesPerSide * 6U);
+    }
+    else
+    {
+        command.mode = GL_TRIANGLES;
+        command.count = static_cast<GLsizei>(subdividedCubeIndexCount(m_numberOfSubdivisions) / NUMBER_OF_CUBE_FACES);
+    }
+
+    m_renderQueue.record(command);
+}
+
+/**
+ * \brief Queues every chunk that survived the last quadtree update and cull. Instanced chunks are a single draw
+ *        of the shared patch, otherwise each chunk is drawn from a mesh of its own, built on the way for newly
+ *        split chunks.
+ */
+void GlobeWidget::queueChunks()
+{
+    const ProfileScope profileScope("Queue chunks");
+
+    ++m_frameNumber;
+
+    m_numberOfTrianglesSubmitted = m_renderingWireframe ? 0U : m_quadTree.numberOfTriangles();
+
+    auto command = planetDrawCommand();
+    command.indexType = GL_UNSIGNED_INT;
+
+    if(m_renderingWireframe)
+    {
+        command.elementBuffer = m_chunkEdgeBufferObject.bufferId();
+        command.mode = GL_LINES;
+        command.count = static_cast<GLsizei>(m_numberOfChunkEdgeIndices);
+    }
+    else
+    {
+        command.elementBuffer = m_chunkIndexBufferObject.bufferId();
+        command.mode = GL_TRIANGLES;
+        command.count = static_cast<GLsizei>(m_numberOfChunkIndices);
     }
+
+    if(m_instancingChunks)
+    {
+        uploadChunkInstances();
+
+        command.uniformValue = static_cast<GLint>(VertexFormat::InstancedPatch);
+        command.vertexArray = m_chunkPatchVertexArrayObject.objectId();
+        command.instanceCount = static_cast<GLsizei>(m_chunkInstances.size());
+
+        if(command.instanceCount > 0)
+        {
+            m_renderQueue.record(command);
+        }
+    }
+    else
+    {
+        // Skirts sit below the surface, which the unit vector encodings can't represent, so chunks stay in float
+        command.uniformValue = static_cast<GLint>(VertexFormat::Float32);
+
+        for(const auto* node : m_quadTree.visibleChunks())
+        {
+            command.vertexArray = chunkMesh(*node).vertexArrayObject.objectId();
+            m_renderQueue.record(command);
+        }
+    }
+
+    releaseUnusedChunkMeshes();
 }
 
 /**
- * \brief Utility function to sanitize changes to m_cameraElevation
+ * \brief Writes a ChunkInstance for every visible chunk into m_chunkInstanceBufferObject, replacing last frame's
  */
-void GlobeWidget::updateElevation(const float difference)
+void GlobeWidget::uploadChunkInstances()
 {
-    // Input sanitization
-    Q_ASSERT(difference <= ELEVATION_UPPER_LIMIT &&
-             difference >= ELEVATION_LOWER_LIMIT);
+    const ProfileScope profileScope("Upload chunk instances");
 
-    // Bail out if you're too close to the poles
-    m_cameraElevation += difference;
-    if(m_cameraElevation > ELEVATION_UPPER_LIMIT)
+    m_chunkInstances.clear();
+    for(const auto* node : m_quadTree.visibleChunks())
     {
-        m_cameraElevation = ELEVATION_UPPER_LIMIT;
+        m_chunkInstances.push_back({ node->s(), node->t(), node->size(),
+                                     CHUNK_SKIRT_DEPTH_SCALE * node->geometricError,
+                                     static_cast<uint32_t>(node->face) });
     }
-    else if(m_cameraElevation < ELEVATION_LOWER_LIMIT)
+
+    if(m_chunkInstances.empty())
     {
-        m_cameraElevation = ELEVATION_LOWER_LIMIT;
+        return;
     }
+
+    // Allocating anew lets the driver hand out fresh memory instead of waiting for last frame's draw to finish
+    m_chunkInstanceBufferObject.bind();
+    m_chunkInstanceBufferObject.allocate(m_chunkInstances.data(),
+                                         static_cast<int>(m_chunkInstances.size() * sizeof(ChunkInstance)));
+    m_chunkInstanceBufferObject.release();
 }
 
 /**
- * \brief Utility function to santize changes to m_cameraRadius
+ * \brief Returns the mesh for the given node, generating and uploading it if the node has just been created.
  */
-void GlobeWidget::updateRadius(const float difference)
+ChunkMesh& GlobeWidget::chunkMesh(const QuadTreeNode& node)
 {
-    Q_ASSERT(difference <= 1.0f && difference >= -1.0f);
+    auto& mesh = m_chunkMeshes[node.key()];
+    if(mesh == nullptr)
+    {
+        const ProfileScope profileScope("Build chunk mesh");
+
+        mesh = std::make_unique<ChunkMesh>();
+
+        const auto vertices = generateCubeFaceChunk(node.face,
+                                                    node.s(),
+                                                    node.t(),
+                                                    node.size(),
+                                                    m_quadTree.quadsPerChunkSide(),
+                                                    CHUNK_SKIRT_DEPTH_SCALE * node.geometricError);
 
-    m_cameraRadius += difference;
-    if(m_cameraRadius > RADIUS_UPPER_LIMIT)
+        mesh->vertexArrayObject.create();
+        mesh->vertexBufferObject.create();
+        mesh->vertexBufferObject.setUsagePattern(QOpenGLBuffer::StaticDraw);
+
+        mesh->vertexArrayObject.bind();
+        mesh->vertexBufferObject.bind();
+        m_chunkIndexBufferObject.bind();
+
+        mesh->vertexBufferObject.allocate(vertices.data(), vertices.size() * sizeof(float));
+        m_shaderProgram.setAttribute(POSITION_ATTRIBUTE_LOCATION, GL_FLOAT, 0, 3, 3 * sizeof(float));
+
+        mesh->vertexArrayObject.release();
+        mesh->vertexBufferObject.release();
+        m_chunkIndexBufferObject.release();
+    }
+
+    mesh->lastFrameUsed = m_frameNumber;
+    return *mesh;
+}
+
+/**
+ * \brief Frees the meshes of chunks that were merged away or replaced by their children this frame.
+ */
+void GlobeWidget::releaseUnusedChunkMeshes()
+{
+    // Chunks that were only culled keep their meshes, so turning the globe doesn't rebuild them
+    for(const auto* node : m_quadTree.activeChunks())
     {
-        m_cameraRadius = RADIUS_UPPER_LIMIT;
+        const auto mesh = m_chunkMeshes.find(node->key());
+        if(mesh != m_chunkMeshes.end())
+        {
+            mesh->second->lastFrameUsed = m_frameNumber;
+        }
     }
-    else if(m_cameraRadius < RADIUS_LOWER_LIMIT)
+
+    for(auto it = m_chunkMeshes.begin(); it != m_chunkMeshes.end();)
     {
-        m_cameraRadius = RADIUS_LOWER_LIMIT;
+        if(it->second->lastFrameUsed != m_frameNumber)
+        {
+            m_renderStateCache.forgetVertexArray(it->second->vertexArrayObject.objectId());
+            it = m_chunkMeshes.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
     }
 }
 
 /**
- * \brief Utility function that performs a conversion from sphereical coordinates
- *        to cartesian, right hand XYZ
+ * \brief Requests the virtual texture tiles under every visible chunk and uploads the missing ones. Each chunk
+ *        asks for the level that gives about one texel per pixel at its distance.
  */
-void GlobeWidget::updateCameraPosition()
+void GlobeWidget::requestVirtualTextureTiles(const float viewportHeight)
 {
-    QVector3D newCameraPosition;
-    newCameraPosition.setY(m_cameraRadius * qSin(qDegreesToRadians(m_cameraElevation)));
-    auto hypotenuse = m_cameraRadius * qCos(qDegreesToRadians(m_cameraElevation));
+    const ProfileScope profileScope("Request virtual texture tiles");
+
+    const auto cameraPosition = m_camera.position();
+    const auto projectionScale = m_camera.projectionScale(viewportHeight);
 
-    newCameraPosition.setX(hypotenuse * qSin(qDegreesToRadians(m_cameraAzimuth)));
-    newCameraPosition.setZ(hypotenuse * qCos(qDegreesToRadians(m_cameraAzimuth)));
+    m_virtualTexture->beginFrame();
+
+    for(const auto* node : m_quadTree.visibleChunks())
+    {
+        // A chunk never crosses a cube edge, so its center picks the cubemap face of all four corners
+        const auto face = cubeMapFace(node->center);
+
+        QPointF minimum(1.0, 1.0);
+        QPointF maximum(0.0, 0.0);
+
+        for(auto corner = 0U; corner < 4U; ++corner)
+        {
+            const auto s = node->s() + ((corner & 1U) * node->size());
+            const auto t = node->t() + ((corner >> 1U) * node->size());
+            const auto coordinates = cubeMapFaceCoordinates(cubeFacePoint(node->face, s, t), face);
+
+            minimum.setX(qMin(minimum.x(), coordinates.x()));
+            minimum.setY(qMin(minimum.y(), coordinates.y()));
+            maximum.setX(qMax(maximum.x(), coordinates.x()));
+            maximum.setY(qMax(maximum.y(), coordinates.y()));
+        }
+
+        // The bounding sphere spans the chunk's diagonal, its side is shorter by a factor of root two
+        auto distance = cameraPosition.distanceToPoint(node->center) - node->boundingRadius;
+        distance = qMax(distance, MINIMUM_TILE_REQUEST_DISTANCE);
+
+        const auto pixelsAcross = (qSqrt(2.0f) * node->boundingRadius * projectionScale) / distance;
+        m_virtualTexture->requestArea(face, minimum, maximum, pixelsAcross);
+    }
+
+    const ProfileScope uploadProfileScope("Upload virtual texture tiles");
+    const GpuProfileScope gpuProfileScope(m_gpuProfiler, "Upload virtual texture tiles");
+
+    m_virtualTexture->update();
+}
 
-    m_camera.setPosition(newCameraPosition);
+/**
+ * \brief Draws the profiler summary in the top left corner with QPainter, once the globe has been drawn
+ */
+void GlobeWidget::drawProfilerOverlay()
+{
+    const ProfileScope profileScope("Draw profiler overlay");
+
+    const auto summaries = Profiler::instance().summary(PROFILER_OVERLAY_FRAMES);
+
+    const auto& statistics = m_renderStateCache.statistics();
+
+    std::vector<QString> lines;
+    lines.reserve(summaries.size() + 2U);
+    lines.push_back(QStringLiteral("%1 draws, %2 state changes, %3 skipped").arg(statistics.numberOfDraws)
+                                                                           .arg(statistics.stateChanges())
+                                                                           .arg(statistics.skippedChanges));
+    lines.push_back(QStringLiteral("     avg ms  max ms"));
+
+    for(const auto& summary : summaries)
+    {
+        lines.push_back(QStringLiteral("%1 %2 %3  %4").arg(QString::fromLatin1(summary.gpu ? "GPU" : "CPU"))
+                                                      .arg(summary.averageMilliseconds, 7, 'f', 2)
+                                                      .arg(summary.maximumMilliseconds, 7, 'f', 2)
+                                                      .arg(QString::fromLatin1(summary.name)));
+    }
+
+    QPainter painter(this);
+    painter.setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    const auto metrics = painter.fontMetrics();
+
+    auto overlayWidth = 0;
+    for(const auto& line : lines)
+    {
+        overlayWidth = qMax(overlayWidth, metrics.horizontalAdvance(line));
+    }
+
+    const auto overlayHeight = metrics.height() * static_cast<int>(lines.size());
+    painter.fillRect(PROFILER_OVERLAY_MARGIN, PROFILER_OVERLAY_MARGIN,
+                     overlayWidth + (2 * PROFILER_OVERLAY_PADDING), overlayHeight + (2 * PROFILER_OVERLAY_PADDING),
+                     QColor(0, 0, 0, PROFILER_OVERLAY_OPACITY));
+
+    painter.setPen(Qt::white);
+    for(auto i = 0U; i < lines.size(); ++i)
+    {
+        const auto top = PROFILER_OVERLAY_MARGIN + PROFILER_OVERLAY_PADDING + (metrics.height() * static_cast<int>(i));
+        painter.drawText(PROFILER_OVERLAY_MARGIN + PROFILER_OVERLAY_PADDING, top + metrics.ascent(), lines[i]);
+    }
+
+    painter.end();
+
+    // QPainter leaves its own state behind, put back what the globe relies on
+    glEnable(GL_CULL_FACE);
+}
+
+/**
+ * \brief Starts repainting every frame, unless it already is. Does nothing if the input left the camera at rest.
+ */
+void GlobeWidget::startCameraAnimation()
+{
+    if(m_cameraAnimating || !m_cameraController.isMoving())
+    {
+        return;
+    }
+
+    m_cameraAnimating = true;
+    m_frameTimer.invalidate();
+    m_frameStatistics.reset();
+    m_numberOfHitches = 0U;
+
+    this->update();
+}
+
+/**
+ * \brief Called once each frame reaches the screen. Schedules the next frame while the camera is moving, and
+ *        goes idle once it settles, logging how evenly paced the frames were.
+ */
+void GlobeWidget::continueCameraAnimation()
+{
+    if(!m_cameraAnimating)
+    {
+        return;
+    }
+
+    if(m_cameraController.isMoving())
+    {
+        this->update();
+        return;
+    }
+
+    m_cameraAnimating = false;
+
+    if(m_frameStatistics.numberOfFrames() > 0U)
+    {
+        qDebug() << "Camera animation frames:" << m_frameStatistics.numberOfFrames()
+                 << "mean (ms):" << m_frameStatistics.mean()
+                 << "standard deviation (ms):" << m_frameStatistics.standardDeviation()
+                 << "worst (ms):" << m_frameStatistics.maximum()
+                 << "hitches:" << m_numberOfHitches;
+    }
 }
@@ -3,12 +3,49 @@
 
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions>
+#include <QOpenGLFunctions_4_1_Core>
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLBuffer>
 #include <QOpenGLTexture>
+#include <QElapsedTimer>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
 #include "shaderprogram.h"
+#include "uniformbuffer.h"
 #include "camera.h"
+#include "cameracontroller.h"
+#include "framestatistics.h"
+#include "planetquadtree.h"
+#include "profiler.h"
+#include "renderqueue.h"
+#include "vertexformat.h"
+
+class MeshCache;
+class VirtualTexture;
+
+struct ChunkMesh
+{
+    ChunkMesh();
+
+    QOpenGLVertexArrayObject vertexArrayObject;
+    QOpenGLBuffer vertexBufferObject;
+    uint64_t lastFrameUsed;
+};
+
+/**
+ * \brief Per-instance data of a chunk drawn from the shared grid patch, read by cube-map.vert
+ */
+struct ChunkInstance
+{
+    float s;
+    float t;
+    float size;
+    float skirtDepth;
+    uint32_t face;
+};
 
 class GlobeWidget : public QOpenGLWidget, protected QOpenGLFunctions
 {
@@ -18,43 +55,110 @@ public:
     virtual ~GlobeWidget() override;
 
     void updateCameraRadius(float wheelInput);
-    void updateCameraPositionAngles(float horizontalInput, float verticalInput);
+    void setCameraRotationInput(float horizontalInput, float verticalInput);
+    void setCameraPose(float azimuth, float elevation, float radius);
 
     void enableWireframe();
     void disableWireframe();
 
+    void enableLevelOfDetail();
+    void disableLevelOfDetail();
+
+    void enableProceduralPlanetMesh();
+    void setNumberOfSubdivisions(uint32_t numberOfSubdivisions);
+
+    void enableProfilerOverlay();
+    void disableProfilerOverlay();
+
+    uint32_t numberOfTrianglesSubmitted() const;
+    const RenderStatistics& renderStatistics() const;
+
 protected:
     void initializeGL() override;
     void paintGL() override;
     void resizeGL(int, int) override;
 
+private slots:
+    void continueCameraAnimation();
+
 private:
     void initializeShaderProgram();
     void initializePlanetMesh();
+    void initializeProceduralPlanetMesh();
+    bool generatePlanetMeshIntoMappedBuffers();
+    std::vector<uint32_t> uploadGeneratedPlanetMesh(bool optimizingMesh, MeshCache* cache);
+    void uploadCachedPlanetMesh(const MeshCache& cache);
+    void uploadPlanetStripIndices(MeshCache* cache);
     void initializeCamera();
     void initializeCubeMap();
+    bool initializeCompressedCubeMap();
+    void initializeDecodedCubeMap();
+    bool initializeVirtualTexture();
+    void initializeLevelOfDetail();
+    void initializeChunkPatch();
 
-    void updateAzimuth(float difference);
-    void updateElevation(float difference);
-    void updateRadius(float difference);
+    DrawCommand planetDrawCommand();
+    void queuePlanetMesh();
+    void queueProceduralPlanetMesh(DrawCommand command);
+    void queueChunks();
+    void uploadChunkInstances();
+    ChunkMesh& chunkMesh(const QuadTreeNode& node);
+    void releaseUnusedChunkMeshes();
+    void requestVirtualTextureTiles(float viewportHeight);
+    void drawProfilerOverlay();
 
-    void updateCameraPosition();
+    void startCameraAnimation();
 
 private:
+    QOpenGLFunctions_4_1_Core* m_coreFunctions;
+
     ShaderProgram m_shaderProgram;
+    UniformHandle<GLint> m_vertexFormatUniform;
+    UniformHandle<GLint> m_quadsPerFaceSideUniform;
+    UniformBuffer m_frameUniformBuffer;
+    RenderQueue m_renderQueue;
+    RenderStateCache m_renderStateCache;
     QOpenGLVertexArrayObject m_vertexArrayObject;
     QOpenGLBuffer m_vertexBufferObject;
     QOpenGLBuffer m_indexBufferObject;
+    QOpenGLBuffer m_edgeBufferObject;
     QOpenGLTexture m_texture;
+    std::unique_ptr<VirtualTexture> m_virtualTexture;
+
+    PlanetQuadTree m_quadTree;
+    QOpenGLBuffer m_chunkIndexBufferObject;
+    QOpenGLBuffer m_chunkEdgeBufferObject;
+    std::unordered_map<uint64_t, std::unique_ptr<ChunkMesh>> m_chunkMeshes;
+    QOpenGLVertexArrayObject m_chunkPatchVertexArrayObject;
+    QOpenGLBuffer m_chunkPatchVertexBufferObject;
+    QOpenGLBuffer m_chunkInstanceBufferObject;
+    std::vector<ChunkInstance> m_chunkInstances;
+    bool m_instancingChunks;
+    uint32_t m_numberOfChunkIndices;
+    uint32_t m_numberOfChunkEdgeIndices;
+    uint64_t m_frameNumber;
 
     Camera m_camera;
-    float m_cameraAzimuth;
-    float m_cameraElevation;
-    float m_cameraRadius;
+    CameraController m_cameraController;
+    bool m_cameraAnimating;
+    QElapsedTimer m_frameTimer;
+    FrameStatistics m_frameStatistics;
+    uint32_t m_numberOfHitches;
+
+    GpuProfiler m_gpuProfiler;
+    bool m_showingProfilerOverlay;
 
     uint32_t m_numberOfSubdivisions;
     uint32_t m_numberOfIndices;
+    uint32_t m_numberOfEdgeIndices;
+    VertexFormat m_planetVertexFormat;
+    MeshTopology m_planetMeshTopology;
+    GLenum m_planetIndexType;
+    uint32_t m_numberOfFaceDraws;
+    uint32_t m_verticesPerFaceDraw;
+    uint32_t m_numberOfTrianglesSubmitted;
     bool m_renderingWireframe;
+    bool m_levelOfDetailEnabled;
 };
 
 #endif // GLOBEWIDGET_H
@@ -0,0 +1,339 @@
+#include "ktxcubemap.h"
+
+#include <cstring>
+#include <utility>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+
+namespace
+{
+    constexpr uint8_t KTX_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n' };
+    constexpr uint32_t KTX_ENDIANNESS = 0x04030201U;
+
+    // Image data, faces and mip levels are all padded to 4 bytes
+    constexpr uint32_t KTX_ALIGNMENT = 4U;
+}
+
+/**
+ * \brief Field layout of the KTX 1.1 header that follows the identifier
+ */
+struct KtxHeader
+{
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+static uint32_t ktx_padded(const uint32_t bytes)
+{
+    return (bytes + KTX_ALIGNMENT - 1U) & ~(KTX_ALIGNMENT - 1U);
+}
+
+KtxCubeMap::KtxCubeMap() :
+    m_data{},
+    m_file(),
+    m_bytes{nullptr},
+    m_size{0},
+    m_width{0},
+    m_height{0},
+    m_glInternalFormat{0},
+    m_keyValueOffset{0},
+    m_keyValueBytes{0},
+    m_levelOffsets{},
+    m_faceSizes{}
+{
+
+}
+
+/**
+ * \brief Reads the whole file and indexes the face data of every mip level. Works for Qt resources as well as
+ *        files on disk. Returns false with the reason logged if the file is missing, truncated or of a kind
+ *        this loader does not handle.
+ */
+bool KtxCubeMap::load(const QString& path)
+{
+    reset();
+
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Could not open KTX file" << path;
+        return false;
+    }
+
+    m_data = file.readAll();
+    m_bytes = reinterpret_cast<const uchar*>(m_data.constData());
+    m_size = static_cast<uint64_t>(m_data.size());
+
+    return index(path);
+}
+
+/**
+ * \brief Memory maps a file on disk and indexes the face data of every mip level, without reading any of it.
+ *        Returns false, leaving nothing mapped, in the same cases as load() or if the file can't be mapped.
+ */
+bool KtxCubeMap::map(const QString& path)
+{
+    reset();
+
+    m_file.setFileName(path);
+    if(!m_file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Could not open KTX file" << path;
+        return false;
+    }
+
+    m_bytes = m_file.map(0, m_file.size());
+    if(m_bytes == nullptr)
+    {
+        qDebug() << "Could not map KTX file" << path;
+        reset();
+        return false;
+    }
+    m_size = static_cast<uint64_t>(m_file.size());
+
+    if(!index(path))
+    {
+        reset();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Drops the data of the last file loaded or mapped. Closing the file also unmaps it.
+ */
+void KtxCubeMap::reset()
+{
+    m_levelOffsets.clear();
+    m_faceSizes.clear();
+    m_data.clear();
+    m_file.close();
+    m_bytes = nullptr;
+    m_size = 0U;
+}
+
+/**
+ * \brief Checks the header of the file at m_bytes and finds the face data of every mip level in it
+ */
+bool KtxCubeMap::index(const QString& path)
+{
+    KtxHeader header;
+    if(m_size < sizeof(KTX_IDENTIFIER) + sizeof(KtxHeader) ||
+       std::memcmp(m_bytes, KTX_IDENTIFIER, sizeof(KTX_IDENTIFIER)) != 0)
+    {
+        qDebug() << "Not a KTX 1.1 file" << path;
+        return false;
+    }
+
+    std::memcpy(&header, m_bytes + sizeof(KTX_IDENTIFIER), sizeof(KtxHeader));
+
+    if(header.endianness != KTX_ENDIANNESS || header.glTypeSize != 1U ||
+       header.numberOfFaces != KTX_CUBE_MAP_FACES || header.numberOfArrayElements != 0U ||
+       header.pixelDepth != 0U || header.pixelWidth == 0U || header.pixelHeight == 0U)
+    {
+        qDebug() << "Unsupported KTX layout, expected an 8-bit or compressed cubemap in host byte order" << path;
+        return false;
+    }
+
+    // Zero mip levels asks the loader to generate them, which can't be done for compressed data
+    const auto mipLevels = qMax(header.numberOfMipmapLevels, 1U);
+    const auto fileSize = m_size;
+
+    const auto keyValueOffset = static_cast<uint64_t>(sizeof(KTX_IDENTIFIER) + sizeof(KtxHeader));
+    auto offset = keyValueOffset + header.bytesOfKeyValueData;
+
+    std::vector<uint64_t> levelOffsets;
+    std::vector<uint32_t> faceSizes;
+
+    for(auto level = 0U; level < mipLevels; ++level)
+    {
+        if(offset + sizeof(uint32_t) > fileSize)
+        {
+            qDebug() << "KTX file is truncated" << path;
+            return false;
+        }
+
+        uint32_t imageSize;
+        std::memcpy(&imageSize, m_bytes + offset, sizeof(imageSize));
+        offset += sizeof(uint32_t);
+
+        // For a non-array cubemap imageSize is the size of a single face
+        if(offset + (static_cast<uint64_t>(ktx_padded(imageSize)) * KTX_CUBE_MAP_FACES) > fileSize)
+        {
+            qDebug() << "KTX file is truncated" << path;
+            return false;
+        }
+
+        levelOffsets.push_back(offset);
+        faceSizes.push_back(imageSize);
+
+        offset += static_cast<uint64_t>(ktx_padded(imageSize)) * KTX_CUBE_MAP_FACES;
+    }
+
+    m_levelOffsets = std::move(levelOffsets);
+    m_faceSizes = std::move(faceSizes);
+    m_width = header.pixelWidth;
+    m_height = header.pixelHeight;
+    m_glInternalFormat = header.glInternalFormat;
+    m_keyValueOffset = static_cast<uint32_t>(keyValueOffset);
+    m_keyValueBytes = header.bytesOfKeyValueData;
+
+    return true;
+}
+
+uint32_t KtxCubeMap::width() const
+{
+    return m_width;
+}
+
+uint32_t KtxCubeMap::height() const
+{
+    return m_height;
+}
+
+uint32_t KtxCubeMap::mipLevels() const
+{
+    return m_levelOffsets.size();
+}
+
+uint32_t KtxCubeMap::glInternalFormat() const
+{
+    return m_glInternalFormat;
+}
+
+/**
+ * \brief Value stored under key in the file's key/value data, or an empty array if there is none
+ */
+QByteArray KtxCubeMap::value(const QByteArray& key) const
+{
+    auto offset = static_cast<uint64_t>(m_keyValueOffset);
+    const auto end = offset + m_keyValueBytes;
+
+    // Each entry is a 32-bit size, then the key with its terminator and the value, then padding to 4 bytes
+    while(offset + sizeof(uint32_t) <= end)
+    {
+        uint32_t entryBytes;
+        std::memcpy(&entryBytes, m_bytes + offset, sizeof(entryBytes));
+        offset += sizeof(uint32_t);
+
+        if(offset + entryBytes > end)
+        {
+            break;
+        }
+
+        const auto entry = QByteArray::fromRawData(reinterpret_cast<const char*>(m_bytes) + offset, entryBytes);
+        const auto terminator = entry.indexOf('\0');
+        if(terminator >= 0 && entry.left(terminator) == key)
+        {
+            return QByteArray(entry.constData() + terminator + 1, entryBytes - terminator - 1);
+        }
+
+        offset += ktx_padded(entryBytes);
+    }
+
+    return QByteArray();
+}
+
+/**
+ * \brief Start of the data of one face of one mip level, valid as long as this object lives
+ */
+const uchar* KtxCubeMap::faceData(const uint32_t level, const uint32_t face) const
+{
+    Q_ASSERT(level < m_levelOffsets.size() && face < KTX_CUBE_MAP_FACES);
+
+    const auto offset = m_levelOffsets[level] + (static_cast<uint64_t>(face) * ktx_padded(m_faceSizes[level]));
+    return m_bytes + offset;
+}
+
+/**
+ * \brief Size in bytes of each face of the given mip level
+ */
+uint32_t KtxCubeMap::faceSize(const uint32_t level) const
+{
+    Q_ASSERT(level < m_faceSizes.size());
+
+    return m_faceSizes[level];
+}
+
+/**
+ * \brief Writes a cubemap as KTX 1.1 in host byte order. Every face of a level must have the same size, and rows
+ *        of uncompressed data must already be padded to 4 bytes. An optional key/value pair is stored with it.
+ */
+bool writeKtxCubeMap(const QString& path,
+                     const KtxFormat& format,
+                     const uint32_t width,
+                     const uint32_t height,
+                     const std::vector<KtxCubeMapLevel>& levels,
+                     const QByteArray& key,
+                     const QByteArray& value)
+{
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "Could not create KTX file" << path;
+        return false;
+    }
+
+    static const char padding[KTX_ALIGNMENT] = {};
+
+    // The key is null terminated, the value is stored as is
+    const uint32_t keyValueBytes = key.isEmpty() ? 0U : (key.size() + 1U + value.size());
+
+    KtxHeader header{};
+    header.endianness = KTX_ENDIANNESS;
+    header.glType = format.glType;
+    header.glTypeSize = format.glTypeSize;
+    header.glFormat = format.glFormat;
+    header.glInternalFormat = format.glInternalFormat;
+    header.glBaseInternalFormat = format.glBaseInternalFormat;
+    header.pixelWidth = width;
+    header.pixelHeight = height;
+    header.numberOfFaces = KTX_CUBE_MAP_FACES;
+    header.numberOfMipmapLevels = levels.size();
+    header.bytesOfKeyValueData = (keyValueBytes == 0U) ? 0U : (sizeof(uint32_t) + ktx_padded(keyValueBytes));
+
+    file.write(reinterpret_cast<const char*>(KTX_IDENTIFIER), sizeof(KTX_IDENTIFIER));
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    if(keyValueBytes != 0U)
+    {
+        file.write(reinterpret_cast<const char*>(&keyValueBytes), sizeof(keyValueBytes));
+        file.write(key.constData(), key.size() + 1); // Includes the terminator QByteArray always keeps
+        file.write(value.constData(), value.size());
+        file.write(padding, ktx_padded(keyValueBytes) - keyValueBytes);
+    }
+
+    for(const auto& level : levels)
+    {
+        const uint32_t imageSize = level[0].size();
+        file.write(reinterpret_cast<const char*>(&imageSize), sizeof(imageSize));
+
+        for(const auto& face : level)
+        {
+            if(face.size() != imageSize)
+            {
+                qDebug() << "Faces of a KTX mip level differ in size";
+                file.cancelWriting();
+                return false;
+            }
+
+            file.write(reinterpret_cast<const char*>(face.data()), face.size());
+            file.write(padding, ktx_padded(imageSize) - imageSize);
+        }
+    }
+
+    return file.commit();
+}
@@ -0,0 +1,92 @@
+#ifndef KTXCUBEMAP_H
+#define KTXCUBEMAP_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+// OpenGL enums stored in the container, defined here so the tools don't need the OpenGL headers
+constexpr uint32_t KTX_GL_UNSIGNED_BYTE = 0x1401U;
+constexpr uint32_t KTX_GL_RGB = 0x1907U;
+constexpr uint32_t KTX_GL_RGBA = 0x1908U;
+constexpr uint32_t KTX_GL_RGBA8 = 0x8058U;
+constexpr uint32_t KTX_GL_COMPRESSED_RGB_S3TC_DXT1 = 0x83F0U;
+
+/**
+ * \brief The OpenGL format fields of a KTX header. glType and glFormat are zero for compressed formats.
+ */
+struct KtxFormat
+{
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+};
+
+constexpr KtxFormat KTX_FORMAT_BC1 = { 0U, 1U, 0U, KTX_GL_COMPRESSED_RGB_S3TC_DXT1, KTX_GL_RGB };
+constexpr KtxFormat KTX_FORMAT_RGBA8 = { KTX_GL_UNSIGNED_BYTE, 1U, KTX_GL_RGBA, KTX_GL_RGBA8, KTX_GL_RGBA };
+
+constexpr auto KTX_CUBE_MAP_FACES = 6U;
+
+/**
+ * \brief Data of one mip level of a cubemap, one entry per face in the order of the
+ *        GL_TEXTURE_CUBE_MAP_POSITIVE_X + i face targets
+ */
+using KtxCubeMapLevel = std::array<std::vector<uint8_t>, KTX_CUBE_MAP_FACES>;
+
+/**
+ * \brief Read-only view of a cubemap stored in a KTX 1.1 file. Only the subset this project writes is accepted:
+ *        six faces, no array layers, and the host byte order. The data is either block compressed or 8-bit.
+ *        load() reads the whole file into memory, map() memory maps a file on disk so that only the parts read
+ *        are ever paged in.
+ */
+class KtxCubeMap
+{
+public:
+    KtxCubeMap();
+
+    bool load(const QString& path);
+    bool map(const QString& path);
+
+    uint32_t width() const;
+    uint32_t height() const;
+    uint32_t mipLevels() const;
+    uint32_t glInternalFormat() const;
+    QByteArray value(const QByteArray& key) const;
+
+    const uchar* faceData(uint32_t level, uint32_t face) const;
+    uint32_t faceSize(uint32_t level) const;
+
+private:
+    void reset();
+    bool index(const QString& path);
+
+private:
+    QByteArray m_data;
+    QFile m_file;
+    const uchar* m_bytes; // start of the file, in m_data or in the mapping of m_file
+    uint64_t m_size;
+
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_glInternalFormat;
+    uint32_t m_keyValueOffset;
+    uint32_t m_keyValueBytes;
+
+    std::vector<uint64_t> m_levelOffsets;
+    std::vector<uint32_t> m_faceSizes;
+};
+
+bool writeKtxCubeMap(const QString& path,
+                     const KtxFormat& format,
+                     uint32_t width,
+                     uint32_t height,
+                     const std::vector<KtxCubeMapLevel>& levels,
+                     const QByteArray& key = QByteArray(),
+                     const QByteArray& value = QByteArray());
+
+#endif // KTXCUBEMAP_H
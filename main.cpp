@@ -11,6 +11,7 @@ int main(int argc, char *argv[])
     format.setStencilBufferSize(8);
     format.setVersion(4, 1);
     format.setProfile(QSurfaceFormat::CoreProfile);
+    format.setSwapInterval(1); // Wait for vsync, which paces the camera animation
     QSurfaceFormat::setDefaultFormat(format);
 
     QApplication a(argc, argv);
@@ -1,6 +1,9 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
+#include "profiler.h"
 
+#include <QDebug>
+#include <QFileDialog>
 #include <QKeyEvent>
 
 namespace
@@ -10,6 +13,8 @@ namespace
     constexpr auto INPUT_LOW = 0.0f;
 
     constexpr auto ANGLE_DELTA_NO_INPUT = 0;
+
+    const auto DEFAULT_TRACE_FILE_NAME = "trace.json";
 }
 
 /**
@@ -18,6 +23,10 @@ namespace
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
+    , m_leftHeld{false}
+    , m_rightHeld{false}
+    , m_upHeld{false}
+    , m_downHeld{false}
 {
     ui->setupUi(this);
 
@@ -33,37 +42,91 @@ MainWindow::~MainWindow()
 }
 
 /**
- * \brief Slot for the keyPressEvent. This allows the user to manipulate the azimuth/elevation of the camera.
+ * \brief Slot for the keyPressEvent. Holding the arrow keys turns the camera in azimuth/elevation.
  */
 void MainWindow::keyPressEvent(QKeyEvent* event)
 {
-    float horizontalInput {INPUT_LOW};
-    float verticalInput {INPUT_LOW};
-
-    if(event->key() == Qt::Key_Left)
+    if(!updateArrowKey(event, true))
     {
-        horizontalInput = INPUT_HIGH_INVERTED;
+        QMainWindow::keyPressEvent(event);
     }
+}
 
-    if(event->key() == Qt::Key_Right)
+/**
+ * \brief Slot for the keyReleaseEvent. Releasing the arrow keys lets the camera coast to a stop.
+ */
+void MainWindow::keyReleaseEvent(QKeyEvent* event)
+{
+    if(!updateArrowKey(event, false))
     {
-        horizontalInput = INPUT_HIGH;
+        QMainWindow::keyReleaseEvent(event);
     }
+}
 
-    if(event->key() == Qt::Key_Down)
+/**
+ * \brief Tracks which arrow keys are held and passes the resulting input on to the globe. Key repeats are
+ *        ignored, the camera keeps turning for as long as the key is down. Returns false for any other key.
+ */
+bool MainWindow::updateArrowKey(QKeyEvent* event, const bool pressed)
+{
+    bool* held = nullptr;
+
+    switch(event->key())
     {
-        verticalInput = INPUT_HIGH_INVERTED;
+    case Qt::Key_Left:
+        held = &m_leftHeld;
+        break;
+    case Qt::Key_Right:
+        held = &m_rightHeld;
+        break;
+    case Qt::Key_Down:
+        held = &m_downHeld;
+        break;
+    case Qt::Key_Up:
+        held = &m_upHeld;
+        break;
+    default:
+        return false;
     }
 
-    if(event->key() == Qt::Key_Up)
+    if(!event->isAutoRepeat())
     {
-        verticalInput = INPUT_HIGH;
+        *held = pressed;
+        updateRotationInput();
     }
 
-    if(horizontalInput != INPUT_LOW || verticalInput != INPUT_LOW)
+    return true;
+}
+
+/**
+ * \brief Passes the held arrow keys on to the globe as rotation input
+ */
+void MainWindow::updateRotationInput()
+{
+    const auto horizontalInput = (m_rightHeld ? INPUT_HIGH : INPUT_LOW) +
+                                 (m_leftHeld ? INPUT_HIGH_INVERTED : INPUT_LOW);
+    const auto verticalInput = (m_upHeld ? INPUT_HIGH : INPUT_LOW) +
+                               (m_downHeld ? INPUT_HIGH_INVERTED : INPUT_LOW);
+
+    m_globeRenderArea->setCameraRotationInput(horizontalInput, verticalInput);
+}
+
+/**
+ * \brief Key releases aren't delivered to a window that has lost focus, so every key counts as released then.
+ *        Otherwise the camera would keep turning until the key was pressed and released again.
+ */
+void MainWindow::changeEvent(QEvent* event)
+{
+    if(event->type() == QEvent::ActivationChange && !isActiveWindow())
     {
-        m_globeRenderArea->updateCameraPositionAngles(horizontalInput, verticalInput);
+        m_leftHeld = false;
+        m_rightHeld = false;
+        m_upHeld = false;
+        m_downHeld = false;
+        updateRotationInput();
     }
+
+    QMainWindow::changeEvent(event);
 }
 
 /**
@@ -102,6 +165,57 @@ void MainWindow::on_Wireframe_On_Action_toggled(bool enabled)
     }
 }
 
+/**
+ * \brief Slot for the level of detail enable/disable action. Allows the user to switch between the quadtree
+ *        chunks and the fixed subdivision mesh.
+ */
+void MainWindow::on_Level_Of_Detail_Action_toggled(bool enabled)
+{
+    if(enabled)
+    {
+        m_globeRenderArea->enableLevelOfDetail();
+    }
+    else
+    {
+        m_globeRenderArea->disableLevelOfDetail();
+    }
+}
+
+/**
+ * \brief Slot for the profiler overlay enable/disable action. Allows the user to show the CPU and GPU timings of
+ *        each part of the frame on top of the globe.
+ */
+void MainWindow::on_Profiler_Overlay_Action_toggled(bool enabled)
+{
+    if(enabled)
+    {
+        m_globeRenderArea->enableProfilerOverlay();
+    }
+    else
+    {
+        m_globeRenderArea->disableProfilerOverlay();
+    }
+}
+
+/**
+ * \brief Slot for the save profiler trace action. Writes the recently profiled frames, and initialization if it
+ *        is still in the buffer, to a Chrome trace file of the user's choosing.
+ */
+void MainWindow::on_Save_Profiler_Trace_Action_triggered()
+{
+    const auto path = QFileDialog::getSaveFileName(this, tr("Save Profiler Trace"), DEFAULT_TRACE_FILE_NAME,
+                                                   tr("Chrome Trace (*.json)"));
+    if(path.isEmpty())
+    {
+        return;
+    }
+
+    if(!Profiler::instance().writeChromeTrace(path))
+    {
+        qDebug() << "Could not save the profiler trace to" << path;
+    }
+}
+
 /**
  * \brief Slot for the quit action. Allows the user to exit the application.
  */
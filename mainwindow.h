@@ -18,15 +18,30 @@ public:
 
 protected:
     void keyPressEvent(QKeyEvent* event) override;
+    void keyReleaseEvent(QKeyEvent* event) override;
     void wheelEvent(QWheelEvent* event) override;
+    void changeEvent(QEvent* event) override;
 
 private slots:
     void on_Wireframe_On_Action_toggled(bool enabled);
+    void on_Level_Of_Detail_Action_toggled(bool enabled);
+    void on_Profiler_Overlay_Action_toggled(bool enabled);
+    void on_Save_Profiler_Trace_Action_triggered();
     void on_Quit_Action_triggered();
 
+private:
+    bool updateArrowKey(QKeyEvent* event, bool pressed);
+    void updateRotationInput();
+
 private:
     Ui::MainWindow *ui;
 
     GlobeWidget* m_globeRenderArea;
+
+    // Arrow keys currently held down
+    bool m_leftHeld;
+    bool m_rightHeld;
+    bool m_upHeld;
+    bool m_downHeld;
 };
 #endif // MAINWINDOW_H
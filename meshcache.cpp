@@ -0,0 +1,339 @@
+#include "meshcache.h"
+
+#include <cstring>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace
+{
+    constexpr uint32_t MESH_CACHE_MAGIC = 0x434D4751U; // "QGMC" in a little-endian file
+    constexpr uint32_t MESH_CACHE_FILE_VERSION = 1U;
+
+    // Sections start on 8 byte boundaries so every one of them can be mapped and read in place
+    constexpr uint64_t MESH_CACHE_SECTION_ALIGNMENT = 8U;
+
+    constexpr uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+    constexpr uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+    constexpr auto NUMBER_OF_SECTIONS = 3U;
+}
+
+/**
+ * \brief Rounds a section size up to the next section boundary
+ */
+static uint64_t aligned_section_size(const uint64_t bytes)
+{
+    return (bytes + MESH_CACHE_SECTION_ALIGNMENT - 1U) & ~(MESH_CACHE_SECTION_ALIGNMENT - 1U);
+}
+
+/**
+ * \brief FNV-1a, eight bytes per step with a byte-wise tail. Continues from hash, so sections can be fed one at
+ *        a time as long as the reader splits them the same way.
+ */
+static uint64_t fnv1a_checksum(uint64_t hash, const uchar* data, const uint64_t bytes)
+{
+    auto i = 0ULL;
+    for(; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+
+    for(; i < bytes; ++i)
+    {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+
+    return hash;
+}
+
+/**
+ * \brief Each key has its own file in the user's cache directory, so changing a setting doesn't evict the others
+ */
+MeshCache::MeshCache(const MeshCacheKey& key) :
+    m_key(key),
+    m_path{},
+    m_file{},
+    m_mapping{nullptr},
+    m_header{},
+    m_store{},
+    m_storeChecksum{FNV_OFFSET_BASIS},
+    m_storedSections{0}
+{
+    const auto directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if(!directory.isEmpty())
+    {
+        m_path = QStringLiteral("%1/planet-mesh-%2-%3-%4-%5.bin")
+                     .arg(directory)
+                     .arg(key.numberOfSubdivisions)
+                     .arg(static_cast<int>(key.vertexFormat))
+                     .arg(static_cast<int>(key.topology))
+                     .arg(key.optimized ? 1 : 0);
+    }
+}
+
+/**
+ * \brief Unmaps the file. An uncommitted store is discarded and the previous file, if any, is left in place.
+ */
+MeshCache::~MeshCache()
+{
+    release();
+}
+
+/**
+ * \brief Maps the cache file for this key and checks it against the key, the generator version and its
+ *        checksum. On success the section accessors point into the mapping until release() is called.
+ */
+bool MeshCache::load()
+{
+    release();
+
+    if(m_path.isEmpty() || !QFile::exists(m_path))
+    {
+        return false;
+    }
+
+    m_file.setFileName(m_path);
+    if(!m_file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Could not open mesh cache" << m_path;
+        return false;
+    }
+
+    const auto fileSize = static_cast<uint64_t>(m_file.size());
+    if(fileSize < sizeof(Header))
+    {
+        qDebug() << "Mesh cache is truncated" << m_path;
+        release();
+        return false;
+    }
+
+    m_mapping = m_file.map(0, m_file.size());
+    if(m_mapping == nullptr)
+    {
+        qDebug() << "Could not map mesh cache" << m_path;
+        release();
+        return false;
+    }
+
+    std::memcpy(&m_header, m_mapping, sizeof(Header));
+
+    // Everything but the sizes and checksum has to match what this build would have written
+    auto expected = expectedHeader();
+    expected.indexSize = m_header.indexSize;
+    expected.vertexBytes = m_header.vertexBytes;
+    expected.indexBytes = m_header.indexBytes;
+    expected.edgeBytes = m_header.edgeBytes;
+    expected.checksum = m_header.checksum;
+
+    const auto expectedSize = sizeof(Header) + aligned_section_size(m_header.vertexBytes) +
+                              aligned_section_size(m_header.indexBytes) + aligned_section_size(m_header.edgeBytes);
+
+    if(std::memcmp(&expected, &m_header, sizeof(Header)) != 0 || fileSize != expectedSize ||
+       (m_header.indexSize != sizeof(uint16_t) && m_header.indexSize != sizeof(uint32_t)))
+    {
+        qDebug() << "Mesh cache is stale" << m_path;
+        release();
+        return false;
+    }
+
+    auto checksum = fnv1a_checksum(FNV_OFFSET_BASIS, vertices(), vertexBytes());
+    checksum = fnv1a_checksum(checksum, indices(), indexBytes());
+    checksum = fnv1a_checksum(checksum, edges(), edgeBytes());
+
+    if(checksum != m_header.checksum)
+    {
+        qDebug() << "Mesh cache checksum mismatch" << m_path;
+        release();
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Unmaps and closes the cache file. The section accessors are invalid afterwards.
+ */
+void MeshCache::release()
+{
+    if(m_mapping != nullptr)
+    {
+        m_file.unmap(m_mapping);
+        m_mapping = nullptr;
+    }
+
+    if(m_file.isOpen())
+    {
+        m_file.close();
+    }
+
+    m_header = Header{};
+}
+
+const uchar* MeshCache::vertices() const
+{
+    return m_mapping + sizeof(Header);
+}
+
+uint64_t MeshCache::vertexBytes() const
+{
+    return m_header.vertexBytes;
+}
+
+const uchar* MeshCache::indices() const
+{
+    return vertices() + aligned_section_size(m_header.vertexBytes);
+}
+
+uint64_t MeshCache::indexBytes() const
+{
+    return m_header.indexBytes;
+}
+
+/**
+ * \brief Size in bytes of one index, either 2 or 4
+ */
+uint32_t MeshCache::indexSize() const
+{
+    return m_header.indexSize;
+}
+
+const uchar* MeshCache::edges() const
+{
+    return indices() + aligned_section_size(m_header.indexBytes);
+}
+
+uint64_t MeshCache::edgeBytes() const
+{
+    return m_header.edgeBytes;
+}
+
+/**
+ * \brief Starts writing a new cache file for this key. The sections follow through storeVertices(),
+ *        storeIndices() and storeEdges(), in that order, and the file only replaces the old one in commitStore().
+ */
+bool MeshCache::beginStore()
+{
+    if(m_path.isEmpty() || !QDir().mkpath(QFileInfo(m_path).absolutePath()))
+    {
+        qDebug() << "No writable mesh cache directory";
+        return false;
+    }
+
+    m_store = std::make_unique<QSaveFile>(m_path);
+    if(!m_store->open(QIODevice::WriteOnly))
+    {
+        qDebug() << "Could not create mesh cache" << m_path;
+        m_store.reset();
+        return false;
+    }
+
+    m_header = expectedHeader();
+    m_storeChecksum = FNV_OFFSET_BASIS;
+    m_storedSections = 0U;
+
+    // The header is written again once the sizes and checksum are known
+    m_store->write(reinterpret_cast<const char*>(&m_header), sizeof(Header));
+
+    return true;
+}
+
+void MeshCache::storeVertices(const void* data, const uint64_t bytes)
+{
+    Q_ASSERT(m_storedSections == 0U);
+
+    m_header.vertexBytes = bytes;
+    storeSection(data, bytes);
+}
+
+void MeshCache::storeIndices(const void* data, const uint64_t bytes, const uint32_t indexSize)
+{
+    Q_ASSERT(m_storedSections == 1U);
+
+    m_header.indexBytes = bytes;
+    m_header.indexSize = indexSize;
+    storeSection(data, bytes);
+}
+
+void MeshCache::storeEdges(const void* data, const uint64_t bytes)
+{
+    Q_ASSERT(m_storedSections == 2U);
+
+    m_header.edgeBytes = bytes;
+    storeSection(data, bytes);
+}
+
+/**
+ * \brief Writes the final header and atomically replaces the cache file. Returns false, leaving any previous
+ *        file untouched, if the store was never started, is missing a section or hit a write error.
+ */
+bool MeshCache::commitStore()
+{
+    if(!m_store)
+    {
+        return false;
+    }
+
+    auto committed = false;
+    if(m_storedSections == NUMBER_OF_SECTIONS)
+    {
+        m_header.checksum = m_storeChecksum;
+
+        committed = m_store->seek(0) &&
+                    m_store->write(reinterpret_cast<const char*>(&m_header), sizeof(Header)) == sizeof(Header) &&
+                    m_store->commit();
+    }
+
+    if(!committed)
+    {
+        qDebug() << "Could not write mesh cache" << m_path;
+        m_store->cancelWriting();
+    }
+
+    m_store.reset();
+    m_header = Header{};
+
+    return committed;
+}
+
+/**
+ * \brief Header for this key and build, with the sizes and checksum left at zero
+ */
+MeshCache::Header MeshCache::expectedHeader() const
+{
+    static_assert(sizeof(Header) == 64, "The mesh cache header is compared and written as raw bytes");
+
+    auto header = Header{};
+    header.magic = MESH_CACHE_MAGIC;
+    header.fileVersion = MESH_CACHE_FILE_VERSION;
+    header.generatorVersion = PLANET_GENERATOR_VERSION;
+    header.numberOfSubdivisions = m_key.numberOfSubdivisions;
+    header.vertexFormat = static_cast<uint32_t>(m_key.vertexFormat);
+    header.topology = static_cast<uint32_t>(m_key.topology);
+    header.optimized = m_key.optimized ? 1U : 0U;
+
+    return header;
+}
+
+/**
+ * \brief Appends one section, padded to the section alignment, and folds it into the running checksum
+ */
+void MeshCache::storeSection(const void* data, const uint64_t bytes)
+{
+    static const char padding[MESH_CACHE_SECTION_ALIGNMENT] = {};
+
+    if(!m_store)
+    {
+        return;
+    }
+
+    m_store->write(static_cast<const char*>(data), bytes);
+    m_store->write(padding, aligned_section_size(bytes) - bytes);
+
+    m_storeChecksum = fnv1a_checksum(m_storeChecksum, static_cast<const uchar*>(data), bytes);
+    ++m_storedSections;
+}
@@ -0,0 +1,91 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <QFile>
+#include <QString>
+
+#include "planetgenerator.h"
+#include "vertexformat.h"
+
+class QSaveFile;
+
+/**
+ * \brief Everything that decides the contents of the uploaded planet mesh buffers
+ */
+struct MeshCacheKey
+{
+    uint32_t numberOfSubdivisions;
+    VertexFormat vertexFormat;
+    MeshTopology topology;
+    bool optimized;
+};
+
+/**
+ * \brief On-disk copy of the planet mesh buffers exactly as they were uploaded to OpenGL. A hit is memory mapped
+ *        and handed to glBufferData() without touching the generator. A miss is filled section by section, in
+ *        the order vertices, indices, edges, as the buffers are uploaded, and only replaces the file on commit.
+ */
+class MeshCache
+{
+public:
+    explicit MeshCache(const MeshCacheKey& key);
+    ~MeshCache();
+
+    MeshCache(const MeshCache&) = delete;
+    MeshCache& operator=(const MeshCache&) = delete;
+
+    bool load();
+    void release();
+
+    const uchar* vertices() const;
+    uint64_t vertexBytes() const;
+
+    const uchar* indices() const;
+    uint64_t indexBytes() const;
+    uint32_t indexSize() const;
+
+    const uchar* edges() const;
+    uint64_t edgeBytes() const;
+
+    bool beginStore();
+    void storeVertices(const void* data, uint64_t bytes);
+    void storeIndices(const void* data, uint64_t bytes, uint32_t indexSize);
+    void storeEdges(const void* data, uint64_t bytes);
+    bool commitStore();
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t fileVersion;
+        uint32_t generatorVersion;
+        uint32_t numberOfSubdivisions;
+        uint32_t vertexFormat;
+        uint32_t topology;
+        uint32_t optimized;
+        uint32_t indexSize;
+        uint64_t vertexBytes;
+        uint64_t indexBytes;
+        uint64_t edgeBytes;
+        uint64_t checksum;
+    };
+
+    Header expectedHeader() const;
+    void storeSection(const void* data, uint64_t bytes);
+
+private:
+    MeshCacheKey m_key;
+    QString m_path;
+
+    QFile m_file;
+    uchar* m_mapping;
+    Header m_header;
+
+    std::unique_ptr<QSaveFile> m_store;
+    uint64_t m_storeChecksum;
+    uint32_t m_storedSections;
+};
+
+#endif // MESHCACHE_H
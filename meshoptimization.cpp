@@ -0,0 +1,358 @@
+#include "meshoptimization.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <QtGlobal>
+
+namespace
+{
+    // Welding only has to catch rounding differences between the face generators, which are orders of magnitude
+    // smaller than the spacing of even the densest grid
+    constexpr auto WELD_TOLERANCE = 0.00001f;
+
+    // Conservative post-transform cache size. Tuning for a small FIFO still helps GPUs with larger caches.
+    constexpr auto VERTEX_CACHE_SIZE = 16U;
+
+    constexpr auto COMPONENTS_PER_VERTEX = 3U;
+    constexpr auto INDICES_PER_TRIANGLE = 3U;
+
+    constexpr auto CELL_KEY_BITS = 21U;
+    constexpr auto CELL_KEY_MASK = (1ULL << CELL_KEY_BITS) - 1ULL;
+}
+
+/**
+ * \brief Packs the integer coordinates of a spatial hash cell into a single key
+ */
+static uint64_t cell_key(const int64_t x, const int64_t y, const int64_t z)
+{
+    return ((static_cast<uint64_t>(x) & CELL_KEY_MASK) << (CELL_KEY_BITS * 2U)) |
+           ((static_cast<uint64_t>(y) & CELL_KEY_MASK) << CELL_KEY_BITS) |
+            (static_cast<uint64_t>(z) & CELL_KEY_MASK);
+}
+
+/**
+ * \brief Runs the whole post-pass on a mesh: seam vertices are welded, triangles are reordered for the
+ *        post-transform vertex cache, and vertices are renumbered in the order they are first used. The edge
+ *        list is kept in step with the vertices, and edges that became duplicates when seams were welded are
+ *        dropped. The report holds the vertex count and average cache miss ratio before and after.
+ */
+MeshOptimizationReport optimizeMesh(std::vector<float>& vertices,
+                                    std::vector<uint32_t>& indices,
+                                    std::vector<uint32_t>& edges)
+{
+    MeshOptimizationReport report;
+    report.verticesBefore = static_cast<uint32_t>(vertices.size() / COMPONENTS_PER_VERTEX);
+    report.acmrBefore = averageCacheMissRatio(indices, report.verticesBefore, VERTEX_CACHE_SIZE);
+
+    const auto weldRemap = weldVertices(vertices, indices, WELD_TOLERANCE);
+    report.verticesAfter = static_cast<uint32_t>(vertices.size() / COMPONENTS_PER_VERTEX);
+
+    optimizeVertexCache(indices, report.verticesAfter, VERTEX_CACHE_SIZE);
+    const auto fetchRemap = optimizeVertexFetch(vertices, indices);
+
+    remapEdges(edges, weldRemap);
+    remapEdges(edges, fetchRemap);
+
+    report.acmrAfter = averageCacheMissRatio(indices, report.verticesAfter, VERTEX_CACHE_SIZE);
+
+    return report;
+}
+
+/**
+ * \brief Merges vertices that are within tolerance of each other and rewrites the indices to match. Vertices
+ *        are bucketed into a spatial hash with cells the size of the tolerance, so only the 27 surrounding cells
+ *        need to be searched. Returns the new index of every original vertex.
+ */
+std::vector<uint32_t> weldVertices(std::vector<float>& vertices, std::vector<uint32_t>& indices, const float tolerance)
+{
+    Q_ASSERT(tolerance > 0.0f);
+    Q_ASSERT(vertices.size() % COMPONENTS_PER_VERTEX == 0U);
+
+    const auto numberOfVertices = static_cast<uint32_t>(vertices.size() / COMPONENTS_PER_VERTEX);
+    const auto toleranceSquared = tolerance * tolerance;
+
+    std::unordered_map<uint64_t, uint32_t> cells;
+    cells.reserve(numberOfVertices);
+
+    std::vector<uint32_t> remap(numberOfVertices);
+    auto numberOfWeldedVertices = 0U;
+
+    for(auto v = 0U; v < numberOfVertices; ++v)
+    {
+        const auto* position = &vertices[v * COMPONENTS_PER_VERTEX];
+        const auto x = static_cast<int64_t>(std::floor(position[0] / tolerance));
+        const auto y = static_cast<int64_t>(std::floor(position[1] / tolerance));
+        const auto z = static_cast<int64_t>(std::floor(position[2] / tolerance));
+
+        auto match = numberOfWeldedVertices;
+        for(auto dx = -1; dx <= 1 && match == numberOfWeldedVertices; ++dx)
+        {
+            for(auto dy = -1; dy <= 1 && match == numberOfWeldedVertices; ++dy)
+            {
+                for(auto dz = -1; dz <= 1 && match == numberOfWeldedVertices; ++dz)
+                {
+                    const auto cell = cells.find(cell_key(x + dx, y + dy, z + dz));
+                    if(cell == cells.end())
+                    {
+                        continue;
+                    }
+
+                    const auto* candidate = &vertices[cell->second * COMPONENTS_PER_VERTEX];
+                    const auto distanceSquared = ((position[0] - candidate[0]) * (position[0] - candidate[0])) +
+                                                 ((position[1] - candidate[1]) * (position[1] - candidate[1])) +
+                                                 ((position[2] - candidate[2]) * (position[2] - candidate[2]));
+                    if(distanceSquared <= toleranceSquared)
+                    {
+                        match = cell->second;
+                    }
+                }
+            }
+        }
+
+        if(match == numberOfWeldedVertices)
+        {
+            // Compact in place. The write position never passes the read position, so nothing unread is lost.
+            vertices[(match * COMPONENTS_PER_VERTEX) + 0U] = position[0];
+            vertices[(match * COMPONENTS_PER_VERTEX) + 1U] = position[1];
+            vertices[(match * COMPONENTS_PER_VERTEX) + 2U] = position[2];
+
+            cells.emplace(cell_key(x, y, z), match);
+            ++numberOfWeldedVertices;
+        }
+
+        remap[v] = match;
+    }
+
+    for(auto& index : indices)
+    {
+        index = remap[index];
+    }
+
+    vertices.resize(numberOfWeldedVertices * COMPONENTS_PER_VERTEX);
+    return remap;
+}
+
+/**
+ * \brief Reorders the triangles of an indexed triangle list with Tipsify (Sander, Nehab and Barczak 2007).
+ *        Triangles are emitted in fans around a focus vertex, and the next focus is the most recently used
+ *        vertex that will still be in the cache once its remaining triangles are emitted. Runs in linear time.
+ */
+void optimizeVertexCache(std::vector<uint32_t>& indices, const uint32_t numberOfVertices, const uint32_t cacheSize)
+{
+    Q_ASSERT(indices.size() % INDICES_PER_TRIANGLE == 0U);
+
+    const auto numberOfTriangles = static_cast<uint32_t>(indices.size() / INDICES_PER_TRIANGLE);
+    if(numberOfTriangles == 0U)
+    {
+        return;
+    }
+
+    // Vertex to triangle adjacency, stored as offsets into a single flat list
+    std::vector<uint32_t> liveTriangles(numberOfVertices, 0U);
+    for(const auto index : indices)
+    {
+        ++liveTriangles[index];
+    }
+
+    std::vector<uint32_t> adjacencyOffsets(numberOfVertices + 1U, 0U);
+    for(auto v = 0U; v < numberOfVertices; ++v)
+    {
+        adjacencyOffsets[v + 1U] = adjacencyOffsets[v] + liveTriangles[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+    for(auto triangle = 0U; triangle < numberOfTriangles; ++triangle)
+    {
+        for(auto corner = 0U; corner < INDICES_PER_TRIANGLE; ++corner)
+        {
+            adjacency[fill[indices[(triangle * INDICES_PER_TRIANGLE) + corner]]++] = triangle;
+        }
+    }
+
+    std::vector<uint32_t> cacheTimestamps(numberOfVertices, 0U);
+    std::vector<bool> emitted(numberOfTriangles, false);
+    std::vector<uint32_t> deadEnds;
+    std::vector<uint32_t> candidates;
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    auto timestamp = cacheSize + 1U;
+    auto cursor = 0U;
+    auto focus = indices.front();
+    auto hasFocus = true;
+
+    while(hasFocus)
+    {
+        candidates.clear();
+
+        for(auto a = adjacencyOffsets[focus]; a < adjacencyOffsets[focus + 1U]; ++a)
+        {
+            const auto triangle = adjacency[a];
+            if(emitted[triangle])
+            {
+                continue;
+            }
+
+            for(auto corner = 0U; corner < INDICES_PER_TRIANGLE; ++corner)
+            {
+                const auto v = indices[(triangle * INDICES_PER_TRIANGLE) + corner];
+
+                output.push_back(v);
+                deadEnds.push_back(v);
+                candidates.push_back(v);
+                --liveTriangles[v];
+
+                if(timestamp - cacheTimestamps[v] > cacheSize)
+                {
+                    cacheTimestamps[v] = timestamp++;
+                }
+            }
+
+            emitted[triangle] = true;
+        }
+
+        // Prefer the oldest candidate that will survive in the cache while its remaining fan is emitted
+        auto best = -1LL;
+        auto bestPriority = -1LL;
+        for(const auto v : candidates)
+        {
+            if(liveTriangles[v] == 0U)
+            {
+                continue;
+            }
+
+            auto priority = 0LL;
+            const auto age = static_cast<long long>(timestamp - cacheTimestamps[v]);
+            if(age + (2LL * liveTriangles[v]) <= static_cast<long long>(cacheSize))
+            {
+                priority = age;
+            }
+
+            if(priority > bestPriority)
+            {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+
+        // Dead end: fall back to recently emitted vertices, then to a linear scan
+        while(best < 0 && !deadEnds.empty())
+        {
+            const auto v = deadEnds.back();
+            deadEnds.pop_back();
+
+            if(liveTriangles[v] > 0U)
+            {
+                best = v;
+            }
+        }
+
+        while(best < 0 && cursor < numberOfVertices)
+        {
+            if(liveTriangles[cursor] > 0U)
+            {
+                best = cursor;
+            }
+
+            ++cursor;
+        }
+
+        hasFocus = (best >= 0);
+        focus = static_cast<uint32_t>(best);
+    }
+
+    Q_ASSERT(output.size() == indices.size());
+    indices.swap(output);
+}
+
+/**
+ * \brief Renumbers vertices in the order the index buffer first references them, so that vertex fetch walks
+ *        the vertex buffer mostly front to back. Unreferenced vertices are dropped. Returns the new index of every
+ *        original vertex.
+ */
+std::vector<uint32_t> optimizeVertexFetch(std::vector<float>& vertices, std::vector<uint32_t>& indices)
+{
+    constexpr auto UNASSIGNED = UINT32_MAX;
+
+    const auto numberOfVertices = static_cast<uint32_t>(vertices.size() / COMPONENTS_PER_VERTEX);
+
+    std::vector<uint32_t> remap(numberOfVertices, UNASSIGNED);
+    std::vector<float> reordered;
+    reordered.reserve(vertices.size());
+
+    auto next = 0U;
+    for(auto& index : indices)
+    {
+        if(remap[index] == UNASSIGNED)
+        {
+            remap[index] = next++;
+            reordered.insert(reordered.end(),
+                             vertices.begin() + (index * COMPONENTS_PER_VERTEX),
+                             vertices.begin() + ((index + 1U) * COMPONENTS_PER_VERTEX));
+        }
+
+        index = remap[index];
+    }
+
+    vertices.swap(reordered);
+    return remap;
+}
+
+/**
+ * \brief Applies a vertex remap from one of the passes above to a line list, then removes any edge that now
+ *        appears more than once, whichever way round its vertices are listed.
+ */
+void remapEdges(std::vector<uint32_t>& edges, const std::vector<uint32_t>& remap)
+{
+    Q_ASSERT(edges.size() % 2U == 0U);
+
+    std::vector<uint64_t> keys(edges.size() / 2U);
+    for(auto e = 0UL; e < keys.size(); ++e)
+    {
+        const auto a = remap[edges[(e * 2U) + 0U]];
+        const auto b = remap[edges[(e * 2U) + 1U]];
+
+        keys[e] = (static_cast<uint64_t>(qMin(a, b)) << 32U) | qMax(a, b);
+    }
+
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    edges.resize(keys.size() * 2U);
+    for(auto e = 0UL; e < keys.size(); ++e)
+    {
+        edges[(e * 2U) + 0U] = static_cast<uint32_t>(keys[e] >> 32U);
+        edges[(e * 2U) + 1U] = static_cast<uint32_t>(keys[e]);
+    }
+}
+
+/**
+ * \brief Simulates a FIFO post-transform cache of the given size and returns the number of vertex shader
+ *        invocations per triangle. 3.0 means no reuse at all; a regular grid can approach 0.5.
+ */
+float averageCacheMissRatio(const std::vector<uint32_t>& indices, const uint32_t numberOfVertices, const uint32_t cacheSize)
+{
+    const auto numberOfTriangles = indices.size() / INDICES_PER_TRIANGLE;
+    if(numberOfTriangles == 0U)
+    {
+        return 0.0f;
+    }
+
+    std::vector<uint32_t> cacheTimestamps(numberOfVertices, 0U);
+    auto timestamp = cacheSize + 1U;
+    auto misses = 0UL;
+
+    for(const auto index : indices)
+    {
+        if(timestamp - cacheTimestamps[index] > cacheSize)
+        {
+            cacheTimestamps[index] = timestamp++;
+            ++misses;
+        }
+    }
+
+    return static_cast<float>(misses) / static_cast<float>(numberOfTriangles);
+}
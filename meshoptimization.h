@@ -0,0 +1,26 @@
+#ifndef MESHOPTIMIZATION_H
+#define MESHOPTIMIZATION_H
+
+#include <cstdint>
+#include <vector>
+
+struct MeshOptimizationReport
+{
+    uint32_t verticesBefore;
+    uint32_t verticesAfter;
+    float acmrBefore;
+    float acmrAfter;
+};
+
+MeshOptimizationReport optimizeMesh(std::vector<float>& vertices,
+                                    std::vector<uint32_t>& indices,
+                                    std::vector<uint32_t>& edges);
+
+std::vector<uint32_t> weldVertices(std::vector<float>& vertices, std::vector<uint32_t>& indices, const float tolerance);
+void optimizeVertexCache(std::vector<uint32_t>& indices, const uint32_t numberOfVertices, const uint32_t cacheSize);
+std::vector<uint32_t> optimizeVertexFetch(std::vector<float>& vertices, std::vector<uint32_t>& indices);
+void remapEdges(std::vector<uint32_t>& edges, const std::vector<uint32_t>& remap);
+
+float averageCacheMissRatio(const std::vector<uint32_t>& indices, const uint32_t numberOfVertices, const uint32_t cacheSize);
+
+#endif // MESHOPTIMIZATION_H
@@ -0,0 +1,256 @@
+#include "mipchain.h"
+
+#include <cmath>
+#include <utility>
+#include <QtGlobal>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define MIP_CHAIN_X86
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+    constexpr auto RGBA_CHANNELS = 4U;
+
+    // Linear values are quantized to 12 bits before the sRGB lookup, which is finer than one 8-bit sRGB step
+    // everywhere except the first few codes above black, where the error stays under one step
+    constexpr auto LINEAR_TO_SRGB_TABLE_SIZE = 4096U;
+
+    struct GammaTables
+    {
+        float srgbToLinear[256];
+        uint8_t linearToSrgb[LINEAR_TO_SRGB_TABLE_SIZE];
+    };
+}
+
+static float srgb_to_linear(const float value)
+{
+    return (value <= 0.04045f) ? (value / 12.92f) : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float linear_to_srgb(const float value)
+{
+    return (value <= 0.0031308f) ? (value * 12.92f) : ((1.055f * std::pow(value, 1.0f / 2.4f)) - 0.055f);
+}
+
+/**
+ * \brief Lookup tables for both directions of the sRGB transfer function, built once on first use
+ */
+static const GammaTables& gamma_tables()
+{
+    static const GammaTables tables = []()
+    {
+        GammaTables result;
+
+        for(auto i = 0U; i < 256U; ++i)
+        {
+            result.srgbToLinear[i] = srgb_to_linear(i / 255.0f);
+        }
+
+        for(auto i = 0U; i < LINEAR_TO_SRGB_TABLE_SIZE; ++i)
+        {
+            const auto srgb = linear_to_srgb(i / static_cast<float>(LINEAR_TO_SRGB_TABLE_SIZE - 1U));
+            result.linearToSrgb[i] = static_cast<uint8_t>(std::lround(qBound(0.0f, srgb, 1.0f) * 255.0f));
+        }
+
+        return result;
+    }();
+
+    return tables;
+}
+
+/**
+ * \brief Averages a 2x2 footprint of 8-bit sRGB texels in linear light. Alpha is not gamma encoded and is
+ *        averaged as is. Used for the first level, so the full resolution image is never expanded to floats.
+ */
+static void downsample_srgb8_to_linear(const uint8_t* source,
+                                       const uint32_t width,
+                                       const uint32_t height,
+                                       float* destination)
+{
+    const auto& tables = gamma_tables();
+    const auto halfWidth = qMax(width / 2U, 1U);
+    const auto halfHeight = qMax(height / 2U, 1U);
+
+    for(auto y = 0U; y < halfHeight; ++y)
+    {
+        const uint8_t* rows[2] = { source + (static_cast<size_t>(qMin(y * 2U, height - 1U)) * width * RGBA_CHANNELS),
+                                   source + (static_cast<size_t>(qMin((y * 2U) + 1U, height - 1U)) * width * RGBA_CHANNELS) };
+
+        for(auto x = 0U; x < halfWidth; ++x)
+        {
+            const uint32_t columns[2] = { qMin(x * 2U, width - 1U) * RGBA_CHANNELS,
+                                          qMin((x * 2U) + 1U, width - 1U) * RGBA_CHANNELS };
+
+            auto* output = destination + ((static_cast<size_t>(y) * halfWidth + x) * RGBA_CHANNELS);
+
+#ifdef MIP_CHAIN_X86
+            auto sum = _mm_setzero_ps();
+            for(const auto* row : rows)
+            {
+                for(const auto column : columns)
+                {
+                    const auto* texel = row + column;
+                    sum = _mm_add_ps(sum, _mm_setr_ps(tables.srgbToLinear[texel[0]],
+                                                      tables.srgbToLinear[texel[1]],
+                                                      tables.srgbToLinear[texel[2]],
+                                                      texel[3] / 255.0f));
+                }
+            }
+            _mm_storeu_ps(output, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+            for(auto c = 0U; c < RGBA_CHANNELS; ++c)
+            {
+                auto sum = 0.0f;
+                for(const auto* row : rows)
+                {
+                    for(const auto column : columns)
+                    {
+                        sum += (c < 3U) ? tables.srgbToLinear[row[column + c]] : (row[column + c] / 255.0f);
+                    }
+                }
+                output[c] = sum * 0.25f;
+            }
+#endif
+        }
+    }
+}
+
+/**
+ * \brief Averages a 2x2 footprint of linear float RGBA texels. One texel fills one SSE register, so the inner
+ *        loop is four vector loads, three adds and a multiply.
+ */
+static void downsample_linear(const float* source, const uint32_t width, const uint32_t height, float* destination)
+{
+    const auto halfWidth = qMax(width / 2U, 1U);
+    const auto halfHeight = qMax(height / 2U, 1U);
+
+    for(auto y = 0U; y < halfHeight; ++y)
+    {
+        const auto* top = source + (static_cast<size_t>(qMin(y * 2U, height - 1U)) * width * RGBA_CHANNELS);
+        const auto* bottom = source + (static_cast<size_t>(qMin((y * 2U) + 1U, height - 1U)) * width * RGBA_CHANNELS);
+
+        for(auto x = 0U; x < halfWidth; ++x)
+        {
+            const auto left = qMin(x * 2U, width - 1U) * RGBA_CHANNELS;
+            const auto right = qMin((x * 2U) + 1U, width - 1U) * RGBA_CHANNELS;
+
+            auto* output = destination + ((static_cast<size_t>(y) * halfWidth + x) * RGBA_CHANNELS);
+
+#ifdef MIP_CHAIN_X86
+            const auto sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(top + left), _mm_loadu_ps(top + right)),
+                                        _mm_add_ps(_mm_loadu_ps(bottom + left), _mm_loadu_ps(bottom + right)));
+            _mm_storeu_ps(output, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+            for(auto c = 0U; c < RGBA_CHANNELS; ++c)
+            {
+                output[c] = (top[left + c] + top[right + c] + bottom[left + c] + bottom[right + c]) * 0.25f;
+            }
+#endif
+        }
+    }
+}
+
+/**
+ * \brief Converts linear float RGBA back to 8-bit sRGB with alpha left linear
+ */
+static void encode_srgb8(const float* source, const size_t numberOfTexels, uint8_t* destination)
+{
+    const auto& tables = gamma_tables();
+
+    for(auto i = 0ULL; i < numberOfTexels; ++i)
+    {
+        const auto* texel = source + (i * RGBA_CHANNELS);
+        auto* output = destination + (i * RGBA_CHANNELS);
+
+#ifdef MIP_CHAIN_X86
+        // Clamp, scale colour to the table size and alpha to 8 bits, and round all four channels at once
+        const auto scale = _mm_setr_ps(LINEAR_TO_SRGB_TABLE_SIZE - 1.0f, LINEAR_TO_SRGB_TABLE_SIZE - 1.0f,
+                                       LINEAR_TO_SRGB_TABLE_SIZE - 1.0f, 255.0f);
+        const auto clamped = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(texel), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+
+        alignas(16) int32_t quantized[RGBA_CHANNELS];
+        _mm_store_si128(reinterpret_cast<__m128i*>(quantized), _mm_cvtps_epi32(_mm_mul_ps(clamped, scale)));
+#else
+        int32_t quantized[RGBA_CHANNELS];
+        for(auto c = 0U; c < RGBA_CHANNELS; ++c)
+        {
+            const auto scale = (c < 3U) ? (LINEAR_TO_SRGB_TABLE_SIZE - 1.0f) : 255.0f;
+            quantized[c] = static_cast<int32_t>(std::lround(qBound(0.0f, texel[c], 1.0f) * scale));
+        }
+#endif
+
+        output[0] = tables.linearToSrgb[quantized[0]];
+        output[1] = tables.linearToSrgb[quantized[1]];
+        output[2] = tables.linearToSrgb[quantized[2]];
+        output[3] = static_cast<uint8_t>(quantized[3]);
+    }
+}
+
+/**
+ * \brief Number of levels in a full mip chain, down to and including 1x1
+ */
+uint32_t mipLevelCount(uint32_t width, uint32_t height)
+{
+    auto levels = 1U;
+    while(width > 1U || height > 1U)
+    {
+        width = qMax(width / 2U, 1U);
+        height = qMax(height / 2U, 1U);
+        ++levels;
+    }
+
+    return levels;
+}
+
+/**
+ * \brief Builds every level below the given 8-bit sRGB RGBA image with a 2x2 box filter applied in linear light,
+ *        so dark and bright regions blend without the darkening a filter in gamma space produces. The chain is
+ *        carried in linear floats from one level to the next and only rounded to 8 bits for output. Returns
+ *        levels 1 to mipLevelCount() - 1. Thread safe, so the faces of a cubemap can be processed concurrently.
+ */
+std::vector<std::vector<uint8_t>> generateMipChain(const uint8_t* rgba, uint32_t width, uint32_t height)
+{
+    std::vector<std::vector<uint8_t>> levels;
+    std::vector<float> previous;
+    std::vector<float> current;
+
+    while(width > 1U || height > 1U)
+    {
+        const auto halfWidth = qMax(width / 2U, 1U);
+        const auto halfHeight = qMax(height / 2U, 1U);
+        const auto numberOfTexels = static_cast<size_t>(halfWidth) * halfHeight;
+
+        current.resize(numberOfTexels * RGBA_CHANNELS);
+        if(levels.empty())
+        {
+            downsample_srgb8_to_linear(rgba, width, height, current.data());
+        }
+        else
+        {
+            downsample_linear(previous.data(), width, height, current.data());
+        }
+
+        levels.emplace_back(numberOfTexels * RGBA_CHANNELS);
+        encode_srgb8(current.data(), numberOfTexels, levels.back().data());
+
+        std::swap(previous, current);
+        width = halfWidth;
+        height = halfHeight;
+    }
+
+    return levels;
+}
+
+/**
+ * \brief Name of the instruction set the filters were compiled for, for logging and benchmarks
+ */
+const char* mipChainKernelName()
+{
+#ifdef MIP_CHAIN_X86
+    return "SSE2";
+#else
+    return "Scalar";
+#endif
+}
@@ -0,0 +1,12 @@
+#ifndef MIPCHAIN_H
+#define MIPCHAIN_H
+
+#include <cstdint>
+#include <vector>
+
+uint32_t mipLevelCount(uint32_t width, uint32_t height);
+std::vector<std::vector<uint8_t>> generateMipChain(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+const char* mipChainKernelName();
+
+#endif // MIPCHAIN_H
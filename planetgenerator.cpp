@@ -1,113 +1,182 @@
 #include "planetgenerator.h"
+#include "taskscheduler.h"
+#include "vertexkernels.h"
 
-#include <thread>
+#include <QDebug>
 #include <utility>
-#include <QVector3D>
 
 namespace
 {
-    constexpr auto FRONT_FACE_START_INDEX  = 0UL;
-    constexpr auto BACK_FACE_START_INDEX   = 1UL;
-    constexpr auto LEFT_FACE_START_INDEX   = 2UL;
-    constexpr auto RIGHT_FACE_START_INDEX  = 3UL;
-    constexpr auto TOP_FACE_START_INDEX    = 4UL;
-    constexpr auto BOTTOM_FACE_START_INDEX = 5UL;
+    // Rows of a face generated by one scheduler task. Small enough that the 6 faces of even a coarse mesh split
+    // into more tasks than there are cores, large enough that a task outweighs the cost of queueing it.
+    constexpr auto ROWS_PER_TASK = 32U;
 }
 
 /**
- * \brief Generation function for the front face
+ * \brief Public facing function of the planet generator. Generation is split into blocks of rows across all six
+ *        faces and run on the shared TaskScheduler. Each block deposits its values in a specific section of each
+ *        of the vectors so no thread safety mechanism is reaquired.
  */
-static void generate_front_face(std::vector<float>& vertices,
-                                std::vector<uint32_t>& indices,
-                                const uint32_t vertices_per_side)
+std::pair<std::vector<float>, std::vector<uint32_t>>
+generateSubdividedCube(const uint32_t numberOfSubdivisions)
 {
-    auto step = 1.0f / (vertices_per_side - 1UL);
-    auto n = (vertices_per_side * vertices_per_side * 3U) * FRONT_FACE_START_INDEX;
+    return generateSubdividedCube(numberOfSubdivisions, TaskScheduler::instance());
+}
 
-    QVector3D temp;
+/**
+ * \brief Overload of generateSubdividedCube() that runs on the given scheduler instead of the shared one.
+ */
+std::pair<std::vector<float>, std::vector<uint32_t>>
+generateSubdividedCube(const uint32_t numberOfSubdivisions, TaskScheduler& scheduler)
+{
+    std::vector<float> vertices(subdividedCubeVertexCount(numberOfSubdivisions) * 3UL, 0.0f);
+    std::vector<uint32_t> indices(subdividedCubeIndexCount(numberOfSubdivisions), 0UL);
 
-    for(auto i = 0U; i < vertices_per_side; i++)
-    {
-        for(auto j = 0U; j < vertices_per_side; j++)
-        {
-            temp.setX(j * step - 0.5f); // X
-            temp.setY(i * step - 0.5f); // Y
-            temp.setZ(0.5f);            // Z
+    generateSubdividedCubeInto(numberOfSubdivisions,
+                               vertices.data(), vertices.size(),
+                               indices.data(), indices.size(),
+                               scheduler);
 
-            temp.normalize();
+    return std::make_pair(std::move(vertices), std::move(indices));
+}
 
-            vertices.at(n + 0UL) = temp.x();
-            vertices.at(n + 1UL) = temp.y();
-            vertices.at(n + 2UL) = temp.z();
+/**
+ * \brief Number of vertices in the subdivided cube. The vertex buffer holds three floats for each.
+ */
+size_t subdividedCubeVertexCount(const uint32_t numberOfSubdivisions)
+{
+    const auto verticesPerSide = static_cast<size_t>(numberOfSubdivisions) + 2UL;
 
-            n += 3UL;
-        }
+    return verticesPerSide * verticesPerSide * NUMBER_OF_CUBE_FACES;
+}
+
+/**
+ * \brief Number of triangle list indices in the subdivided cube
+ */
+size_t subdividedCubeIndexCount(const uint32_t numberOfSubdivisions)
+{
+    const auto quadsPerSide = static_cast<size_t>(numberOfSubdivisions) + 1UL;
+
+    return quadsPerSide * quadsPerSide * 6UL * NUMBER_OF_CUBE_FACES;
+}
+
+/**
+ * \brief Generates the subdivided cube straight into memory owned by the caller, such as a mapped OpenGL
+ *        buffer, instead of into vectors that are then copied. Capacities are in floats and indices. indices
+ *        may be null when only the vertices are wanted. Returns false without writing anything if either
+ *        buffer is too small.
+ */
+bool generateSubdividedCubeInto(const uint32_t numberOfSubdivisions,
+                                float* vertices,
+                                const size_t vertexCapacity,
+                                uint32_t* indices,
+                                const size_t indexCapacity)
+{
+    return generateSubdividedCubeInto(numberOfSubdivisions, vertices, vertexCapacity, indices, indexCapacity,
+                                      TaskScheduler::instance());
+}
+
+/**
+ * \brief Overload of generateSubdividedCubeInto() that runs on the given scheduler instead of the shared one.
+ */
+bool generateSubdividedCubeInto(const uint32_t numberOfSubdivisions,
+                                float* vertices,
+                                const size_t vertexCapacity,
+                                uint32_t* indices,
+                                const size_t indexCapacity,
+                                TaskScheduler& scheduler)
+{
+    if(vertices == nullptr || vertexCapacity < subdividedCubeVertexCount(numberOfSubdivisions) * 3UL)
+    {
+        qDebug() << "Vertex buffer too small for" << numberOfSubdivisions << "subdivisions";
+        return false;
     }
 
-    n = ((vertices_per_side - 1UL)  * (vertices_per_side - 1UL) * 6UL) * FRONT_FACE_START_INDEX;
-    auto offset = vertices_per_side * vertices_per_side * FRONT_FACE_START_INDEX;
+    if(indices != nullptr && indexCapacity < subdividedCubeIndexCount(numberOfSubdivisions))
+    {
+        qDebug() << "Index buffer too small for" << numberOfSubdivisions << "subdivisions";
+        return false;
+    }
+
+    const auto verticesPerSide = numberOfSubdivisions + 2U;
+
+    // Every face is broken into the same number of row blocks, numbered face by face
+    const auto blocksPerFace = (verticesPerSide + ROWS_PER_TASK - 1U) / ROWS_PER_TASK;
 
-    for(auto i = 0U; i < vertices_per_side - 1U; ++i)
+    scheduler.parallelFor(0U, blocksPerFace * NUMBER_OF_CUBE_FACES, 1U, [&](const uint32_t first, const uint32_t last)
     {
-        for(auto j = 0U; j < vertices_per_side - 1U; ++j)
+        for(auto block = first; block < last; ++block)
         {
-            indices.at(n + 0UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 1UL) = offset + (i * vertices_per_side) + j + 1UL; // Y
-            indices.at(n + 2UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Z
+            const auto face = static_cast<CubeFace>(block / blocksPerFace);
+            const auto firstRow = (block % blocksPerFace) * ROWS_PER_TASK;
+            const auto lastRow = qMin(firstRow + ROWS_PER_TASK, verticesPerSide);
 
-            indices.at(n + 3UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 4UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Y
-            indices.at(n + 5UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 0UL); // Z
-
-            n += 6UL;
+            generateCubeFaceRows(face, verticesPerSide, firstRow, lastRow, vertices, indices);
         }
-    }
+    });
+
+    return true;
 }
 
 /**
- * \brief Generation function for the back face
+ * \brief Generates rows [firstRow, lastRow) of one face of the subdivided cube, writing them into the face's
+ *        section of the full cube buffers. Both the vertices of each row and the quads between it and the next
+ *        row are written, so disjoint row ranges can be generated concurrently. indices may be null.
  */
-static void generate_back_face(std::vector<float>& vertices,
-                               std::vector<uint32_t>& indices,
-                               const uint32_t vertices_per_side)
+void generateCubeFaceRows(const CubeFace face,
+                          const uint32_t verticesPerSide,
+                          const uint32_t firstRow,
+                          const uint32_t lastRow,
+                          float* vertices,
+                          uint32_t* indices)
 {
-    auto step = 1.0f / (vertices_per_side - 1UL);
-    auto n = (vertices_per_side * vertices_per_side * 3U) * BACK_FACE_START_INDEX;
+    Q_ASSERT(verticesPerSide >= 2U);
+    Q_ASSERT(lastRow <= verticesPerSide);
 
-    QVector3D temp;
+    const auto faceIndex = static_cast<uint32_t>(face);
+    const auto step = 1.0f / (verticesPerSide - 1UL);
 
-    for(auto i = 0U; i < vertices_per_side; i++)
-    {
-        for(auto j = 0U; j < vertices_per_side; j++)
-        {
-            temp.setX(1.0f - (j * step) - 0.5f); // X
-            temp.setY(i * step - 0.5f); // Y
-            temp.setZ(-0.5f);            // Z
+    // Each face is an affine map of the unit square, so it's described by its first corner and two edges
+    const auto origin = cubeFacePoint(face, 0.0f, 0.0f);
+    const auto columnAxis = cubeFacePoint(face, 1.0f, 0.0f) - origin;
+    const auto rowAxis = cubeFacePoint(face, 0.0f, 1.0f) - origin;
 
-            temp.normalize();
+    const float axis[3] = { columnAxis.x(), columnAxis.y(), columnAxis.z() };
 
-            vertices.at(n + 0UL) = temp.x();
-            vertices.at(n + 1UL) = temp.y();
-            vertices.at(n + 2UL) = temp.z();
+    auto n = (verticesPerSide * verticesPerSide * 3UL) * faceIndex + (firstRow * verticesPerSide * 3UL);
 
-            n+= 3UL;
-        }
+    for(auto i = firstRow; i < lastRow; ++i)
+    {
+        const auto rowStart = origin + (rowAxis * (i * step));
+        const float start[3] = { rowStart.x(), rowStart.y(), rowStart.z() };
+
+        // Whole rows are computed and normalized at once, straight into the output buffer
+        projectRowToSphere(start, axis, step, verticesPerSide, vertices + n);
+        n += verticesPerSide * 3UL;
     }
 
-    n = ((vertices_per_side - 1UL)  * (vertices_per_side - 1UL) * 6UL) * BACK_FACE_START_INDEX;
-    auto offset = vertices_per_side * vertices_per_side * BACK_FACE_START_INDEX;
+    if(indices == nullptr)
+    {
+        return;
+    }
 
-    for(auto i = 0U; i < vertices_per_side - 1U; ++i)
+    const auto lastQuadRow = qMin(lastRow, verticesPerSide - 1U);
+    const auto offset = verticesPerSide * verticesPerSide * faceIndex;
+
+    n = ((verticesPerSide - 1UL) * (verticesPerSide - 1UL) * 6UL) * faceIndex +
+        (firstRow * (verticesPerSide - 1UL) * 6UL);
+
+    for(auto i = firstRow; i < lastQuadRow; ++i)
     {
-        for(auto j = 0U; j < vertices_per_side - 1U; ++j)
+        for(auto j = 0U; j < verticesPerSide - 1U; ++j)
         {
-            indices.at(n + 0UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 1UL) = offset + (i * vertices_per_side) + j + 1UL; // Y
-            indices.at(n + 2UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Z
+            indices[n + 0UL] = offset + (i * verticesPerSide) + j;
+            indices[n + 1UL] = offset + (i * verticesPerSide) + j + 1UL;
+            indices[n + 2UL] = offset + (i * verticesPerSide) + j + (verticesPerSide + 1UL);
 
-            indices.at(n + 3UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 4UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Y
-            indices.at(n + 5UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 0UL); // Z
+            indices[n + 3UL] = offset + (i * verticesPerSide) + j;
+            indices[n + 4UL] = offset + (i * verticesPerSide) + j + (verticesPerSide + 1UL);
+            indices[n + 5UL] = offset + (i * verticesPerSide) + j + (verticesPerSide + 0UL);
 
             n += 6UL;
         }
@@ -115,231 +184,388 @@ static void generate_back_face(std::vector<float>& vertices,
 }
 
 /**
- * \brief Generation function for the left face
+ * \brief Writes the edges of rows [firstRow, lastRow) of a grid as a line list. Each row owns its horizontal
+ *        edges plus the vertical and diagonal edges up to the next row, which covers every edge of the triangle
+ *        list exactly once. edges points at the first edge of the grid, not of the first row.
  */
-static void generate_left_face(std::vector<float>& vertices,
-                               std::vector<uint32_t>& indices,
-                               const uint32_t vertices_per_side)
+static void write_grid_edge_rows(const uint32_t verticesPerSide,
+                                 const uint32_t offset,
+                                 const uint32_t firstRow,
+                                 const uint32_t lastRow,
+                                 uint32_t* edges)
 {
-    auto step = 1.0f / (vertices_per_side - 1UL);
-    auto n = (vertices_per_side * vertices_per_side * 3U) * LEFT_FACE_START_INDEX;
-
-    QVector3D temp;
+    const auto edgesPerRow = (verticesPerSide * 3U) - 2U;
+    auto n = firstRow * edgesPerRow * 2UL;
 
-    for(auto i = 0U; i < vertices_per_side; i++)
+    for(auto i = firstRow; i < lastRow; ++i)
     {
-        for(auto j = 0U; j < vertices_per_side; j++)
+        const auto row = offset + (i * verticesPerSide);
+
+        for(auto j = 0U; j < verticesPerSide - 1U; ++j)
         {
-            temp.setX(-0.5f);           // X
-            temp.setY(i * step - 0.5f); // Y
-            temp.setZ(j * step - 0.5f); // Z
+            edges[n++] = row + j;
+            edges[n++] = row + j + 1U;
+        }
 
-            temp.normalize();
+        // The last row has nothing above it
+        if(i == verticesPerSide - 1U)
+        {
+            continue;
+        }
 
-            vertices.at(n + 0UL) = temp.x();
-            vertices.at(n + 1UL) = temp.y();
-            vertices.at(n + 2UL) = temp.z();
+        for(auto j = 0U; j < verticesPerSide; ++j)
+        {
+            edges[n++] = row + j;
+            edges[n++] = row + j + verticesPerSide;
+        }
 
-            n += 3UL;
+        for(auto j = 0U; j < verticesPerSide - 1U; ++j)
+        {
+            edges[n++] = row + j;
+            edges[n++] = row + j + verticesPerSide + 1U;
         }
     }
+}
 
-    n = ((vertices_per_side - 1UL)  * (vertices_per_side - 1UL) * 6UL) * LEFT_FACE_START_INDEX;
-    auto offset = vertices_per_side * vertices_per_side * LEFT_FACE_START_INDEX;
+/**
+ * \brief Number of edges in a grid with the given number of vertices per side
+ */
+static uint32_t grid_edge_count(const uint32_t verticesPerSide)
+{
+    return (verticesPerSide - 1U) * ((verticesPerSide * 3U) - 1U);
+}
 
-    for(auto i = 0U; i < vertices_per_side - 1U; ++i)
+/**
+ * \brief Line list containing every edge of the triangles returned by generateSubdividedCube() once, for
+ *        wireframe rendering. Generated in the same row blocks as the vertices, on the shared TaskScheduler.
+ */
+std::vector<uint32_t> generateSubdividedCubeEdges(const uint32_t numberOfSubdivisions)
+{
+    return generateSubdividedCubeEdges(numberOfSubdivisions, TaskScheduler::instance());
+}
+
+/**
+ * \brief Overload of generateSubdividedCubeEdges() that runs on the given scheduler instead of the shared one.
+ */
+std::vector<uint32_t> generateSubdividedCubeEdges(const uint32_t numberOfSubdivisions, TaskScheduler& scheduler)
+{
+    const auto verticesPerSide = numberOfSubdivisions + 2U;
+    const auto edgesPerFace = grid_edge_count(verticesPerSide);
+
+    std::vector<uint32_t> edges(edgesPerFace * 2UL * NUMBER_OF_CUBE_FACES, 0U);
+
+    const auto blocksPerFace = (verticesPerSide + ROWS_PER_TASK - 1U) / ROWS_PER_TASK;
+
+    scheduler.parallelFor(0U, blocksPerFace * NUMBER_OF_CUBE_FACES, 1U, [&](const uint32_t first, const uint32_t last)
     {
-        for(auto j = 0U; j < vertices_per_side - 1U; ++j)
+        for(auto block = first; block < last; ++block)
         {
-            indices.at(n + 0UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 1UL) = offset + (i * vertices_per_side) + j + 1UL; // Y
-            indices.at(n + 2UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Z
+            const auto face = block / blocksPerFace;
+            const auto firstRow = (block % blocksPerFace) * ROWS_PER_TASK;
+            const auto lastRow = qMin(firstRow + ROWS_PER_TASK, verticesPerSide);
+
+            write_grid_edge_rows(verticesPerSide,
+                                 face * verticesPerSide * verticesPerSide,
+                                 firstRow,
+                                 lastRow,
+                                 edges.data() + (face * edgesPerFace * 2UL));
+        }
+    });
 
-            indices.at(n + 3UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 4UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Y
-            indices.at(n + 5UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 0UL); // Z
+    return edges;
+}
 
-            n += 6UL;
+/**
+ * \brief Appends the triangle strips of one face: one strip per row of quads, each terminated by the restart
+ *        index except the last. Vertices alternate between the upper and lower row, which gives the same
+ *        triangles, diagonals and winding as the triangle list.
+ */
+template<typename IndexType>
+static void append_face_strip_indices(std::vector<IndexType>& indices,
+                                      const uint32_t verticesPerSide,
+                                      const uint32_t offset,
+                                      const IndexType restartIndex)
+{
+    for(auto i = 0U; i < verticesPerSide - 1U; ++i)
+    {
+        if(i > 0U)
+        {
+            indices.push_back(restartIndex);
+        }
+
+        for(auto j = 0U; j < verticesPerSide; ++j)
+        {
+            indices.push_back(static_cast<IndexType>(offset + ((i + 1U) * verticesPerSide) + j));
+            indices.push_back(static_cast<IndexType>(offset + (i * verticesPerSide) + j));
         }
     }
 }
 
 /**
- * \brief Generation function for the right face
+ * \brief True when every vertex of a single face can be addressed by a 16-bit index. The largest value is
+ *        reserved for primitive restart.
  */
-static void generate_right_face(std::vector<float>& vertices,
-                                std::vector<uint32_t>& indices,
-                                const uint32_t vertices_per_side)
+bool cubeFaceFitsIn16BitIndices(const uint32_t numberOfSubdivisions)
 {
-    auto step = 1.0f / (vertices_per_side - 1UL);
-    auto n = (vertices_per_side * vertices_per_side * 3U) * RIGHT_FACE_START_INDEX;
+    const auto verticesPerSide = static_cast<uint64_t>(numberOfSubdivisions) + 2U;
+    return (verticesPerSide * verticesPerSide) <= PRIMITIVE_RESTART_INDEX_16;
+}
+
+/**
+ * \brief Strip indices for a single face, relative to the first vertex of that face. Every face of the cube
+ *        has the same layout, so the same buffer draws all six by offsetting the base vertex.
+ */
+std::vector<uint16_t> generateCubeFaceStripIndices16(const uint32_t numberOfSubdivisions)
+{
+    Q_ASSERT(cubeFaceFitsIn16BitIndices(numberOfSubdivisions));
+
+    const auto verticesPerSide = numberOfSubdivisions + 2U;
+
+    std::vector<uint16_t> indices;
+    indices.reserve((verticesPerSide - 1U) * ((verticesPerSide * 2U) + 1U));
 
-    QVector3D temp;
+    append_face_strip_indices<uint16_t>(indices, verticesPerSide, 0U, PRIMITIVE_RESTART_INDEX_16);
 
-    for(auto i = 0U; i < vertices_per_side; i++)
+    return indices;
+}
+
+/**
+ * \brief Strip indices for the whole cube in a single draw, for meshes too dense for 16-bit face indices
+ */
+std::vector<uint32_t> generateSubdividedCubeStripIndices(const uint32_t numberOfSubdivisions)
+{
+    const auto verticesPerSide = numberOfSubdivisions + 2U;
+
+    std::vector<uint32_t> indices;
+    indices.reserve((verticesPerSide - 1U) * ((verticesPerSide * 2U) + 1U) * NUMBER_OF_CUBE_FACES);
+
+    for(auto face = 0U; face < NUMBER_OF_CUBE_FACES; ++face)
     {
-        for(auto j = 0U; j < vertices_per_side; j++)
+        if(face > 0U)
         {
-            temp.setX(0.5f);            // X
-            temp.setY(i * step - 0.5f); // Y
-            temp.setZ(1.0f - (j * step) - 0.5f); // Z
+            indices.push_back(PRIMITIVE_RESTART_INDEX_32);
+        }
 
-            temp.normalize();
+        append_face_strip_indices<uint32_t>(indices,
+                                            verticesPerSide,
+                                            face * verticesPerSide * verticesPerSide,
+                                            PRIMITIVE_RESTART_INDEX_32);
+    }
 
-            vertices.at(n + 0UL) = temp.x();
-            vertices.at(n + 1UL) = temp.y();
-            vertices.at(n + 2UL) = temp.z();
+    return indices;
+}
 
-            n += 3UL;
-        }
+/**
+ * \brief Maps a point on one face of the unit cube to its un-normalized position. s and t run from 0 to 1 along
+ *        the columns and rows of the face respectively, matching the orientation of the generate_*_face functions.
+ */
+QVector3D cubeFacePoint(const CubeFace face, const float s, const float t)
+{
+    switch(face)
+    {
+    case CubeFace::Front:
+        return QVector3D(s - 0.5f, t - 0.5f, 0.5f);
+    case CubeFace::Back:
+        return QVector3D(1.0f - s - 0.5f, t - 0.5f, -0.5f);
+    case CubeFace::Left:
+        return QVector3D(-0.5f, t - 0.5f, s - 0.5f);
+    case CubeFace::Right:
+        return QVector3D(0.5f, t - 0.5f, 1.0f - s - 0.5f);
+    case CubeFace::Top:
+        return QVector3D(1.0f - s - 0.5f, 0.5f, t - 0.5f);
+    case CubeFace::Bottom:
+        return QVector3D(s - 0.5f, -0.5f, t - 0.5f);
     }
 
-    n = ((vertices_per_side - 1UL)  * (vertices_per_side - 1UL) * 6UL) * RIGHT_FACE_START_INDEX;
-    auto offset = vertices_per_side * vertices_per_side * RIGHT_FACE_START_INDEX;
+    Q_ASSERT(false);
+    return QVector3D();
+}
+
+/**
+ * \brief Returns the perimeter of a chunk grid as row/column pairs, walked counter-clockwise starting at the
+ *        first row and column. Used to stitch the skirt onto the edges of the chunk.
+ */
+static std::vector<std::pair<uint32_t, uint32_t>> chunk_perimeter(const uint32_t quadsPerSide)
+{
+    std::vector<std::pair<uint32_t, uint32_t>> perimeter;
+    perimeter.reserve(quadsPerSide * 4U);
+
+    for(auto j = 0U; j < quadsPerSide; ++j)
+    {
+        perimeter.emplace_back(0U, j);
+    }
 
-    for(auto i = 0U; i < vertices_per_side - 1U; ++i)
+    for(auto i = 0U; i < quadsPerSide; ++i)
     {
-        for(auto j = 0U; j < vertices_per_side - 1U; ++j)
-        {
-            indices.at(n + 0UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 1UL) = offset + (i * vertices_per_side) + j + 1UL; // Y
-            indices.at(n + 2UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Z
+        perimeter.emplace_back(i, quadsPerSide);
+    }
 
-            indices.at(n + 3UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 4UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Y
-            indices.at(n + 5UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 0UL); // Z
+    for(auto j = quadsPerSide; j > 0U; --j)
+    {
+        perimeter.emplace_back(quadsPerSide, j);
+    }
 
-            n += 6UL;
-        }
+    for(auto i = quadsPerSide; i > 0U; --i)
+    {
+        perimeter.emplace_back(i, 0U);
     }
+
+    return perimeter;
 }
 
 /**
- * \brief Generation function for the top face
+ * \brief Generates the vertices of a single level of detail chunk. The chunk covers the square [s, s + size] x
+ *        [t, t + size] of the given face and is split into quadsPerSide x quadsPerSide quads. The grid is followed
+ *        by a skirt: a copy of the perimeter pulled towards the center of the planet by skirtDepth, which hides the
+ *        cracks between neighbouring chunks of different levels.
  */
-static void generate_top_face(std::vector<float>& vertices,
-                              std::vector<uint32_t>& indices,
-                              const uint32_t vertices_per_side)
+std::vector<float>
+generateCubeFaceChunk(const CubeFace face,
+                      const float s,
+                      const float t,
+                      const float size,
+                      const uint32_t quadsPerSide,
+                      const float skirtDepth)
 {
-    auto step = 1.0f / (vertices_per_side - 1UL);
-    auto n = (vertices_per_side * vertices_per_side * 3U) * TOP_FACE_START_INDEX;
+    Q_ASSERT(quadsPerSide > 0U);
 
-    QVector3D temp;
+    const auto verticesPerSide = quadsPerSide + 1U;
+    const auto step = size / quadsPerSide;
 
-    for(auto i = 0U; i < vertices_per_side; i++)
-    {
-        for(auto j = 0U; j < vertices_per_side; j++)
-        {
-            temp.setX(1.0f - (j * step) - 0.5f); // X
-            temp.setY(0.5f);            // Y
-            temp.setZ(i * step - 0.5f); // Z
+    std::vector<float> vertices((verticesPerSide * verticesPerSide + quadsPerSide * 4U) * 3U);
 
-            temp.normalize();
+    const auto origin = cubeFacePoint(face, s, t);
+    const auto columnAxis = cubeFacePoint(face, s + 1.0f, t) - cubeFacePoint(face, s, t);
+    const auto rowAxis = cubeFacePoint(face, s, t + 1.0f) - cubeFacePoint(face, s, t);
+    const float axis[3] = { columnAxis.x(), columnAxis.y(), columnAxis.z() };
 
-            vertices.at(n + 0UL) = temp.x();
-            vertices.at(n + 1UL) = temp.y();
-            vertices.at(n + 2UL) = temp.z();
+    for(auto i = 0U; i < verticesPerSide; ++i)
+    {
+        const auto rowStart = origin + (rowAxis * (i * step));
+        const float start[3] = { rowStart.x(), rowStart.y(), rowStart.z() };
 
-            n += 3UL;
-        }
+        projectRowToSphere(start, axis, step, verticesPerSide, &vertices[i * verticesPerSide * 3U]);
     }
 
-    n = ((vertices_per_side - 1UL)  * (vertices_per_side - 1UL) * 6UL) * TOP_FACE_START_INDEX;
-    auto offset = vertices_per_side * vertices_per_side * TOP_FACE_START_INDEX;
-
-    for(auto i = 0U; i < vertices_per_side - 1U; ++i)
+    const auto skirtScale = 1.0f - skirtDepth;
+    auto skirt = verticesPerSide * verticesPerSide * 3U;
+    for(const auto& [i, j] : chunk_perimeter(quadsPerSide))
     {
-        for(auto j = 0U; j < vertices_per_side - 1U; ++j)
-        {
-            indices.at(n + 0UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 1UL) = offset + (i * vertices_per_side) + j + 1UL; // Y
-            indices.at(n + 2UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Z
+        const auto n = ((i * verticesPerSide) + j) * 3U;
 
-            indices.at(n + 3UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 4UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Y
-            indices.at(n + 5UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 0UL); // Z
+        vertices[skirt + 0U] = vertices[n + 0U] * skirtScale;
+        vertices[skirt + 1U] = vertices[n + 1U] * skirtScale;
+        vertices[skirt + 2U] = vertices[n + 2U] * skirtScale;
 
-            n += 6UL;
-        }
+        skirt += 3U;
     }
+
+    return vertices;
 }
 
 /**
- * \brief Generation function for the bottom face
+ * \brief Generates the grid patch every chunk can be drawn from when instanced, with the same vertex layout as
+ *        generateCubeFaceChunk(). Each vertex holds its column and row across the chunk, from 0 to 1, and 1 on the
+ *        skirt or 0 on the surface. cube-map.vert places the patch on a face and projects it onto the sphere.
  */
-static void generate_bottom_face(std::vector<float>& vertices,
-                                 std::vector<uint32_t>& indices,
-                                 const uint32_t vertices_per_side)
+std::vector<float>
+generateCubeFaceChunkPatch(const uint32_t quadsPerSide)
 {
-    auto step = 1.0f / (vertices_per_side - 1UL);
-    auto n = (vertices_per_side * vertices_per_side * 3U) * BOTTOM_FACE_START_INDEX;
+    Q_ASSERT(quadsPerSide > 0U);
 
-    QVector3D temp;
+    const auto verticesPerSide = quadsPerSide + 1U;
+    const auto step = 1.0f / quadsPerSide;
 
-    for(auto i = 0U; i < vertices_per_side; i++)
+    std::vector<float> vertices;
+    vertices.reserve((verticesPerSide * verticesPerSide + quadsPerSide * 4U) * 3U);
+
+    for(auto i = 0U; i < verticesPerSide; ++i)
     {
-        for(auto j = 0U; j < vertices_per_side; j++)
+        for(auto j = 0U; j < verticesPerSide; ++j)
         {
-            temp.setX(j * step - 0.5f); // X
-            temp.setY(-0.5f);           // Y
-            temp.setZ(i * step - 0.5f); // Z
+            vertices.push_back(j * step);
+            vertices.push_back(i * step);
+            vertices.push_back(0.0f);
+        }
+    }
 
-            temp.normalize();
+    for(const auto& corner : chunk_perimeter(quadsPerSide))
+    {
+        vertices.push_back(corner.second * step);
+        vertices.push_back(corner.first * step);
+        vertices.push_back(1.0f);
+    }
 
-            vertices.at(n + 0UL) = temp.x();
-            vertices.at(n + 1UL) = temp.y();
-            vertices.at(n + 2UL) = temp.z();
+    return vertices;
+}
 
-            n += 3UL;
-        }
-    }
+/**
+ * \brief Line list of the grid edges shared by every chunk produced by generateCubeFaceChunk(). Skirts are left
+ *        out, so a wireframe shows the surface only.
+ */
+std::vector<uint32_t>
+generateCubeFaceChunkEdges(const uint32_t quadsPerSide)
+{
+    const auto verticesPerSide = quadsPerSide + 1U;
+
+    std::vector<uint32_t> edges(grid_edge_count(verticesPerSide) * 2UL, 0U);
+    write_grid_edge_rows(verticesPerSide, 0U, 0U, verticesPerSide, edges.data());
+
+    return edges;
+}
+
+/**
+ * \brief Generates the index buffer shared by every chunk produced by generateCubeFaceChunk(). All chunks with
+ *        the same number of quads have the same topology, so the buffer only has to be created once.
+ */
+std::vector<uint32_t>
+generateCubeFaceChunkIndices(const uint32_t quadsPerSide)
+{
+    Q_ASSERT(quadsPerSide > 0U);
 
-    n = ((vertices_per_side - 1UL)  * (vertices_per_side - 1UL) * 6UL) * BOTTOM_FACE_START_INDEX;
-    auto offset = vertices_per_side * vertices_per_side * BOTTOM_FACE_START_INDEX;
+    const auto verticesPerSide = quadsPerSide + 1U;
 
-    for(auto i = 0U; i < vertices_per_side - 1U; ++i)
+    std::vector<uint32_t> indices;
+    indices.reserve((quadsPerSide * quadsPerSide * 6U) + (quadsPerSide * 4U * 6U));
+
+    for(auto i = 0U; i < quadsPerSide; ++i)
     {
-        for(auto j = 0U; j < vertices_per_side - 1U; ++j)
+        for(auto j = 0U; j < quadsPerSide; ++j)
         {
-            indices.at(n + 0UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 1UL) = offset + (i * vertices_per_side) + j + 1UL; // Y
-            indices.at(n + 2UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Z
+            const auto corner = (i * verticesPerSide) + j;
 
-            indices.at(n + 3UL) = offset + (i * vertices_per_side) + j;       // X
-            indices.at(n + 4UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 1UL); // Y
-            indices.at(n + 5UL) = offset + (i * vertices_per_side) + j + (vertices_per_side + 0UL); // Z
+            indices.push_back(corner);
+            indices.push_back(corner + 1U);
+            indices.push_back(corner + verticesPerSide + 1U);
 
-            n += 6UL;
+            indices.push_back(corner);
+            indices.push_back(corner + verticesPerSide + 1U);
+            indices.push_back(corner + verticesPerSide);
         }
     }
-}
 
-/**
- * \brief Public facing function of the planet generator. This is a multithread vertex calculator that populates
- *        the vertex and index intermediate buffers and returns them for use by the application. Each function
- *        deposits its values in a specific section of each of the vectors so no thread safety mechanism is reaquired.
- */
-std::pair<std::vector<float>, std::vector<uint32_t>>
-generateSubdividedCube(const uint32_t numberOfSubdivisions)
-{
-    const auto verticesPerSide = numberOfSubdivisions + 2U;
+    // Walking the perimeter counter-clockwise keeps the outside of the skirt front facing
+    const auto perimeter = chunk_perimeter(quadsPerSide);
+    const auto skirtStart = verticesPerSide * verticesPerSide;
+    const auto perimeterLength = static_cast<uint32_t>(perimeter.size());
 
-    std::vector<float> vertices(((verticesPerSide * verticesPerSide * 3) * 6), 0.0f);
-    std::vector<uint32_t> indices((((verticesPerSide - 1) * (verticesPerSide - 1) * 6) * 6), 0UL);
+    for(auto k = 0U; k < perimeterLength; ++k)
+    {
+        const auto next = (k + 1U) % perimeterLength;
 
-    std::thread front_thread(generate_front_face,   std::ref(vertices), std::ref(indices), verticesPerSide);
-    std::thread back_thread(generate_back_face,     std::ref(vertices), std::ref(indices), verticesPerSide);
-    std::thread left_thread(generate_left_face,     std::ref(vertices), std::ref(indices), verticesPerSide);
-    std::thread right_thread(generate_right_face,   std::ref(vertices), std::ref(indices), verticesPerSide);
-    std::thread top_thread(generate_top_face,       std::ref(vertices), std::ref(indices), verticesPerSide);
-    std::thread bottom_thread(generate_bottom_face, std::ref(vertices), std::ref(indices), verticesPerSide);
+        const auto edge0 = (perimeter[k].first * verticesPerSide) + perimeter[k].second;
+        const auto edge1 = (perimeter[next].first * verticesPerSide) + perimeter[next].second;
+        const auto skirt0 = skirtStart + k;
+        const auto skirt1 = skirtStart + next;
 
-    front_thread.join();
-    back_thread.join();
-    left_thread.join();
-    right_thread.join();
-    top_thread.join();
-    bottom_thread.join();
+        indices.push_back(edge0);
+        indices.push_back(skirt0);
+        indices.push_back(edge1);
+
+        indices.push_back(edge1);
+        indices.push_back(skirt0);
+        indices.push_back(skirt1);
+    }
 
-    return std::make_pair(vertices, indices);
+    return indices;
 }
@@ -1,10 +1,98 @@
 #ifndef PLANETGENERATOR_H
 #define PLANETGENERATOR_H
 
+#include <cstddef>
 #include <cstdint>
+#include <utility>
 #include <vector>
+#include <QVector3D>
+
+class TaskScheduler;
+
+/**
+ * \brief Faces of the subdivided cube, in the same order they are laid out in the generated buffers
+ */
+enum class CubeFace : uint32_t
+{
+    Front = 0U,
+    Back,
+    Left,
+    Right,
+    Top,
+    Bottom
+};
+
+constexpr auto NUMBER_OF_CUBE_FACES = 6U;
+
+/**
+ * \brief Index layouts the planet mesh can be drawn with
+ */
+enum class MeshTopology
+{
+    TriangleList, // Six 32-bit indices per quad, as returned by generateSubdividedCube()
+    TriangleStrip // One strip per row of quads, separated by the primitive restart index
+};
+
+// Bump whenever a change to the generator or the mesh optimizer changes the buffers it produces, so that
+// meshes cached on disk by older builds are regenerated
+constexpr uint32_t PLANET_GENERATOR_VERSION = 1U;
+
+constexpr uint16_t PRIMITIVE_RESTART_INDEX_16 = UINT16_MAX;
+constexpr uint32_t PRIMITIVE_RESTART_INDEX_32 = UINT32_MAX;
 
 std::pair<std::vector<float>, std::vector<uint32_t>>
 generateSubdividedCube(const uint32_t numberOfSubdivisions);
 
+std::pair<std::vector<float>, std::vector<uint32_t>>
+generateSubdividedCube(const uint32_t numberOfSubdivisions, TaskScheduler& scheduler);
+
+size_t subdividedCubeVertexCount(const uint32_t numberOfSubdivisions);
+size_t subdividedCubeIndexCount(const uint32_t numberOfSubdivisions);
+
+bool generateSubdividedCubeInto(const uint32_t numberOfSubdivisions,
+                                float* vertices,
+                                const size_t vertexCapacity,
+                                uint32_t* indices,
+                                const size_t indexCapacity);
+
+bool generateSubdividedCubeInto(const uint32_t numberOfSubdivisions,
+                                float* vertices,
+                                const size_t vertexCapacity,
+                                uint32_t* indices,
+                                const size_t indexCapacity,
+                                TaskScheduler& scheduler);
+
+void generateCubeFaceRows(const CubeFace face,
+                          const uint32_t verticesPerSide,
+                          const uint32_t firstRow,
+                          const uint32_t lastRow,
+                          float* vertices,
+                          uint32_t* indices);
+
+std::vector<uint32_t> generateSubdividedCubeEdges(const uint32_t numberOfSubdivisions);
+std::vector<uint32_t> generateSubdividedCubeEdges(const uint32_t numberOfSubdivisions, TaskScheduler& scheduler);
+
+bool cubeFaceFitsIn16BitIndices(const uint32_t numberOfSubdivisions);
+std::vector<uint16_t> generateCubeFaceStripIndices16(const uint32_t numberOfSubdivisions);
+std::vector<uint32_t> generateSubdividedCubeStripIndices(const uint32_t numberOfSubdivisions);
+
+QVector3D cubeFacePoint(const CubeFace face, const float s, const float t);
+
+std::vector<float>
+generateCubeFaceChunk(const CubeFace face,
+                      const float s,
+                      const float t,
+                      const float size,
+                      const uint32_t quadsPerSide,
+                      const float skirtDepth);
+
+std::vector<float>
+generateCubeFaceChunkPatch(const uint32_t quadsPerSide);
+
+std::vector<uint32_t>
+generateCubeFaceChunkIndices(const uint32_t quadsPerSide);
+
+std::vector<uint32_t>
+generateCubeFaceChunkEdges(const uint32_t quadsPerSide);
+
 #endif // PLANETGENERATOR_H
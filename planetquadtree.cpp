@@ -0,0 +1,301 @@
+#include "planetquadtree.h"
+#include "camera.h"
+#include "culling.h"
+
+#include <QtMath>
+
+namespace
+{
+    constexpr auto NUMBER_OF_CHILDREN = 4U;
+
+    // Children are only merged back once their parent is comfortably under the error limit. Without this the
+    // tree would split and merge on alternating frames when the camera sits right at the threshold.
+    constexpr auto MERGE_HYSTERESIS = 0.75f;
+
+    // Guards the error metric against division by zero when the camera is inside a chunk's bounding sphere
+    constexpr auto MINIMUM_CHUNK_DISTANCE = 0.0001f;
+
+    constexpr auto FACE_KEY_SHIFT  = 61U;
+    constexpr auto LEVEL_KEY_SHIFT = 56U;
+    constexpr auto X_KEY_SHIFT     = 28U;
+}
+
+/**
+ * \brief Constructor for a quadtree node. The bounding sphere and geometric error are calculated once here
+ *        because a node never changes the part of the face it covers.
+ */
+QuadTreeNode::QuadTreeNode(const CubeFace face,
+                           const uint32_t level,
+                           const uint32_t x,
+                           const uint32_t y,
+                           const uint32_t quadsPerSide) :
+    face{face},
+    level{level},
+    x{x},
+    y{y},
+    center(),
+    boundingRadius{0.0f},
+    geometricError{0.0f},
+    normalConeAngle{0.0f},
+    children()
+{
+    const auto half = size() / 2.0f;
+    center = cubeFacePoint(face, s() + half, t() + half).normalized();
+
+    // Chunk edges lie on great circles, so the furthest point from the center is always on the boundary
+    for(auto i = 0U; i <= 2U; ++i)
+    {
+        for(auto j = 0U; j <= 2U; ++j)
+        {
+            const auto point = cubeFacePoint(face, s() + (j * half), t() + (i * half)).normalized();
+            boundingRadius = qMax(boundingRadius, center.distanceToPoint(point));
+            normalConeAngle = qMax(normalConeAngle, qAcos(qBound(-1.0f, QVector3D::dotProduct(center, point), 1.0f)));
+        }
+    }
+
+    // A quad spans roughly 2 radians per unit of face coordinate at the center of the face. The largest gap
+    // between the flat quad and the sphere is the sagitta of its diagonal.
+    const auto quadDiagonalAngle = 2.0f * qSqrt(2.0f) * (size() / quadsPerSide);
+    geometricError = 1.0f - qCos(quadDiagonalAngle / 2.0f);
+
+    // The normals of the vertices span the cone to the boundary, a flat triangle can lean out of it by no more
+    // than half the angle its diagonal covers
+    normalConeAngle += quadDiagonalAngle / 2.0f;
+}
+
+/**
+ * \brief Unique identifier for the node. Used by the renderer to look up the mesh built for this node.
+ */
+uint64_t QuadTreeNode::key() const
+{
+    return (static_cast<uint64_t>(face) << FACE_KEY_SHIFT) |
+           (static_cast<uint64_t>(level) << LEVEL_KEY_SHIFT) |
+           (static_cast<uint64_t>(x) << X_KEY_SHIFT) |
+           static_cast<uint64_t>(y);
+}
+
+/**
+ * \brief A node without children is the one that gets drawn
+ */
+bool QuadTreeNode::isLeaf() const
+{
+    return children[0] == nullptr;
+}
+
+/**
+ * \brief Face coordinate of the first column covered by this node
+ */
+float QuadTreeNode::s() const
+{
+    return x * size();
+}
+
+/**
+ * \brief Face coordinate of the first row covered by this node
+ */
+float QuadTreeNode::t() const
+{
+    return y * size();
+}
+
+/**
+ * \brief Width of this node in face coordinates. Each level halves the size of the one above it.
+ */
+float QuadTreeNode::size() const
+{
+    return 1.0f / static_cast<float>(1UL << level);
+}
+
+/**
+ * \brief Constructor for the planet quadtree. One root is created per face of the cube and the tree starts
+ *        out fully merged.
+ */
+PlanetQuadTree::PlanetQuadTree(const uint32_t quadsPerChunkSide,
+                               const uint32_t maximumDepth,
+                               const float maximumScreenSpaceError) :
+    m_roots(),
+    m_activeChunks(),
+    m_visibleChunks(),
+    m_quadsPerChunkSide{quadsPerChunkSide},
+    m_maximumDepth{maximumDepth},
+    m_maximumScreenSpaceError{maximumScreenSpaceError}
+{
+    Q_ASSERT(quadsPerChunkSide > 0U);
+    Q_ASSERT(maximumDepth < (1U << (FACE_KEY_SHIFT - LEVEL_KEY_SHIFT)));
+
+    for(auto face = 0U; face < NUMBER_OF_CUBE_FACES; ++face)
+    {
+        m_roots[face] = std::make_unique<QuadTreeNode>(static_cast<CubeFace>(face), 0U, 0U, 0U, quadsPerChunkSide);
+    }
+}
+
+/**
+ * \brief Splits and merges the tree for the current camera, then rebuilds the list of chunks to draw.
+ *        viewportHeight must be in pixels so the error threshold is in pixels as well.
+ */
+void PlanetQuadTree::update(const Camera& camera, const float viewportHeight)
+{
+    const auto cameraPosition = camera.position();
+    const auto projectionScale = camera.projectionScale(viewportHeight);
+
+    m_activeChunks.clear();
+    for(auto& root : m_roots)
+    {
+        updateNode(*root, cameraPosition, projectionScale);
+    }
+
+    m_visibleChunks = m_activeChunks;
+}
+
+/**
+ * \brief Narrows the visible chunks down to those that intersect the view frustum and reach over the horizon.
+ *        Chunk geometry dips below the surface by the depth of its skirt, skirtDepthScale times its geometric
+ *        error, and by the sag of its flat quads, so both tests are widened by that much.
+ */
+void PlanetQuadTree::cull(const ViewFrustum& frustum, const QVector3D& cameraPosition, const float skirtDepthScale)
+{
+    m_visibleChunks.clear();
+
+    for(const auto* node : m_activeChunks)
+    {
+        const auto depth = (skirtDepthScale + 1.0f) * node->geometricError;
+
+        if(isBeyondHorizon(cameraPosition, node->center, node->normalConeAngle, 1.0f - depth))
+        {
+            continue;
+        }
+
+        if(!frustum.intersectsSphere(node->center, node->boundingRadius + depth))
+        {
+            continue;
+        }
+
+        m_visibleChunks.push_back(node);
+    }
+}
+
+/**
+ * \brief Accessor for the leaves selected by the last call to update()
+ */
+const std::vector<const QuadTreeNode*>& PlanetQuadTree::activeChunks() const
+{
+    return m_activeChunks;
+}
+
+/**
+ * \brief The active chunks that survived the last call to cull(), or all of them if it wasn't called since the
+ *        last update()
+ */
+const std::vector<const QuadTreeNode*>& PlanetQuadTree::visibleChunks() const
+{
+    return m_visibleChunks;
+}
+
+/**
+ * \brief Number of triangles, skirts included, that drawing the visible chunks will submit
+ */
+uint32_t PlanetQuadTree::numberOfTriangles() const
+{
+    const auto trianglesPerChunk = (m_quadsPerChunkSide * m_quadsPerChunkSide * 2U) + (m_quadsPerChunkSide * 8U);
+    return static_cast<uint32_t>(m_visibleChunks.size()) * trianglesPerChunk;
+}
+
+/**
+ * \brief Accessor for the number of quads along each side of a chunk
+ */
+uint32_t PlanetQuadTree::quadsPerChunkSide() const
+{
+    return m_quadsPerChunkSide;
+}
+
+/**
+ * \brief Accessor for the screen space error threshold, in pixels
+ */
+float PlanetQuadTree::maximumScreenSpaceError() const
+{
+    return m_maximumScreenSpaceError;
+}
+
+/**
+ * \brief Mutator for the screen space error threshold, in pixels. Takes effect on the next update().
+ */
+void PlanetQuadTree::setMaximumScreenSpaceError(const float error)
+{
+    if(error > 0.0f)
+    {
+        m_maximumScreenSpaceError = error;
+    }
+}
+
+/**
+ * \brief Recursive step of update(). Leaves that are too coarse are split, parents whose own mesh would now
+ *        be good enough are merged, and whatever ends up as a leaf is added to the active chunk list.
+ */
+void PlanetQuadTree::updateNode(QuadTreeNode& node, const QVector3D& cameraPosition, const float projectionScale)
+{
+    const auto error = screenSpaceError(node, cameraPosition, projectionScale);
+
+    if(node.isLeaf())
+    {
+        if(error > m_maximumScreenSpaceError && node.level < m_maximumDepth)
+        {
+            split(node);
+        }
+    }
+    else if(error < m_maximumScreenSpaceError * MERGE_HYSTERESIS)
+    {
+        merge(node);
+    }
+
+    if(node.isLeaf())
+    {
+        m_activeChunks.push_back(&node);
+        return;
+    }
+
+    for(auto& child : node.children)
+    {
+        updateNode(*child, cameraPosition, projectionScale);
+    }
+}
+
+/**
+ * \brief Projects the geometric error of the node onto the screen using the distance from the camera to the
+ *        closest point of its bounding sphere.
+ */
+float PlanetQuadTree::screenSpaceError(const QuadTreeNode& node,
+                                       const QVector3D& cameraPosition,
+                                       const float projectionScale) const
+{
+    auto distance = cameraPosition.distanceToPoint(node.center) - node.boundingRadius;
+    distance = qMax(distance, MINIMUM_CHUNK_DISTANCE);
+
+    return (node.geometricError * projectionScale) / distance;
+}
+
+/**
+ * \brief Creates the four children of a leaf
+ */
+void PlanetQuadTree::split(QuadTreeNode& node)
+{
+    Q_ASSERT(node.isLeaf());
+
+    for(auto child = 0U; child < NUMBER_OF_CHILDREN; ++child)
+    {
+        const auto x = (node.x * 2U) + (child & 1U);
+        const auto y = (node.y * 2U) + (child >> 1U);
+
+        node.children[child] = std::make_unique<QuadTreeNode>(node.face, node.level + 1U, x, y, m_quadsPerChunkSide);
+    }
+}
+
+/**
+ * \brief Destroys every descendant of the node, turning it back into a leaf
+ */
+void PlanetQuadTree::merge(QuadTreeNode& node)
+{
+    for(auto& child : node.children)
+    {
+        child.reset();
+    }
+}
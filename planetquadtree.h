@@ -0,0 +1,73 @@
+#ifndef PLANETQUADTREE_H
+#define PLANETQUADTREE_H
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <QVector3D>
+
+#include "planetgenerator.h"
+
+class Camera;
+class ViewFrustum;
+
+struct QuadTreeNode
+{
+    QuadTreeNode(CubeFace face, uint32_t level, uint32_t x, uint32_t y, uint32_t quadsPerSide);
+
+    uint64_t key() const;
+    bool isLeaf() const;
+
+    float s() const;
+    float t() const;
+    float size() const;
+
+    CubeFace face;
+    uint32_t level;
+    uint32_t x;
+    uint32_t y;
+
+    QVector3D center;
+    float boundingRadius;
+    float geometricError;
+    float normalConeAngle; // Half angle, around center, of a cone holding the normal of every triangle
+
+    std::array<std::unique_ptr<QuadTreeNode>, 4> children;
+};
+
+class PlanetQuadTree
+{
+public:
+    PlanetQuadTree(uint32_t quadsPerChunkSide, uint32_t maximumDepth, float maximumScreenSpaceError);
+
+    void update(const Camera& camera, float viewportHeight);
+    void cull(const ViewFrustum& frustum, const QVector3D& cameraPosition, float skirtDepthScale);
+
+    const std::vector<const QuadTreeNode*>& activeChunks() const;
+    const std::vector<const QuadTreeNode*>& visibleChunks() const;
+    uint32_t numberOfTriangles() const;
+
+    uint32_t quadsPerChunkSide() const;
+
+    float maximumScreenSpaceError() const;
+    void setMaximumScreenSpaceError(float error);
+
+private:
+    void updateNode(QuadTreeNode& node, const QVector3D& cameraPosition, float projectionScale);
+    float screenSpaceError(const QuadTreeNode& node, const QVector3D& cameraPosition, float projectionScale) const;
+
+    void split(QuadTreeNode& node);
+    void merge(QuadTreeNode& node);
+
+private:
+    std::array<std::unique_ptr<QuadTreeNode>, NUMBER_OF_CUBE_FACES> m_roots;
+    std::vector<const QuadTreeNode*> m_activeChunks;
+    std::vector<const QuadTreeNode*> m_visibleChunks;
+
+    uint32_t m_quadsPerChunkSide;
+    uint32_t m_maximumDepth;
+    float m_maximumScreenSpaceError;
+};
+
+#endif // PLANETQUADTREE_H
@@ -0,0 +1,497 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <QDebug>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QOpenGLTimerQuery>
+#include <QSaveFile>
+
+namespace
+{
+    // About 2.5 MB, which holds several seconds of frames or the whole of initialization
+    constexpr auto DEFAULT_EVENT_CAPACITY = 65536U;
+
+    // The GPU and CPU clocks drift apart slowly, so their offset is measured again every few seconds
+    constexpr auto CALIBRATION_INTERVAL = 256U; // frames
+
+    constexpr auto UNASSIGNED_TRACK = ~0U;
+    constexpr auto NANOSECONDS_PER_MICROSECOND = 1000.0;
+    constexpr auto NANOSECONDS_PER_MILLISECOND = 1.0e6;
+
+    const auto TRACE_PROCESS_NAME = "Qt Globe Engine";
+    const auto GPU_TRACK_NAME = "GPU";
+
+    // Each thread's track, handed out on the first span it times
+    thread_local auto s_currentTrack = UNASSIGNED_TRACK;
+}
+
+/**
+ * \brief Constructor for the profiler. Once capacity events have been recorded each new one replaces the oldest.
+ */
+Profiler::Profiler(const uint32_t capacity) :
+    m_mutex(),
+    m_events(qMax(capacity, 1U)),
+    m_nextEvent{0},
+    m_numberOfEvents{0},
+    m_trackNames{GPU_TRACK_NAME},
+    m_frameNumber{0U},
+    m_numberOfTracks{PROFILER_GPU_TRACK + 1U},
+    m_clock()
+{
+    m_clock.start();
+}
+
+/**
+ * \brief Process wide profiler, created on first use
+ */
+Profiler& Profiler::instance()
+{
+    static Profiler profiler(DEFAULT_EVENT_CAPACITY);
+    return profiler;
+}
+
+/**
+ * \brief Starts the next frame. Everything recorded before the first call belongs to frame 0, initialization.
+ */
+void Profiler::beginFrame()
+{
+    ++m_frameNumber;
+}
+
+/**
+ * \brief Accessor for the number of the frame in progress
+ */
+uint64_t Profiler::frameNumber() const
+{
+    return m_frameNumber.load();
+}
+
+/**
+ * \brief Nanoseconds since the profiler was created, the clock every event is measured against
+ */
+uint64_t Profiler::now() const
+{
+    return static_cast<uint64_t>(m_clock.nsecsElapsed());
+}
+
+/**
+ * \brief Track of the calling thread, assigned the first time the thread asks for it
+ */
+uint32_t Profiler::currentTrack()
+{
+    if(s_currentTrack == UNASSIGNED_TRACK)
+    {
+        s_currentTrack = m_numberOfTracks++;
+    }
+
+    return s_currentTrack;
+}
+
+/**
+ * \brief Names the calling thread's track in the trace. Threads without a name are numbered.
+ */
+void Profiler::nameCurrentTrack(const char* name)
+{
+    const auto track = currentTrack();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if(m_trackNames.size() <= track)
+    {
+        m_trackNames.resize(track + 1U, nullptr);
+    }
+    m_trackNames[track] = name;
+}
+
+/**
+ * \brief Adds a span running from start to end, both in now() nanoseconds, overwriting the oldest event once the
+ *        ring buffer is full
+ */
+void Profiler::record(const char* name, const uint64_t start, const uint64_t end, const uint32_t track,
+                      const uint64_t frame)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_events[m_nextEvent] = { name, start, (end > start) ? end - start : 0U, frame, track };
+    m_nextEvent = (m_nextEvent + 1U) % m_events.size();
+    m_numberOfEvents = qMin(m_numberOfEvents + 1U, m_events.size());
+}
+
+/**
+ * \brief Copy of every event in the ring buffer, oldest first
+ */
+std::vector<ProfileEvent> Profiler::events() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<ProfileEvent> events;
+    events.reserve(m_numberOfEvents);
+
+    const auto oldestEvent = m_nextEvent + m_events.size() - m_numberOfEvents;
+    for(auto i = size_t{0}; i < m_numberOfEvents; ++i)
+    {
+        events.push_back(m_events[(oldestEvent + i) % m_events.size()]);
+    }
+
+    return events;
+}
+
+/**
+ * \brief Average and worst time per frame spent in each named span over the last numberOfFrames complete frames,
+ *        CPU spans first in the order they were first seen, then GPU spans. Each average only counts the frames
+ *        the span ran in, so occasional work such as building chunk meshes isn't diluted by the frames without it.
+ *        Initialization is left out, it only shows in the trace.
+ */
+std::vector<ProfileSummary> Profiler::summary(const uint32_t numberOfFrames) const
+{
+    struct Accumulator
+    {
+        ProfileSummary summary;
+        uint64_t frame;
+        double frameMilliseconds;
+        uint32_t numberOfFrames;
+    };
+
+    const auto currentFrame = frameNumber();
+    const auto firstFrame = qMax<uint64_t>((currentFrame > numberOfFrames) ? currentFrame - numberOfFrames : 0U, 1U);
+
+    std::vector<Accumulator> accumulators;
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        const auto oldestEvent = m_nextEvent + m_events.size() - m_numberOfEvents;
+        for(auto i = size_t{0}; i < m_numberOfEvents; ++i)
+        {
+            const auto& event = m_events[(oldestEvent + i) % m_events.size()];
+            if(event.frame < firstFrame || event.frame >= currentFrame)
+            {
+                continue;
+            }
+
+            const auto gpu = (event.track == PROFILER_GPU_TRACK);
+            auto accumulator = std::find_if(accumulators.begin(), accumulators.end(), [&](const Accumulator& candidate)
+            {
+                return candidate.summary.gpu == gpu && std::strcmp(candidate.summary.name, event.name) == 0;
+            });
+
+            if(accumulator == accumulators.end())
+            {
+                accumulators.push_back({ { event.name, gpu, 0.0, 0.0 }, event.frame, 0.0, 1U });
+                accumulator = accumulators.end() - 1;
+            }
+            else if(accumulator->frame != event.frame)
+            {
+                accumulator->summary.maximumMilliseconds = qMax(accumulator->summary.maximumMilliseconds,
+                                                                accumulator->frameMilliseconds);
+                accumulator->frame = event.frame;
+                accumulator->frameMilliseconds = 0.0;
+                ++accumulator->numberOfFrames;
+            }
+
+            const auto milliseconds = event.duration / NANOSECONDS_PER_MILLISECOND;
+            accumulator->frameMilliseconds += milliseconds;
+            accumulator->summary.averageMilliseconds += milliseconds;
+        }
+    }
+
+    std::vector<ProfileSummary> summaries;
+    summaries.reserve(accumulators.size());
+
+    for(const auto gpu : { false, true })
+    {
+        for(auto& accumulator : accumulators)
+        {
+            if(accumulator.summary.gpu == gpu)
+            {
+                accumulator.summary.averageMilliseconds /= accumulator.numberOfFrames;
+                accumulator.summary.maximumMilliseconds = qMax(accumulator.summary.maximumMilliseconds,
+                                                               accumulator.frameMilliseconds);
+                summaries.push_back(accumulator.summary);
+            }
+        }
+    }
+
+    return summaries;
+}
+
+/**
+ * \brief Writes every event in the ring buffer to path as Chrome trace events, which chrome://tracing and
+ *        Perfetto open directly. Each thread and the GPU are a track of their own.
+ */
+bool Profiler::writeChromeTrace(const QString& path) const
+{
+    const auto snapshot = events();
+
+    std::vector<const char*> trackNames;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        trackNames = m_trackNames;
+    }
+
+    QJsonArray traceEvents;
+
+    traceEvents.append(QJsonObject{
+        { "name", "process_name" }, { "ph", "M" }, { "pid", 1 },
+        { "args", QJsonObject{ { "name", TRACE_PROCESS_NAME } } }
+    });
+
+    for(auto track = 0U; track < m_numberOfTracks.load(); ++track)
+    {
+        const auto name = (track < trackNames.size() && trackNames[track] != nullptr)
+                        ? QString::fromLatin1(trackNames[track])
+                        : QStringLiteral("Thread %1").arg(track);
+
+        traceEvents.append(QJsonObject{
+            { "name", "thread_name" }, { "ph", "M" }, { "pid", 1 }, { "tid", static_cast<int>(track) },
+            { "args", QJsonObject{ { "name", name } } }
+        });
+    }
+
+    for(const auto& event : snapshot)
+    {
+        traceEvents.append(QJsonObject{
+            { "name", QString::fromLatin1(event.name) },
+            { "cat", (event.track == PROFILER_GPU_TRACK) ? "gpu" : "cpu" },
+            { "ph", "X" },
+            { "ts", event.start / NANOSECONDS_PER_MICROSECOND },
+            { "dur", event.duration / NANOSECONDS_PER_MICROSECOND },
+            { "pid", 1 },
+            { "tid", static_cast<int>(event.track) },
+            { "args", QJsonObject{ { "frame", static_cast<qint64>(event.frame) } } }
+        });
+    }
+
+    const QJsonObject trace{ { "traceEvents", traceEvents }, { "displayTimeUnit", "ms" } };
+
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "Could not create trace file" << path;
+        return false;
+    }
+
+    file.write(QJsonDocument(trace).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+/**
+ * \brief Constructor for a CPU scope, starts timing
+ */
+ProfileScope::ProfileScope(const char* name) :
+    m_name{name},
+    m_track{Profiler::instance().currentTrack()},
+    m_start{Profiler::instance().now()}
+{
+
+}
+
+/**
+ * \brief Destructor for a CPU scope, records the span
+ */
+ProfileScope::~ProfileScope()
+{
+    auto& profiler = Profiler::instance();
+    profiler.record(m_name, m_start, profiler.now(), m_track, profiler.frameNumber());
+}
+
+/**
+ * \brief Constructor for the GPU profiler. Purely used for assignment, create() needs a current context.
+ */
+GpuProfiler::GpuProfiler() :
+    m_clockQuery{nullptr},
+    m_frames(), // value initialized, so every frame starts with no spans
+    m_currentFrame{0},
+    m_openSpans(),
+    m_gpuToCpuOffset{0},
+    m_numberOfDroppedFrames{0}
+{
+
+}
+
+/**
+ * \brief Destructor for the GPU profiler. destroy() must already have been called with the context current.
+ */
+GpuProfiler::~GpuProfiler() = default;
+
+/**
+ * \brief Creates the query used to read the GPU clock. Returns false, leaving every scope a no-op, if the
+ *        context has no timer queries.
+ */
+bool GpuProfiler::create()
+{
+    m_clockQuery = std::make_unique<QOpenGLTimerQuery>();
+    if(!m_clockQuery->create())
+    {
+        qDebug() << "Timer queries are not supported, GPU work will not be profiled";
+        m_clockQuery.reset();
+        return false;
+    }
+
+    calibrate();
+    return true;
+}
+
+/**
+ * \brief Deletes every query. Spans that haven't been read back yet are lost.
+ */
+void GpuProfiler::destroy()
+{
+    for(auto& frame : m_frames)
+    {
+        frame.spans.clear();
+        frame.numberOfSpans = 0U;
+    }
+
+    m_openSpans.clear();
+    m_clockQuery.reset();
+}
+
+/**
+ * \brief Moves on to the next set of queries, first reading back the spans they timed FRAMES_IN_FLIGHT frames ago.
+ */
+void GpuProfiler::beginFrame()
+{
+    if(m_clockQuery == nullptr)
+    {
+        return;
+    }
+
+    m_currentFrame = (m_currentFrame + 1U) % FRAMES_IN_FLIGHT;
+    collect(m_frames[m_currentFrame]);
+
+    if(Profiler::instance().frameNumber() % CALIBRATION_INTERVAL == 0U)
+    {
+        calibrate();
+    }
+}
+
+/**
+ * \brief Records a timestamp before the GPU work that follows. Scopes may nest.
+ */
+void GpuProfiler::beginScope(const char* name)
+{
+    if(m_clockQuery == nullptr)
+    {
+        return;
+    }
+
+    auto& frame = m_frames[m_currentFrame];
+    if(frame.numberOfSpans == frame.spans.size())
+    {
+        Span span{ name, 0U, std::make_unique<QOpenGLTimerQuery>(), std::make_unique<QOpenGLTimerQuery>() };
+        span.start->create();
+        span.end->create();
+        frame.spans.push_back(std::move(span));
+    }
+
+    auto& span = frame.spans[frame.numberOfSpans];
+    span.name = name;
+    span.frame = Profiler::instance().frameNumber();
+    span.start->recordTimestamp();
+
+    m_openSpans.push_back(frame.numberOfSpans++);
+}
+
+/**
+ * \brief Records a timestamp after the GPU work queued since the matching beginScope()
+ */
+void GpuProfiler::endScope()
+{
+    if(m_clockQuery == nullptr || m_openSpans.empty())
+    {
+        return;
+    }
+
+    m_frames[m_currentFrame].spans[m_openSpans.back()].end->recordTimestamp();
+    m_openSpans.pop_back();
+}
+
+/**
+ * \brief True once the GPU has written every timestamp of the frame. Nested scopes end in the reverse order they
+ *        began, so no single query is known to be the last one written and each is asked in turn.
+ */
+bool GpuProfiler::resultsAvailable(const Frame& frame)
+{
+    for(auto i = size_t{0}; i < frame.numberOfSpans; ++i)
+    {
+        const auto& span = frame.spans[i];
+        if(!span.start->isResultAvailable() || !span.end->isResultAvailable())
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * \brief Hands the spans of a frame to the profiler. If any of its timestamps isn't ready the frame is dropped
+ *        rather than waited on.
+ */
+void GpuProfiler::collect(Frame& frame)
+{
+    if(frame.numberOfSpans == 0U)
+    {
+        return;
+    }
+
+    if(!resultsAvailable(frame))
+    {
+        if(++m_numberOfDroppedFrames == 1U)
+        {
+            qDebug() << "GPU timings were not ready after" << FRAMES_IN_FLIGHT << "frames and have been dropped";
+        }
+    }
+    else
+    {
+        // QOpenGLTimerQuery has no accessor that never waits, but with every result available waitForResult()
+        // returns straight away
+        auto& profiler = Profiler::instance();
+        for(auto i = size_t{0}; i < frame.numberOfSpans; ++i)
+        {
+            const auto& span = frame.spans[i];
+            const auto start = static_cast<int64_t>(span.start->waitForResult()) + m_gpuToCpuOffset;
+            const auto end = static_cast<int64_t>(span.end->waitForResult()) + m_gpuToCpuOffset;
+
+            profiler.record(span.name, static_cast<uint64_t>(qMax<int64_t>(start, 0)),
+                            static_cast<uint64_t>(qMax<int64_t>(end, 0)), PROFILER_GPU_TRACK, span.frame);
+        }
+    }
+
+    frame.numberOfSpans = 0U;
+}
+
+/**
+ * \brief Measures the offset that puts GPU timestamps on the profiler's clock. Reading the GPU clock waits for
+ *        the driver rather than the GPU, so the offset is off by no more than that round trip.
+ */
+void GpuProfiler::calibrate()
+{
+    auto& profiler = Profiler::instance();
+
+    const auto before = profiler.now();
+    const auto gpuTime = m_clockQuery->waitForTimestamp();
+    const auto after = profiler.now();
+
+    m_gpuToCpuOffset = static_cast<int64_t>((before + after) / 2U) - static_cast<int64_t>(gpuTime);
+}
+
+/**
+ * \brief Constructor for a GPU scope, records the starting timestamp
+ */
+GpuProfileScope::GpuProfileScope(GpuProfiler& profiler, const char* name) :
+    m_profiler(profiler)
+{
+    m_profiler.beginScope(name);
+}
+
+/**
+ * \brief Destructor for a GPU scope, records the ending timestamp
+ */
+GpuProfileScope::~GpuProfileScope()
+{
+    m_profiler.endScope();
+}
@@ -0,0 +1,161 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <QElapsedTimer>
+#include <QString>
+
+class QOpenGLTimerQuery;
+
+// Track of the events timed on the GPU, every CPU thread gets a track of its own after it
+constexpr auto PROFILER_GPU_TRACK = 0U;
+
+/**
+ * \brief One timed span of CPU or GPU work. Names are string literals, only the pointer is kept.
+ */
+struct ProfileEvent
+{
+    const char* name;
+    uint64_t start;    // nanoseconds since the profiler was created
+    uint64_t duration; // nanoseconds
+    uint64_t frame;
+    uint32_t track;
+};
+
+/**
+ * \brief Time spent in one named span per frame it ran in, over the frames given to Profiler::summary()
+ */
+struct ProfileSummary
+{
+    const char* name;
+    bool gpu;
+    double averageMilliseconds;
+    double maximumMilliseconds;
+};
+
+/**
+ * \brief Keeps the most recent timed spans from every thread and the GPU in a fixed-size ring buffer, which can
+ *        be summarised for display or written out as Chrome trace events.
+ */
+class Profiler
+{
+public:
+    explicit Profiler(uint32_t capacity);
+
+    Profiler(const Profiler&) = delete;
+    Profiler& operator=(const Profiler&) = delete;
+
+    static Profiler& instance();
+
+    void beginFrame();
+    uint64_t frameNumber() const;
+    uint64_t now() const;
+
+    uint32_t currentTrack();
+    void nameCurrentTrack(const char* name);
+
+    void record(const char* name, uint64_t start, uint64_t end, uint32_t track, uint64_t frame);
+
+    std::vector<ProfileEvent> events() const;
+
+    std::vector<ProfileSummary> summary(uint32_t numberOfFrames) const;
+    bool writeChromeTrace(const QString& path) const;
+
+private:
+    mutable std::mutex m_mutex;
+    std::vector<ProfileEvent> m_events;
+    size_t m_nextEvent;
+    size_t m_numberOfEvents;
+    std::vector<const char*> m_trackNames;
+
+    std::atomic<uint64_t> m_frameNumber;
+    std::atomic<uint32_t> m_numberOfTracks;
+    QElapsedTimer m_clock;
+};
+
+/**
+ * \brief Times the CPU work from its construction to the end of the enclosing scope
+ */
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* m_name;
+    uint32_t m_track;
+    uint64_t m_start;
+};
+
+/**
+ * \brief Times GPU work with timestamp queries. Results are read back a few frames after they were recorded,
+ *        once the GPU has certainly passed them, so profiling never waits on the GPU.
+ */
+class GpuProfiler
+{
+public:
+    GpuProfiler();
+    ~GpuProfiler();
+
+    bool create();
+    void destroy();
+
+    void beginFrame();
+    void beginScope(const char* name);
+    void endScope();
+
+private:
+    static constexpr auto FRAMES_IN_FLIGHT = 4U;
+
+    struct Span
+    {
+        const char* name;
+        uint64_t frame;
+        std::unique_ptr<QOpenGLTimerQuery> start;
+        std::unique_ptr<QOpenGLTimerQuery> end;
+    };
+
+    struct Frame
+    {
+        std::vector<Span> spans;
+        size_t numberOfSpans;
+    };
+
+    static bool resultsAvailable(const Frame& frame);
+    void collect(Frame& frame);
+    void calibrate();
+
+    std::unique_ptr<QOpenGLTimerQuery> m_clockQuery;
+    std::array<Frame, FRAMES_IN_FLIGHT> m_frames;
+    uint32_t m_currentFrame;
+    std::vector<size_t> m_openSpans;
+    int64_t m_gpuToCpuOffset;
+    uint64_t m_numberOfDroppedFrames;
+};
+
+/**
+ * \brief Times the GPU work queued from its construction to the end of the enclosing scope
+ */
+class GpuProfileScope
+{
+public:
+    GpuProfileScope(GpuProfiler& profiler, const char* name);
+    ~GpuProfileScope();
+
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    GpuProfiler& m_profiler;
+};
+
+#endif // PROFILER_H
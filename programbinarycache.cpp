@@ -0,0 +1,170 @@
+#include "programbinarycache.h"
+
+#include <cstring>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QSaveFile>
+#include <QStandardPaths>
+
+namespace
+{
+    constexpr uint32_t PROGRAM_BINARY_CACHE_MAGIC = 0x42504751U; // "QGPB" in a little-endian file
+    constexpr uint32_t PROGRAM_BINARY_CACHE_FILE_VERSION = 1U;
+}
+
+/**
+ * \brief Driver strings the binary was produced by. Anything that changes them is assumed to change the binary.
+ */
+static QByteArray gl_string(const GLenum name)
+{
+    const auto* value = QOpenGLContext::currentContext()->functions()->glGetString(name);
+    return (value != nullptr) ? QByteArray(reinterpret_cast<const char*>(value)) : QByteArray();
+}
+
+/**
+ * \brief Works out the cache file for the given sources and the current context's driver. The context must be
+ *        current.
+ */
+ProgramBinaryCache::ProgramBinaryCache(const QByteArray& vertexSource, const QByteArray& fragmentSource) :
+    m_path{}
+{
+    // Make sure that a context has been created prior to calling this function
+    Q_ASSERT(QOpenGLContext::currentContext() != nullptr);
+
+    const auto directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if(directory.isEmpty())
+    {
+        return;
+    }
+
+    // Lengths go in ahead of each part so that moving text between them can't give the same hash
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(PROGRAM_BINARY_CACHE_FILE_VERSION));
+    for(const auto& part : { vertexSource, fragmentSource, gl_string(GL_VENDOR), gl_string(GL_RENDERER),
+                             gl_string(GL_VERSION) })
+    {
+        hash.addData(QByteArray::number(part.size()) + ':');
+        hash.addData(part);
+    }
+
+    m_path = QStringLiteral("%1/program-%2.bin").arg(directory, QString::fromLatin1(hash.result().toHex()));
+}
+
+/**
+ * \brief True if the driver can hand out program binaries at all. Some report no formats, in which case every
+ *        program is compiled from source.
+ */
+bool ProgramBinaryCache::isSupported()
+{
+    GLint numberOfFormats = 0;
+    QOpenGLContext::currentContext()->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &numberOfFormats);
+
+    return numberOfFormats > 0;
+}
+
+/**
+ * \brief Gives the cached binary to the program. Returns true only if the driver accepted it and the program is
+ *        linked. A rejected binary leaves the program unlinked, so the caller should start over with a new one.
+ */
+bool ProgramBinaryCache::load(const GLuint program) const
+{
+    if(m_path.isEmpty() || !QFile::exists(m_path))
+    {
+        return false;
+    }
+
+    QFile file(m_path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Could not open shader program cache" << m_path;
+        return false;
+    }
+
+    const auto contents = file.readAll();
+
+    Header header{};
+    if(static_cast<size_t>(contents.size()) < sizeof(Header))
+    {
+        qDebug() << "Shader program cache is truncated" << m_path;
+        return false;
+    }
+    std::memcpy(&header, contents.constData(), sizeof(Header));
+
+    if(header.magic != PROGRAM_BINARY_CACHE_MAGIC || header.fileVersion != PROGRAM_BINARY_CACHE_FILE_VERSION ||
+       static_cast<size_t>(contents.size()) != sizeof(Header) + header.binaryLength)
+    {
+        qDebug() << "Shader program cache is stale" << m_path;
+        return false;
+    }
+
+    auto* functions = QOpenGLContext::currentContext()->extraFunctions();
+    functions->glProgramBinary(program, header.binaryFormat, contents.constData() + sizeof(Header),
+                               static_cast<GLsizei>(header.binaryLength));
+
+    GLint linked = GL_FALSE;
+    functions->glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if(linked != GL_TRUE)
+    {
+        qDebug() << "Shader program cache rejected by the driver" << m_path;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * \brief Saves the binary of a linked program, which must have been linked with
+ *        GL_PROGRAM_BINARY_RETRIEVABLE_HINT set. The file is only replaced once it is completely written.
+ */
+bool ProgramBinaryCache::store(const GLuint program) const
+{
+    if(m_path.isEmpty() || !QDir().mkpath(QFileInfo(m_path).absolutePath()))
+    {
+        qDebug() << "No writable shader program cache directory";
+        return false;
+    }
+
+    auto* functions = QOpenGLContext::currentContext()->extraFunctions();
+
+    GLint binaryLength = 0;
+    functions->glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if(binaryLength <= 0)
+    {
+        qDebug() << "The driver returned no binary for the shader program";
+        return false;
+    }
+
+    QByteArray binary(binaryLength, Qt::Uninitialized);
+    GLsizei writtenLength = 0;
+    GLenum binaryFormat = GL_NONE;
+    functions->glGetProgramBinary(program, binaryLength, &writtenLength, &binaryFormat, binary.data());
+
+    const Header header{ PROGRAM_BINARY_CACHE_MAGIC, PROGRAM_BINARY_CACHE_FILE_VERSION, binaryFormat,
+                         static_cast<uint32_t>(writtenLength) };
+
+    QSaveFile file(m_path);
+    const auto stored = writtenLength > 0 && file.open(QIODevice::WriteOnly) &&
+                        file.write(reinterpret_cast<const char*>(&header), sizeof(Header)) == sizeof(Header) &&
+                        file.write(binary.constData(), writtenLength) == writtenLength &&
+                        file.commit();
+
+    if(!stored)
+    {
+        qDebug() << "Could not write shader program cache" << m_path;
+    }
+
+    return stored;
+}
+
+/**
+ * \brief Accessor for the path of the cached program binary
+ */
+const QString& ProgramBinaryCache::path() const
+{
+    return m_path;
+}
@@ -0,0 +1,40 @@
+#ifndef PROGRAMBINARYCACHE_H
+#define PROGRAMBINARYCACHE_H
+
+#include <cstdint>
+#include <QByteArray>
+#include <QOpenGLFunctions>
+#include <QString>
+
+/**
+ * \brief On-disk copy of a linked program as the driver returns it from glGetProgramBinary(). Each file is keyed
+ *        by a hash of the shader sources and the GL vendor, renderer and version strings, so editing a shader or
+ *        updating the driver picks a new file instead of loading a binary that no longer applies. The driver has
+ *        the final say: a binary it rejects is reported as a miss and the program is compiled from source.
+ */
+class ProgramBinaryCache
+{
+public:
+    ProgramBinaryCache(const QByteArray& vertexSource, const QByteArray& fragmentSource);
+
+    static bool isSupported();
+
+    bool load(GLuint program) const;
+    bool store(GLuint program) const;
+
+    const QString& path() const;
+
+private:
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t fileVersion;
+        uint32_t binaryFormat;
+        uint32_t binaryLength;
+    };
+
+private:
+    QString m_path;
+};
+
+#endif // PROGRAMBINARYCACHE_H
@@ -0,0 +1,347 @@
+#include "renderqueue.h"
+
+#include <algorithm>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLFunctions_4_1_Core>
+
+/**
+ * \brief Layer, program, first texture and vertex array from the most to the least significant bits. GL names
+ *        are handed out as small increasing integers, so their low bits are enough to bring equal state together.
+ */
+static uint64_t draw_sort_key(const DrawCommand& command)
+{
+    const auto program = (command.program != nullptr) ? command.program->programId() : 0U;
+
+    return (static_cast<uint64_t>(command.layer) << 56U) |
+           (static_cast<uint64_t>(program & 0xFFFFU) << 40U) |
+           (static_cast<uint64_t>(command.textures[0].texture & 0xFFFFU) << 24U) |
+           static_cast<uint64_t>(command.vertexArray & 0xFFFFFFU);
+}
+
+/**
+ * \brief Total number of GL calls made to change state
+ */
+uint32_t RenderStatistics::stateChanges() const
+{
+    return programChanges + textureChanges + vertexArrayChanges + elementBufferChanges + capabilityChanges;
+}
+
+/**
+ * \brief Standard constructor for the RenderStateCache, initialize() must be called with a current context
+ *        before the first frame
+ */
+RenderStateCache::RenderStateCache() :
+    m_functions{nullptr},
+    m_coreFunctions{nullptr},
+    m_program{nullptr},
+    m_textureUnits{},
+    m_activeTextureUnit{UNKNOWN_BINDING},
+    m_vertexArray{UNKNOWN_BINDING},
+    m_elementBuffers{},
+    m_primitiveRestart{UNKNOWN_BINDING},
+    m_primitiveRestartIndex{0},
+    m_statistics{}
+{
+
+}
+
+/**
+ * \brief Fetches the functions of the current context. Draws with a base vertex or primitive restart need the 4.1
+ *        core functions and are skipped without them.
+ */
+void RenderStateCache::initialize(QOpenGLFunctions_4_1_Core* coreFunctions)
+{
+    // Make sure that a context has been created prior to calling this function
+    Q_ASSERT(QOpenGLContext::currentContext() != nullptr);
+
+    m_functions = QOpenGLContext::currentContext()->extraFunctions();
+    m_coreFunctions = coreFunctions;
+    m_elementBuffers.clear();
+}
+
+/**
+ * \brief Starts a frame with the statistics cleared and every binding unknown
+ */
+void RenderStateCache::begin()
+{
+    m_program = nullptr;
+    m_textureUnits.fill({ GL_NONE, UNKNOWN_BINDING });
+    m_activeTextureUnit = UNKNOWN_BINDING;
+    m_vertexArray = UNKNOWN_BINDING;
+    m_primitiveRestart = UNKNOWN_BINDING;
+
+    m_statistics = RenderStatistics{};
+}
+
+/**
+ * \brief Sets whatever state the command needs that isn't already set, then draws it
+ */
+void RenderStateCache::draw(const DrawCommand& command)
+{
+    Q_ASSERT(m_functions != nullptr);
+    Q_ASSERT(command.program != nullptr);
+
+    const auto needsCoreFunctions = command.baseVertex != 0 || command.primitiveRestart;
+    if(needsCoreFunctions && m_coreFunctions == nullptr)
+    {
+        return;
+    }
+
+    useProgram(command.program);
+
+    for(const auto& texture : command.textures)
+    {
+        if(texture.texture != 0U)
+        {
+            bindTexture(texture);
+        }
+    }
+
+    bindVertexArray(command.vertexArray);
+    if(command.indexType != GL_NONE)
+    {
+        bindElementBuffer(command.elementBuffer);
+    }
+    setPrimitiveRestart(command.primitiveRestart, command.primitiveRestartIndex);
+
+    // The program skips values it already holds
+    command.program->setUniformValue(command.uniform, command.uniformValue);
+
+    if(command.indexType == GL_NONE)
+    {
+        Q_ASSERT(command.baseVertex == 0);
+        if(command.instanceCount > 0)
+        {
+            m_functions->glDrawArraysInstanced(command.mode, 0, command.count, command.instanceCount);
+        }
+        else
+        {
+            m_functions->glDrawArrays(command.mode, 0, command.count);
+        }
+    }
+    else if(command.instanceCount > 0)
+    {
+        Q_ASSERT(command.baseVertex == 0);
+        m_functions->glDrawElementsInstanced(command.mode, command.count, command.indexType, nullptr,
+                                             command.instanceCount);
+    }
+    else if(needsCoreFunctions)
+    {
+        m_coreFunctions->glDrawElementsBaseVertex(command.mode, command.count, command.indexType, nullptr,
+                                                  command.baseVertex);
+    }
+    else
+    {
+        m_functions->glDrawElements(command.mode, command.count, command.indexType, nullptr);
+    }
+
+    ++m_statistics.numberOfDraws;
+}
+
+/**
+ * \brief Unbinds the program, textures and vertex array and turns primitive restart back off, leaving the defaults
+ *        that Qt and QPainter expect
+ */
+void RenderStateCache::end()
+{
+    if(m_program != nullptr)
+    {
+        m_program->release();
+        m_program = nullptr;
+        ++m_statistics.programChanges;
+    }
+
+    for(auto unit = 0U; unit < MAXIMUM_TEXTURE_UNITS; ++unit)
+    {
+        const auto& binding = m_textureUnits[unit];
+        if(binding.texture != 0U && binding.texture != UNKNOWN_BINDING)
+        {
+            bindTexture({ binding.target, 0U, unit });
+        }
+    }
+
+    if(m_activeTextureUnit != 0U && m_activeTextureUnit != UNKNOWN_BINDING)
+    {
+        m_functions->glActiveTexture(GL_TEXTURE0);
+        ++m_statistics.textureChanges;
+    }
+    m_activeTextureUnit = 0U;
+
+    if(m_vertexArray != 0U && m_vertexArray != UNKNOWN_BINDING)
+    {
+        bindVertexArray(0U);
+    }
+
+    if(m_primitiveRestart == GL_TRUE)
+    {
+        setPrimitiveRestart(false, m_primitiveRestartIndex);
+    }
+}
+
+/**
+ * \brief Drops what is known of a vertex array that is about to be deleted, since its name can be reused
+ */
+void RenderStateCache::forgetVertexArray(const GLuint vertexArray)
+{
+    m_elementBuffers.erase(vertexArray);
+
+    if(m_vertexArray == vertexArray)
+    {
+        m_vertexArray = UNKNOWN_BINDING;
+    }
+}
+
+/**
+ * \brief Accessor for the statistics of the frame since the last begin()
+ */
+const RenderStatistics& RenderStateCache::statistics() const
+{
+    return m_statistics;
+}
+
+void RenderStateCache::useProgram(ShaderProgram* program)
+{
+    if(program == m_program)
+    {
+        ++m_statistics.skippedChanges;
+        return;
+    }
+
+    // Also sends the uniforms that were set while the program wasn't bound
+    program->bind();
+    m_program = program;
+    ++m_statistics.programChanges;
+}
+
+void RenderStateCache::bindTexture(const TextureBinding& binding)
+{
+    Q_ASSERT(binding.unit < MAXIMUM_TEXTURE_UNITS);
+
+    auto& unit = m_textureUnits[binding.unit];
+    if(unit.texture == binding.texture && unit.target == binding.target)
+    {
+        ++m_statistics.skippedChanges;
+        return;
+    }
+
+    if(m_activeTextureUnit != binding.unit)
+    {
+        m_functions->glActiveTexture(GL_TEXTURE0 + binding.unit);
+        m_activeTextureUnit = binding.unit;
+        ++m_statistics.textureChanges;
+    }
+
+    m_functions->glBindTexture(binding.target, binding.texture);
+    unit = { binding.target, binding.texture };
+    ++m_statistics.textureChanges;
+}
+
+void RenderStateCache::bindVertexArray(const GLuint vertexArray)
+{
+    if(vertexArray == m_vertexArray)
+    {
+        ++m_statistics.skippedChanges;
+        return;
+    }
+
+    m_functions->glBindVertexArray(vertexArray);
+    m_vertexArray = vertexArray;
+    ++m_statistics.vertexArrayChanges;
+}
+
+void RenderStateCache::bindElementBuffer(const GLuint elementBuffer)
+{
+    Q_ASSERT(m_vertexArray != UNKNOWN_BINDING);
+
+    const auto known = m_elementBuffers.find(m_vertexArray);
+    if(known != m_elementBuffers.end() && known->second == elementBuffer)
+    {
+        ++m_statistics.skippedChanges;
+        return;
+    }
+
+    m_functions->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementBuffer);
+    m_elementBuffers[m_vertexArray] = elementBuffer;
+    ++m_statistics.elementBufferChanges;
+}
+
+void RenderStateCache::setPrimitiveRestart(const bool enabled, const GLuint restartIndex)
+{
+    const auto state = enabled ? static_cast<GLuint>(GL_TRUE) : static_cast<GLuint>(GL_FALSE);
+    if(state != m_primitiveRestart)
+    {
+        if(enabled)
+        {
+            m_functions->glEnable(GL_PRIMITIVE_RESTART);
+        }
+        else
+        {
+            m_functions->glDisable(GL_PRIMITIVE_RESTART);
+        }
+
+        m_primitiveRestart = state;
+        ++m_statistics.capabilityChanges;
+    }
+    else
+    {
+        ++m_statistics.skippedChanges;
+    }
+
+    if(enabled && restartIndex != m_primitiveRestartIndex)
+    {
+        m_coreFunctions->glPrimitiveRestartIndex(restartIndex);
+        m_primitiveRestartIndex = restartIndex;
+        ++m_statistics.capabilityChanges;
+    }
+}
+
+/**
+ * \brief Standard constructor for the RenderQueue
+ */
+RenderQueue::RenderQueue() :
+    m_commands{},
+    m_order{}
+{
+
+}
+
+/**
+ * \brief Empties the queue for a new frame, keeping its storage
+ */
+void RenderQueue::clear()
+{
+    m_commands.clear();
+    m_order.clear();
+}
+
+void RenderQueue::record(const DrawCommand& command)
+{
+    m_order.emplace_back(draw_sort_key(command), static_cast<uint32_t>(m_commands.size()));
+    m_commands.push_back(command);
+}
+
+void RenderQueue::sort()
+{
+    std::sort(m_order.begin(), m_order.end());
+}
+
+/**
+ * \brief Draws every command in sorted order through the cache, as one frame
+ */
+void RenderQueue::submit(RenderStateCache& cache) const
+{
+    cache.begin();
+
+    for(const auto& entry : m_order)
+    {
+        cache.draw(m_commands[entry.second]);
+    }
+
+    cache.end();
+}
+
+size_t RenderQueue::size() const
+{
+    return m_commands.size();
+}
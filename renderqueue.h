@@ -0,0 +1,153 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <QOpenGLFunctions>
+
+#include "shaderprogram.h"
+
+class QOpenGLExtraFunctions;
+class QOpenGLFunctions_4_1_Core;
+
+// Texture units a single draw can read from
+constexpr auto MAXIMUM_DRAW_TEXTURES = 2U;
+
+/**
+ * \brief A texture bound to a texture unit. A texture of 0 leaves the unit alone.
+ */
+struct TextureBinding
+{
+    GLenum target;
+    GLuint texture;
+    GLuint unit;
+};
+
+/**
+ * \brief Everything one draw needs bound and set. Commands are value initialized and then filled in, so anything
+ *        left out is off or unused. An index type of GL_NONE draws count vertices in order, without an element buffer.
+ */
+struct DrawCommand
+{
+    uint8_t layer; // lower layers are drawn first whatever their state, for overlays drawn over the planet
+
+    ShaderProgram* program;
+    std::array<TextureBinding, MAXIMUM_DRAW_TEXTURES> textures;
+    GLuint vertexArray;
+    GLuint elementBuffer; // stays bound into the vertex array after the draw
+
+    // One integer uniform that can differ between draws of the same program, such as the vertex format
+    UniformHandle<GLint> uniform;
+    GLint uniformValue;
+
+    GLenum mode;
+    GLsizei count;
+    GLenum indexType; // GL_NONE for a draw without indices
+    GLint baseVertex;
+    GLsizei instanceCount; // 0 for a draw that isn't instanced
+
+    bool primitiveRestart;
+    GLuint primitiveRestartIndex;
+};
+
+/**
+ * \brief What it took to submit one frame of draws. Changes are the GL calls made, skipped are the ones the state
+ *        already matched.
+ */
+struct RenderStatistics
+{
+    uint32_t numberOfDraws;
+    uint32_t programChanges;
+    uint32_t textureChanges;
+    uint32_t vertexArrayChanges;
+    uint32_t elementBufferChanges;
+    uint32_t capabilityChanges;
+    uint32_t skippedChanges;
+
+    uint32_t stateChanges() const;
+};
+
+/**
+ * \brief Remembers the program, textures, vertex array and primitive restart state it last set, and only calls
+ *        GL for what a draw changes. Everything else that touches GL state between frames is unknown to it, so
+ *        each frame starts from begin(), which forgets all but the element buffers inside vertex arrays, and ends
+ *        with end(), which unbinds what it bound.
+ */
+class RenderStateCache
+{
+public:
+    RenderStateCache();
+
+    void initialize(QOpenGLFunctions_4_1_Core* coreFunctions);
+
+    void begin();
+    void draw(const DrawCommand& command);
+    void end();
+
+    void forgetVertexArray(GLuint vertexArray);
+
+    const RenderStatistics& statistics() const;
+
+private:
+    static constexpr auto MAXIMUM_TEXTURE_UNITS = 8U;
+
+    // A binding that may be anything, the first request for it always reaches GL
+    static constexpr GLuint UNKNOWN_BINDING = ~0U;
+
+    struct UnitBinding
+    {
+        GLenum target;
+        GLuint texture;
+    };
+
+    void useProgram(ShaderProgram* program);
+    void bindTexture(const TextureBinding& binding);
+    void bindVertexArray(GLuint vertexArray);
+    void bindElementBuffer(GLuint elementBuffer);
+    void setPrimitiveRestart(bool enabled, GLuint restartIndex);
+
+private:
+    QOpenGLExtraFunctions* m_functions;
+    QOpenGLFunctions_4_1_Core* m_coreFunctions;
+
+    ShaderProgram* m_program; // nullptr until the frame's first draw binds one
+    std::array<UnitBinding, MAXIMUM_TEXTURE_UNITS> m_textureUnits;
+    GLuint m_activeTextureUnit;
+    GLuint m_vertexArray;
+
+    // The element buffer binding lives in the vertex array, so it is remembered per vertex array across frames
+    std::unordered_map<GLuint, GLuint> m_elementBuffers;
+
+    GLuint m_primitiveRestart; // GL_TRUE, GL_FALSE or UNKNOWN_BINDING
+    GLuint m_primitiveRestartIndex;
+
+    RenderStatistics m_statistics;
+};
+
+/**
+ * \brief The draws of one frame. Commands are recorded in any order, then sorted by layer, program, texture and
+ *        vertex array so that draws sharing state run back to back, and submitted through a RenderStateCache.
+ */
+class RenderQueue
+{
+public:
+    RenderQueue();
+
+    void clear();
+    void record(const DrawCommand& command);
+    void sort();
+    void submit(RenderStateCache& cache) const;
+
+    size_t size() const;
+
+private:
+    std::vector<DrawCommand> m_commands;
+
+    // Sort key and index of each command, the index keeps equal keys in the order they were recorded
+    std::vector<std::pair<uint64_t, uint32_t>> m_order;
+};
+
+#endif // RENDERQUEUE_H
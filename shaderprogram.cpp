@@ -1,44 +1,191 @@
 #include "shaderprogram.h"
+#include "programbinarycache.h"
 
+#include <cstring>
+#include <QFile>
 #include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+namespace
+{
+    // Program the context is using, binding another one through ShaderProgram::bind() implicitly unbinds it
+    const ShaderProgram* s_boundProgram = nullptr;
+}
+
+/**
+ * \brief Uniforms set from a GLint: integers, booleans and samplers, which are set to a texture unit
+ */
+static bool is_integer_uniform(const GLenum type)
+{
+    switch(type)
+    {
+        case GL_INT:
+        case GL_BOOL:
+        case GL_SAMPLER_2D:
+        case GL_SAMPLER_3D:
+        case GL_SAMPLER_CUBE:
+        case GL_SAMPLER_2D_ARRAY:
+        case GL_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_2D:
+        case GL_UNSIGNED_INT_SAMPLER_2D_ARRAY:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+static bool is_matrix_uniform(const GLenum type)
+{
+    return type == GL_FLOAT_MAT4;
+}
 
 /**
  * \brief Standard constructor for the ShaderProgram
  */
 ShaderProgram::ShaderProgram() :
     m_programCreatedSuccessfully{false},
-    m_program{nullptr}
+    m_program{nullptr},
+    m_uniforms{},
+    m_attributes{},
+    m_hasDirtyUniforms{false}
 {
 
 }
 
 /**
- * \brief Standard destructor for the ShaderProgram
+ * \brief Reads one shader's source, or returns an empty array if it can't be read
+ */
+static QByteArray read_shader_source(const QString& path)
+{
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Unable to read shader source" << path;
+        return QByteArray();
+    }
+
+    return file.readAll();
+}
+
+/**
+ * \brief Creates the program from the binary cache when it holds one the driver accepts, and otherwise compiles
+ *        and links it from source, storing the result for the next launch. Then reflects its active uniforms and
+ *        attributes.
  */
-void ShaderProgram::create(const QString& vertex_shader_path, const QString& fragment_shader_path)
+void ShaderProgram::create(const QString& vertex_shader_path,
+                           const QString& fragment_shader_path,
+                           const bool useBinaryCache)
 {
     // Make sure that a context has been created prior to calling this function
     Q_ASSERT(QOpenGLContext::currentContext() != nullptr);
 
+    // Anything learnt about a previous program no longer applies
+    m_uniforms.clear();
+    m_attributes.clear();
+    m_hasDirtyUniforms = false;
+    if(s_boundProgram == this)
+    {
+        s_boundProgram = nullptr;
+    }
+    m_programCreatedSuccessfully = false;
+
+    const auto vertexSource = read_shader_source(vertex_shader_path);
+    const auto fragmentSource = read_shader_source(fragment_shader_path);
+    if(vertexSource.isEmpty() || fragmentSource.isEmpty())
+    {
+        m_program.reset(nullptr);
+        return;
+    }
+
+    const auto cachingBinary = useBinaryCache && ProgramBinaryCache::isSupported();
+    if(cachingBinary)
+    {
+        const ProgramBinaryCache cache(vertexSource, fragmentSource);
+        if(createFromBinary(cache))
+        {
+            qDebug() << "Shader program cache hit" << cache.path();
+        }
+        else
+        {
+            qDebug() << "Shader program cache miss" << cache.path();
+            if(createFromSource(vertexSource, fragmentSource, true))
+            {
+                cache.store(m_program->programId());
+            }
+        }
+    }
+    else
+    {
+        createFromSource(vertexSource, fragmentSource, false);
+    }
+
+    if(m_program == nullptr)
+    {
+        return;
+    }
+
+    reflect();
+
+    m_programCreatedSuccessfully = true;
+}
+
+/**
+ * \brief Makes m_program from the cached binary. Returns false, with m_program reset, on any miss.
+ */
+bool ShaderProgram::createFromBinary(const ProgramBinaryCache& cache)
+{
+    m_program.reset(new QOpenGLShaderProgram(QOpenGLContext::currentContext()));
+
+    // Without shaders attached, link() only picks up the link status glProgramBinary() left behind
+    if(m_program->create() && cache.load(m_program->programId()) && m_program->link())
+    {
+        return true;
+    }
+
+    m_program.reset(nullptr);
+    return false;
+}
+
+/**
+ * \brief Compiles and links m_program from source. Returns false, with m_program reset, if either stage fails.
+ *        A retrievable program can have its binary read back for the cache afterwards.
+ */
+bool ShaderProgram::createFromSource(const QByteArray& vertexSource,
+                                     const QByteArray& fragmentSource,
+                                     const bool retrievable)
+{
     // Create a new program object
     m_program.reset(new QOpenGLShaderProgram(QOpenGLContext::currentContext()));
+    if(!m_program->create())
+    {
+        qDebug() << "Unable to create shader program";
+        m_program.reset(nullptr);
+        return false;
+    }
 
     // Compile the vertex shader
-    if(!m_program->addShaderFromSourceFile(QOpenGLShader::Vertex, vertex_shader_path))
+    if(!m_program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertexSource))
     {
         qDebug() << "Unable to compile vertex shader: " << m_program->log();
         m_program.reset(nullptr);
-        m_programCreatedSuccessfully = false;
-        return;
+        return false;
     }
 
     // Compile the fragment shader
-    if(!m_program->addShaderFromSourceFile(QOpenGLShader::Fragment, fragment_shader_path))
+    if(!m_program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragmentSource))
     {
         qDebug() << "Unable to compile fragment shader: " << m_program->log();
         m_program.reset(nullptr);
-        m_programCreatedSuccessfully = false;
-        return;
+        return false;
+    }
+
+    // The hint has to be given before linking for the driver to keep the binary around
+    if(retrievable)
+    {
+        QOpenGLContext::currentContext()->extraFunctions()->glProgramParameteri(m_program->programId(),
+                                                                                GL_PROGRAM_BINARY_RETRIEVABLE_HINT,
+                                                                                GL_TRUE);
     }
 
     // Link the shaders
@@ -46,11 +193,64 @@ void ShaderProgram::create(const QString& vertex_shader_path, const QString& fra
     {
         qDebug() << "Unable to link shader program: " << m_program->log();
         m_program.reset(nullptr);
-        m_programCreatedSuccessfully = false;
-        return;
+        return false;
     }
 
-    m_programCreatedSuccessfully = true;
+    return true;
+}
+
+/**
+ * \brief Asks the driver for every active uniform and attribute of the linked program, so that nothing has to be
+ *        looked up by name once drawing starts
+ */
+void ShaderProgram::reflect()
+{
+    auto* functions = QOpenGLContext::currentContext()->extraFunctions();
+    const auto program = m_program->programId();
+
+    GLint numberOfUniforms = 0;
+    GLint longestUniformName = 0;
+    functions->glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &numberOfUniforms);
+    functions->glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &longestUniformName);
+
+    std::vector<char> name(static_cast<size_t>(qMax(longestUniformName, 1)));
+    for(auto i = 0; i < numberOfUniforms; ++i)
+    {
+        GLsizei length = 0;
+        ShaderVariable variable{ QByteArray(), GL_NONE, 0, -1 };
+
+        functions->glGetActiveUniform(program, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length,
+                                      &variable.size, &variable.type, name.data());
+        variable.name = QByteArray(name.data(), length);
+        variable.location = functions->glGetUniformLocation(program, name.data());
+
+        // Members of uniform blocks have no location, they're filled through the block's buffer instead
+        if(variable.location < 0)
+        {
+            continue;
+        }
+
+        m_uniforms.push_back({ variable, {}, false, false });
+    }
+
+    GLint numberOfAttributes = 0;
+    GLint longestAttributeName = 0;
+    functions->glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &numberOfAttributes);
+    functions->glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &longestAttributeName);
+
+    name.resize(static_cast<size_t>(qMax(longestAttributeName, 1)));
+    for(auto i = 0; i < numberOfAttributes; ++i)
+    {
+        GLsizei length = 0;
+        ShaderVariable variable{ QByteArray(), GL_NONE, 0, -1 };
+
+        functions->glGetActiveAttrib(program, static_cast<GLuint>(i), static_cast<GLsizei>(name.size()), &length,
+                                     &variable.size, &variable.type, name.data());
+        variable.name = QByteArray(name.data(), length);
+        variable.location = functions->glGetAttribLocation(program, name.data());
+
+        m_attributes.push_back(variable);
+    }
 }
 
 /**
@@ -71,25 +271,166 @@ void ShaderProgram::setAttribute(const int location,
 }
 
 /**
- * \brief Wrapper around the setUniformValue() function call for 4x4 matrices
+ * \brief Index of the active uniform with the given name into m_uniforms, or -1 if the program has no such
+ *        uniform or it can't be set from the type the caller asked for
  */
-void ShaderProgram::setUniformMatrix(const QString& name, const QMatrix4x4& matrix)
+int32_t ShaderProgram::findUniform(const char* name, bool (*acceptsType)(GLenum type)) const
 {
-    // Make sure a program exists before calling this function
-    Q_ASSERT(m_program != nullptr);
+    for(auto i = 0U; i < m_uniforms.size(); ++i)
+    {
+        const auto& variable = m_uniforms[i].variable;
+        if(variable.name != name)
+        {
+            continue;
+        }
+
+        if(!acceptsType(variable.type))
+        {
+            qDebug() << "Uniform" << name << "can't be set from the requested type, its GL type is" << variable.type;
+            return -1;
+        }
+
+        return static_cast<int32_t>(i);
+    }
+
+    qDebug() << "Shader program has no active uniform named" << name;
+    return -1;
+}
+
+/**
+ * \brief Handle to an integer or sampler uniform, to be looked up once and kept
+ */
+template<>
+UniformHandle<GLint> ShaderProgram::uniform<GLint>(const char* name) const
+{
+    return UniformHandle<GLint>(findUniform(name, is_integer_uniform));
+}
 
-    m_program->setUniformValue(name.toStdString().c_str(), matrix);
+/**
+ * \brief Handle to a 4x4 matrix uniform, to be looked up once and kept
+ */
+template<>
+UniformHandle<QMatrix4x4> ShaderProgram::uniform<QMatrix4x4>(const char* name) const
+{
+    return UniformHandle<QMatrix4x4>(findUniform(name, is_matrix_uniform));
+}
+
+/**
+ * \brief Sets an integer or sampler uniform, skipped if the program already holds the value
+ */
+void ShaderProgram::setUniformValue(const UniformHandle<GLint> uniform, const GLint value)
+{
+    setUniformData(uniform.m_index, &value, sizeof(value));
+}
+
+/**
+ * \brief Sets a 4x4 matrix uniform, skipped if the program already holds the value
+ */
+void ShaderProgram::setUniformValue(const UniformHandle<QMatrix4x4> uniform, const QMatrix4x4& value)
+{
+    setUniformData(uniform.m_index, value.constData(), 16U * sizeof(float));
+}
+
+/**
+ * \brief Remembers the value of a uniform and sends it to the GPU only if it differs from what the program
+ *        already holds. Values set while the program isn't bound are sent the next time it is.
+ */
+void ShaderProgram::setUniformData(const int32_t index, const void* data, const size_t bytes)
+{
+    if(index < 0)
+    {
+        return;
+    }
+
+    Q_ASSERT(static_cast<size_t>(index) < m_uniforms.size());
+    Q_ASSERT(bytes <= MAXIMUM_UNIFORM_BYTES);
+
+    auto& uniform = m_uniforms[static_cast<size_t>(index)];
+    if(uniform.hasValue && std::memcmp(uniform.value.data(), data, bytes) == 0)
+    {
+        return;
+    }
+
+    std::memcpy(uniform.value.data(), data, bytes);
+    uniform.hasValue = true;
+
+    if(s_boundProgram == this)
+    {
+        uploadUniform(uniform);
+        uniform.dirty = false;
+    }
+    else
+    {
+        uniform.dirty = true;
+        m_hasDirtyUniforms = true;
+    }
 }
 
 /**
- * \brief Wrapper around teh setUniformValue() function call for integers
+ * \brief Sends a uniform's remembered value to the currently bound program
  */
-void ShaderProgram::setUniformValue(const QString &name, const GLint value)
+void ShaderProgram::uploadUniform(const Uniform& uniform) const
+{
+    auto* functions = QOpenGLContext::currentContext()->functions();
+
+    if(is_matrix_uniform(uniform.variable.type))
+    {
+        functions->glUniformMatrix4fv(uniform.variable.location, 1, GL_FALSE,
+                                      reinterpret_cast<const GLfloat*>(uniform.value.data()));
+    }
+    else
+    {
+        GLint value = 0;
+        std::memcpy(&value, uniform.value.data(), sizeof(value));
+        functions->glUniform1i(uniform.variable.location, value);
+    }
+}
+
+/**
+ * \brief Points the named uniform block at a uniform buffer binding point, so that every program bound to the
+ *        same point reads the same buffer. Returns false if the program has no such block.
+ */
+bool ShaderProgram::bindUniformBlock(const char* name, const GLuint bindingPoint)
 {
     // Make sure a program exists before calling this function
     Q_ASSERT(m_program != nullptr);
 
-    m_program->setUniformValue(name.toStdString().c_str(), value);
+    auto* functions = QOpenGLContext::currentContext()->extraFunctions();
+    const auto program = m_program->programId();
+
+    const auto blockIndex = functions->glGetUniformBlockIndex(program, name);
+    if(blockIndex == GL_INVALID_INDEX)
+    {
+        qDebug() << "Shader program has no uniform block named" << name;
+        return false;
+    }
+
+    functions->glUniformBlockBinding(program, blockIndex, bindingPoint);
+    return true;
+}
+
+/**
+ * \brief The active attributes of the program, as reflected when it linked
+ */
+const std::vector<ShaderVariable>& ShaderProgram::attributes() const
+{
+    return m_attributes;
+}
+
+/**
+ * \brief Location of the named active attribute, or -1 if the program has no such attribute
+ */
+GLint ShaderProgram::attributeLocation(const char* name) const
+{
+    for(const auto& attribute : m_attributes)
+    {
+        if(attribute.name == name)
+        {
+            return attribute.location;
+        }
+    }
+
+    return -1;
 }
 
 /**
@@ -103,20 +444,49 @@ bool ShaderProgram::isCreated() const
 }
 
 /**
- * \brief Wrapper around the bind() function;
+ * \brief Name of the linked program, 0 if there is none
+ */
+GLuint ShaderProgram::programId() const
+{
+    return (m_program != nullptr) ? m_program->programId() : 0U;
+}
+
+/**
+ * \brief Wrapper around the bind() function. Sends any uniform values that were set while the program wasn't bound.
  */
-void ShaderProgram::bind() const
+void ShaderProgram::bind()
 {
     // Make sure a program exists before calling this function
     Q_ASSERT(m_program != nullptr);
 
     m_program->bind();
+    s_boundProgram = this;
+
+    if(!m_hasDirtyUniforms)
+    {
+        return;
+    }
+
+    for(auto& uniform : m_uniforms)
+    {
+        if(uniform.dirty)
+        {
+            uploadUniform(uniform);
+            uniform.dirty = false;
+        }
+    }
+
+    m_hasDirtyUniforms = false;
 }
 
 /**
  * \brief Wrapper around the release() function;
  */
-void ShaderProgram::release() const
+void ShaderProgram::release()
 {
     m_program->release();
+    if(s_boundProgram == this)
+    {
+        s_boundProgram = nullptr;
+    }
 }
@@ -1,31 +1,110 @@
 #ifndef SHADERPROGRAM_H
 #define SHADERPROGRAM_H
 
+#include <array>
 #include <memory>
+#include <vector>
+#include <QByteArray>
 #include <QString>
 #include <QOpenGLShaderProgram>
 
+class ProgramBinaryCache;
+
+/**
+ * \brief An active uniform or attribute of a linked program, as the driver reports it
+ */
+struct ShaderVariable
+{
+    QByteArray name;
+    GLenum type;
+    GLint size; // array elements
+    GLint location;
+};
+
+/**
+ * \brief Refers to one of a ShaderProgram's uniforms, found once when the program links. The type parameter is
+ *        what the uniform is set from, and was checked against the uniform's type when the handle was handed out.
+ *        A default constructed handle, or one for a uniform the program doesn't have, is invalid and setting it
+ *        does nothing.
+ */
+template<typename T>
+class UniformHandle
+{
+public:
+    UniformHandle() : m_index{-1} {}
+
+    bool isValid() const { return m_index >= 0; }
+
+private:
+    friend class ShaderProgram;
+
+    explicit UniformHandle(const int32_t index) : m_index{index} {}
+
+    int32_t m_index;
+};
+
 class ShaderProgram
 {
 public:
     ShaderProgram();
 
-    void create(const QString& vertex_shader_path, const QString& fragment_shader_path);
+    void create(const QString& vertex_shader_path,
+                const QString& fragment_shader_path,
+                bool useBinaryCache = true);
     void setAttribute(int location,
                       GLenum type,
                       int offset,
                       int tupleSize,
                       int stride = 0);
-    void setUniformMatrix(const QString& name, const QMatrix4x4& mvp);
-    void setUniformValue(const QString& name, GLint value);
+
+    template<typename T>
+    UniformHandle<T> uniform(const char* name) const;
+
+    void setUniformValue(UniformHandle<GLint> uniform, GLint value);
+    void setUniformValue(UniformHandle<QMatrix4x4> uniform, const QMatrix4x4& value);
+
+    bool bindUniformBlock(const char* name, GLuint bindingPoint);
+
+    const std::vector<ShaderVariable>& attributes() const;
+    GLint attributeLocation(const char* name) const;
 
     bool isCreated() const;
-    void bind() const;
-    void release() const;
+    GLuint programId() const;
+    void bind();
+    void release();
+
+private:
+    // Largest value a uniform can be set to, a 4x4 matrix
+    static constexpr auto MAXIMUM_UNIFORM_BYTES = 16U * sizeof(float);
+
+    struct Uniform
+    {
+        ShaderVariable variable;
+        std::array<char, MAXIMUM_UNIFORM_BYTES> value;
+        bool hasValue; // value is what the program holds, or will once the pending upload is flushed
+        bool dirty;    // value changed while the program wasn't bound
+    };
+
+    bool createFromBinary(const ProgramBinaryCache& cache);
+    bool createFromSource(const QByteArray& vertexSource, const QByteArray& fragmentSource, bool retrievable);
+    void reflect();
+    int32_t findUniform(const char* name, bool (*acceptsType)(GLenum type)) const;
+    void setUniformData(int32_t index, const void* data, size_t bytes);
+    void uploadUniform(const Uniform& uniform) const;
 
 private:
     bool m_programCreatedSuccessfully;
     std::unique_ptr<QOpenGLShaderProgram> m_program;
+
+    std::vector<Uniform> m_uniforms;
+    std::vector<ShaderVariable> m_attributes;
+    bool m_hasDirtyUniforms;
 };
 
+template<>
+UniformHandle<GLint> ShaderProgram::uniform<GLint>(const char* name) const;
+
+template<>
+UniformHandle<QMatrix4x4> ShaderProgram::uniform<QMatrix4x4>(const char* name) const;
+
 #endif // SHADERPROGRAM_H
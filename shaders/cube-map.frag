@@ -3,9 +3,76 @@
 in vec3 TextureCoordinates;
 uniform samplerCube CubeMap;
 
+// Virtual texture, used in place of CubeMap when VirtualTexturing is 1
+uniform int VirtualTexturing;
+uniform sampler2D TileAtlas;
+uniform usampler2DArray PageTable; // one layer per face: atlas slot x, slot y, level of the tile to sample
+uniform int PageTableSize;         // tiles along each side of a face at the finest level
+uniform int TileSize;              // texels along each side of a tile, border excluded
+uniform int TileBorder;
+uniform int AtlasSize;             // texels along each side of the atlas
+
 out vec4 FragColor;
 
+// Face in the GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order and the s, t coordinates within it, as a cubemap picks them
+void cubeMapFace(vec3 direction, out int face, out vec2 coordinates)
+{
+    vec3 magnitude = abs(direction);
+    float majorAxis;
+    vec2 st;
+
+    if(magnitude.x >= magnitude.y && magnitude.x >= magnitude.z)
+    {
+        face = (direction.x >= 0.0) ? 0 : 1;
+        majorAxis = magnitude.x;
+        st = vec2((direction.x >= 0.0) ? -direction.z : direction.z, -direction.y);
+    }
+    else if(magnitude.y >= magnitude.z)
+    {
+        face = (direction.y >= 0.0) ? 2 : 3;
+        majorAxis = magnitude.y;
+        st = vec2(direction.x, (direction.y >= 0.0) ? direction.z : -direction.z);
+    }
+    else
+    {
+        face = (direction.z >= 0.0) ? 4 : 5;
+        majorAxis = magnitude.z;
+        st = vec2((direction.z >= 0.0) ? direction.x : -direction.x, -direction.y);
+    }
+
+    coordinates = clamp(((st / majorAxis) + 1.0) * 0.5, 0.0, 1.0);
+}
+
+vec4 sampleVirtualTexture(vec3 direction)
+{
+    int face;
+    vec2 coordinates;
+    cubeMapFace(direction, face, coordinates);
+
+    // The page table texel holds the finest resident tile covering this point
+    ivec2 cell = min(ivec2(coordinates * float(PageTableSize)), ivec2(PageTableSize - 1));
+    uvec4 entry = texelFetch(PageTable, ivec3(cell, face), 0);
+
+    float tilesPerSide = float(1 << int(entry.b));
+    vec2 tile = min(floor(coordinates * tilesPerSide), vec2(tilesPerSide - 1.0));
+    vec2 withinTile = clamp((coordinates * tilesPerSide) - tile, 0.0, 1.0);
+
+    vec2 texel = (vec2(entry.rg) * float(TileSize + (2 * TileBorder))) + float(TileBorder) + (withinTile * float(TileSize));
+
+    // The atlas holds a half size level under every tile for minified tiles. Its level of detail comes from the
+    // face coordinates, which are continuous, rather than the atlas ones, which jump between tiles.
+    vec2 atlasCoordinates = coordinates * ((tilesPerSide * float(TileSize)) / float(AtlasSize));
+    return textureGrad(TileAtlas, texel / float(AtlasSize), dFdx(atlasCoordinates), dFdy(atlasCoordinates));
+}
+
 void main()
 {
-    FragColor = texture(CubeMap, TextureCoordinates);
+    if(VirtualTexturing == 1)
+    {
+        FragColor = sampleVirtualTexture(TextureCoordinates);
+    }
+    else
+    {
+        FragColor = texture(CubeMap, TextureCoordinates);
+    }
 }
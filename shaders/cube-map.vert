@@ -1,13 +1,108 @@
 #version 410 core
 
-layout (location = 0) in vec3 aPos; // the position has attribute position 0
+layout (location = 0) in vec3 aPos;        // the position has attribute position 0
+layout (location = 1) in vec2 aOctahedral; // the position folded onto an octahedron, used when VertexFormat is 1
+layout (location = 2) in vec3 aPatch;      // column and row across the chunk, and 1 on its skirt, used when VertexFormat is 2
+layout (location = 3) in vec4 aChunk;      // per instance: s, t and size of the chunk on its face, then its skirt depth
+layout (location = 4) in uint aFace;       // per instance: cube face of the chunk, in CubeFace order
 
 out vec3 TextureCoordinates;
 
-uniform mat4 mvp;
+// Shared by every program and filled once per frame, see FrameUniforms in uniformbuffer.h
+layout (std140) uniform FrameUniforms
+{
+    mat4 mvp;
+};
+
+uniform int VertexFormat; // 0: float xyz, 1: octahedral 2x16-bit snorm, 2: instanced grid patch,
+                          // 3: procedural triangles, 4: procedural edges
+uniform int QuadsPerFaceSide; // subdivisions + 1, only read by the procedural formats
+
+// Corners of a quad's two triangles, as column and row offsets, in the order generateCubeFaceRows() indexes them
+const ivec2 QUAD_CORNERS[6] = ivec2[6](ivec2(0, 0), ivec2(1, 0), ivec2(1, 1),
+                                       ivec2(0, 0), ivec2(1, 1), ivec2(0, 1));
+
+// Ends of the three edges a grid vertex owns in generateSubdividedCubeEdges(): along the row, up the column and
+// along the diagonal
+const ivec2 EDGE_ENDS[6] = ivec2[6](ivec2(0, 0), ivec2(1, 0),
+                                    ivec2(0, 0), ivec2(0, 1),
+                                    ivec2(0, 0), ivec2(1, 1));
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+    vec3 v = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+    if(v.z < 0.0)
+    {
+        vec2 signs = vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+        v.xy = (1.0 - abs(v.yx)) * signs;
+    }
+    return normalize(v);
+}
+
+// Matches cubeFacePoint() in planetgenerator.cpp
+vec3 cubeFacePoint(uint face, vec2 st)
+{
+    switch(face)
+    {
+    case 0u: return vec3(st.x - 0.5, st.y - 0.5, 0.5);  // front
+    case 1u: return vec3(0.5 - st.x, st.y - 0.5, -0.5); // back
+    case 2u: return vec3(-0.5, st.y - 0.5, st.x - 0.5);  // left
+    case 3u: return vec3(0.5, st.y - 0.5, 0.5 - st.x);   // right
+    case 4u: return vec3(0.5 - st.x, 0.5, st.y - 0.5);   // top
+    default: return vec3(st.x - 0.5, -0.5, st.y - 0.5);  // bottom
+    }
+}
+
+// Same as generateCubeFaceChunk(): the point on the face is normalized, and the skirt pulled towards the center
+vec3 placePatch()
+{
+    vec3 onFace = cubeFacePoint(aFace, aChunk.xy + (aPatch.xy * aChunk.z));
+    return normalize(onFace) * (1.0 - (aPatch.z * aChunk.w));
+}
+
+// Same as generateSubdividedCube(), with one instance per face: triangles are six vertices per quad, row by row,
+// and edges six per grid vertex, collapsed to nothing where they would leave the face
+vec3 placeProcedural()
+{
+    ivec2 gridPoint;
+    if(VertexFormat == 3)
+    {
+        int quad = gl_VertexID / 6;
+        gridPoint = ivec2(quad % QuadsPerFaceSide, quad / QuadsPerFaceSide) + QUAD_CORNERS[gl_VertexID % 6];
+    }
+    else
+    {
+        int vertex = gl_VertexID / 6;
+        int verticesPerSide = QuadsPerFaceSide + 1;
+        ivec2 start = ivec2(vertex % verticesPerSide, vertex / verticesPerSide);
+        int edge = (gl_VertexID % 6) / 2;
+        ivec2 end = start + EDGE_ENDS[(edge * 2) + 1];
+        gridPoint = any(greaterThan(end, ivec2(QuadsPerFaceSide))) ? start : start + EDGE_ENDS[gl_VertexID % 6];
+    }
+
+    return normalize(cubeFacePoint(uint(gl_InstanceID), vec2(gridPoint) / float(QuadsPerFaceSide)));
+}
 
 void main()
 {
-    TextureCoordinates = aPos;
-    gl_Position = mvp * vec4(aPos, 1.0);
+    vec3 position;
+    if(VertexFormat >= 3)
+    {
+        position = placeProcedural();
+    }
+    else if(VertexFormat == 2)
+    {
+        position = placePatch();
+    }
+    else if(VertexFormat == 1)
+    {
+        position = decodeOctahedral(aOctahedral);
+    }
+    else
+    {
+        position = aPos;
+    }
+
+    TextureCoordinates = position;
+    gl_Position = mvp * vec4(position, 1.0);
 }
@@ -0,0 +1,195 @@
+#include "taskscheduler.h"
+
+#include <QtGlobal>
+
+/**
+ * \brief Constructor for the task scheduler. Each worker owns a queue; a worker pops the newest task from its
+ *        own queue and, once that runs dry, steals the oldest task from the others. With zero workers every
+ *        parallelFor() simply runs on the calling thread.
+ */
+TaskScheduler::TaskScheduler(const uint32_t numberOfWorkers) :
+    m_queues(),
+    m_workers(),
+    m_wakeMutex(),
+    m_wakeCondition(),
+    m_pendingTasks{0U},
+    m_stopping{false}
+{
+    for(auto i = 0U; i < numberOfWorkers; ++i)
+    {
+        m_queues.push_back(std::make_unique<WorkQueue>());
+    }
+
+    for(auto i = 0U; i < numberOfWorkers; ++i)
+    {
+        m_workers.emplace_back(&TaskScheduler::workerLoop, this, i);
+    }
+}
+
+/**
+ * \brief Destructor for the task scheduler. Workers finish whatever is still queued before exiting.
+ */
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stopping = true;
+    }
+    m_wakeCondition.notify_all();
+
+    for(auto& worker : m_workers)
+    {
+        worker.join();
+    }
+}
+
+/**
+ * \brief Process wide scheduler, created on first use. The calling thread always takes part in the work, so
+ *        one worker fewer than the number of hardware threads keeps every core busy.
+ */
+TaskScheduler& TaskScheduler::instance()
+{
+    static TaskScheduler scheduler(qMax(std::thread::hardware_concurrency(), 1U) - 1U);
+    return scheduler;
+}
+
+/**
+ * \brief Number of threads that execute tasks, including the thread that calls parallelFor()
+ */
+uint32_t TaskScheduler::numberOfThreads() const
+{
+    return static_cast<uint32_t>(m_workers.size()) + 1U;
+}
+
+/**
+ * \brief Splits [begin, end) into blocks of at most grainSize and calls body(blockBegin, blockEnd) for each one
+ *        across the pool. The calling thread executes tasks as well while it waits, so nested calls cannot
+ *        deadlock. Returns once every block has run.
+ */
+void TaskScheduler::parallelFor(const uint32_t begin,
+                                const uint32_t end,
+                                const uint32_t grainSize,
+                                const std::function<void(uint32_t, uint32_t)>& body)
+{
+    Q_ASSERT(grainSize > 0U);
+
+    if(begin >= end)
+    {
+        return;
+    }
+
+    const auto numberOfBlocks = ((end - begin) + grainSize - 1U) / grainSize;
+
+    // Nothing to share, so skip the queues entirely
+    if(m_workers.empty() || numberOfBlocks == 1U)
+    {
+        body(begin, end);
+        return;
+    }
+
+    std::atomic<uint32_t> remainingBlocks{numberOfBlocks};
+
+    for(auto block = 0U; block < numberOfBlocks; ++block)
+    {
+        const auto blockBegin = begin + (block * grainSize);
+        const auto blockEnd = qMin(blockBegin + grainSize, end);
+
+        push(block % static_cast<uint32_t>(m_queues.size()), [&body, &remainingBlocks, blockBegin, blockEnd]()
+        {
+            body(blockBegin, blockEnd);
+            remainingBlocks.fetch_sub(1U, std::memory_order_release);
+        });
+    }
+
+    while(remainingBlocks.load(std::memory_order_acquire) > 0U)
+    {
+        if(!tryRunTask(0U))
+        {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/**
+ * \brief Adds a task to the back of a queue and wakes a sleeping worker
+ */
+void TaskScheduler::push(const uint32_t queue, Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_queues[queue]->mutex);
+        m_queues[queue]->tasks.push_back(std::move(task));
+    }
+
+    {
+        // Incremented under the wake mutex so a worker can't miss it between checking and sleeping
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        ++m_pendingTasks;
+    }
+    m_wakeCondition.notify_one();
+}
+
+/**
+ * \brief Runs one task if any can be found. The preferred queue is popped from the back, which keeps recently
+ *        pushed and still cache-warm work local. The other queues are robbed from the front.
+ */
+bool TaskScheduler::tryRunTask(const uint32_t preferredQueue)
+{
+    Task task;
+    const auto numberOfQueues = static_cast<uint32_t>(m_queues.size());
+
+    {
+        auto& own = *m_queues[preferredQueue];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if(!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+        }
+    }
+
+    for(auto offset = 1U; !task && offset < numberOfQueues; ++offset)
+    {
+        auto& victim = *m_queues[(preferredQueue + offset) % numberOfQueues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+
+    if(!task)
+    {
+        return false;
+    }
+
+    --m_pendingTasks;
+    task();
+
+    return true;
+}
+
+/**
+ * \brief Body of each worker thread. Sleeps whenever no queue has work left.
+ */
+void TaskScheduler::workerLoop(const uint32_t queue)
+{
+    while(true)
+    {
+        if(tryRunTask(queue))
+        {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_wakeCondition.wait(lock, [this]()
+        {
+            return m_stopping || m_pendingTasks.load() > 0U;
+        });
+
+        if(m_stopping && m_pendingTasks.load() == 0U)
+        {
+            return;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef TASKSCHEDULER_H
+#define TASKSCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class TaskScheduler
+{
+public:
+    explicit TaskScheduler(uint32_t numberOfWorkers);
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    static TaskScheduler& instance();
+
+    uint32_t numberOfThreads() const;
+
+    void parallelFor(uint32_t begin,
+                     uint32_t end,
+                     uint32_t grainSize,
+                     const std::function<void(uint32_t, uint32_t)>& body);
+
+private:
+    using Task = std::function<void()>;
+
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void push(uint32_t queue, Task task);
+    bool tryRunTask(uint32_t preferredQueue);
+    void workerLoop(uint32_t queue);
+
+private:
+    std::vector<std::unique_ptr<WorkQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wakeCondition;
+    std::atomic<uint32_t> m_pendingTasks;
+    bool m_stopping;
+};
+
+#endif // TASKSCHEDULER_H
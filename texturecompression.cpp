@@ -0,0 +1,209 @@
+#include "texturecompression.h"
+
+#include <cmath>
+#include <utility>
+#include <QtGlobal>
+
+namespace
+{
+    constexpr auto TEXELS_PER_BLOCK = BC1_BLOCK_SIZE * BC1_BLOCK_SIZE;
+    constexpr auto RGBA_CHANNELS = 4U;
+
+    // Refinements of the block's principal axis, more changes nothing visible
+    constexpr auto POWER_ITERATIONS = 4U;
+}
+
+/**
+ * \brief Rounds an 8-bit colour to RGB565
+ */
+static uint16_t pack_565(const float* colour)
+{
+    const auto r = static_cast<uint16_t>(qBound(0.0f, std::round(colour[0] * (31.0f / 255.0f)), 31.0f));
+    const auto g = static_cast<uint16_t>(qBound(0.0f, std::round(colour[1] * (63.0f / 255.0f)), 63.0f));
+    const auto b = static_cast<uint16_t>(qBound(0.0f, std::round(colour[2] * (31.0f / 255.0f)), 31.0f));
+
+    return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+/**
+ * \brief Expands RGB565 back to 8-bit the way the hardware does, replicating the high bits into the low ones
+ */
+static void unpack_565(const uint16_t packed, float* colour)
+{
+    const auto r = (packed >> 11) & 0x1F;
+    const auto g = (packed >> 5) & 0x3F;
+    const auto b = packed & 0x1F;
+
+    colour[0] = static_cast<float>((r << 3) | (r >> 2));
+    colour[1] = static_cast<float>((g << 2) | (g >> 4));
+    colour[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+/**
+ * \brief Encodes one block of 16 RGB texels. The endpoints are the extremes of the texels projected onto their
+ *        principal axis, and each texel takes the nearest of the four palette colours. Colour 0 is always kept
+ *        above colour 1 so the block decodes in four colour mode.
+ */
+static void compress_bc1_block(const float texels[TEXELS_PER_BLOCK][3], uint8_t* output)
+{
+    float mean[3] = { 0.0f, 0.0f, 0.0f };
+    for(auto i = 0U; i < TEXELS_PER_BLOCK; ++i)
+    {
+        for(auto c = 0U; c < 3U; ++c)
+        {
+            mean[c] += texels[i][c] / TEXELS_PER_BLOCK;
+        }
+    }
+
+    float covariance[3][3] = {};
+    for(auto i = 0U; i < TEXELS_PER_BLOCK; ++i)
+    {
+        for(auto row = 0U; row < 3U; ++row)
+        {
+            for(auto column = 0U; column < 3U; ++column)
+            {
+                covariance[row][column] += (texels[i][row] - mean[row]) * (texels[i][column] - mean[column]);
+            }
+        }
+    }
+
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for(auto iteration = 0U; iteration < POWER_ITERATIONS; ++iteration)
+    {
+        float next[3];
+        for(auto row = 0U; row < 3U; ++row)
+        {
+            next[row] = (covariance[row][0] * axis[0]) + (covariance[row][1] * axis[1]) + (covariance[row][2] * axis[2]);
+        }
+
+        const auto length = std::sqrt((next[0] * next[0]) + (next[1] * next[1]) + (next[2] * next[2]));
+        if(length < 1e-6f)
+        {
+            break; // Flat block, any axis gives the same endpoints
+        }
+
+        for(auto c = 0U; c < 3U; ++c)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    auto minimum = 0.0f;
+    auto maximum = 0.0f;
+    for(auto i = 0U; i < TEXELS_PER_BLOCK; ++i)
+    {
+        const auto projection = ((texels[i][0] - mean[0]) * axis[0]) +
+                                ((texels[i][1] - mean[1]) * axis[1]) +
+                                ((texels[i][2] - mean[2]) * axis[2]);
+        minimum = qMin(minimum, projection);
+        maximum = qMax(maximum, projection);
+    }
+
+    float endpoints[2][3];
+    for(auto c = 0U; c < 3U; ++c)
+    {
+        endpoints[0][c] = mean[c] + (axis[c] * maximum);
+        endpoints[1][c] = mean[c] + (axis[c] * minimum);
+    }
+
+    auto colour0 = pack_565(endpoints[0]);
+    auto colour1 = pack_565(endpoints[1]);
+    if(colour0 < colour1)
+    {
+        std::swap(colour0, colour1);
+    }
+
+    float palette[4][3];
+    unpack_565(colour0, palette[0]);
+    unpack_565(colour1, palette[1]);
+    for(auto c = 0U; c < 3U; ++c)
+    {
+        palette[2][c] = ((2.0f * palette[0][c]) + palette[1][c]) / 3.0f;
+        palette[3][c] = (palette[0][c] + (2.0f * palette[1][c])) / 3.0f;
+    }
+
+    // Equal endpoints decode in three colour mode, where index 0 is still colour 0
+    uint32_t indices = 0U;
+    if(colour0 != colour1)
+    {
+        for(auto i = 0U; i < TEXELS_PER_BLOCK; ++i)
+        {
+            auto best = 0U;
+            auto bestDistance = 0.0f;
+
+            for(auto candidate = 0U; candidate < 4U; ++candidate)
+            {
+                const auto r = texels[i][0] - palette[candidate][0];
+                const auto g = texels[i][1] - palette[candidate][1];
+                const auto b = texels[i][2] - palette[candidate][2];
+                const auto distance = (r * r) + (g * g) + (b * b);
+
+                if(candidate == 0U || distance < bestDistance)
+                {
+                    best = candidate;
+                    bestDistance = distance;
+                }
+            }
+
+            indices |= best << (i * 2U);
+        }
+    }
+
+    output[0] = colour0 & 0xFF;
+    output[1] = colour0 >> 8;
+    output[2] = colour1 & 0xFF;
+    output[3] = colour1 >> 8;
+    output[4] = indices & 0xFF;
+    output[5] = (indices >> 8) & 0xFF;
+    output[6] = (indices >> 16) & 0xFF;
+    output[7] = indices >> 24;
+}
+
+/**
+ * \brief Size in bytes of a BC1 image. Partial blocks at the right and bottom edges take a whole block.
+ */
+uint32_t bc1CompressedSize(const uint32_t width, const uint32_t height)
+{
+    const auto blocksWide = (width + BC1_BLOCK_SIZE - 1U) / BC1_BLOCK_SIZE;
+    const auto blocksHigh = (height + BC1_BLOCK_SIZE - 1U) / BC1_BLOCK_SIZE;
+
+    return blocksWide * blocksHigh * BC1_BYTES_PER_BLOCK;
+}
+
+/**
+ * \brief Compresses tightly packed RGBA8888 texels to BC1 (DXT1) without alpha, 8 bytes per 4x4 block. Texels
+ *        beyond the edge of an image that isn't a multiple of 4 repeat the last row and column.
+ */
+std::vector<uint8_t> compressBc1(const uint8_t* rgba, const uint32_t width, const uint32_t height)
+{
+    std::vector<uint8_t> compressed(bc1CompressedSize(width, height));
+    auto* output = compressed.data();
+
+    for(auto blockY = 0U; blockY < height; blockY += BC1_BLOCK_SIZE)
+    {
+        for(auto blockX = 0U; blockX < width; blockX += BC1_BLOCK_SIZE)
+        {
+            float texels[TEXELS_PER_BLOCK][3];
+
+            for(auto y = 0U; y < BC1_BLOCK_SIZE; ++y)
+            {
+                for(auto x = 0U; x < BC1_BLOCK_SIZE; ++x)
+                {
+                    const auto sourceX = qMin(blockX + x, width - 1U);
+                    const auto sourceY = qMin(blockY + y, height - 1U);
+                    const auto* texel = rgba + ((static_cast<size_t>(sourceY) * width + sourceX) * RGBA_CHANNELS);
+
+                    for(auto c = 0U; c < 3U; ++c)
+                    {
+                        texels[(y * BC1_BLOCK_SIZE) + x][c] = texel[c];
+                    }
+                }
+            }
+
+            compress_bc1_block(texels, output);
+            output += BC1_BYTES_PER_BLOCK;
+        }
+    }
+
+    return compressed;
+}
@@ -0,0 +1,13 @@
+#ifndef TEXTURECOMPRESSION_H
+#define TEXTURECOMPRESSION_H
+
+#include <cstdint>
+#include <vector>
+
+constexpr auto BC1_BLOCK_SIZE = 4U;        // Texels along each side of a block
+constexpr auto BC1_BYTES_PER_BLOCK = 8U;
+
+uint32_t bc1CompressedSize(uint32_t width, uint32_t height);
+std::vector<uint8_t> compressBc1(const uint8_t* rgba, uint32_t width, uint32_t height);
+
+#endif // TEXTURECOMPRESSION_H
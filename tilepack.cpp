@@ -0,0 +1,440 @@
+#include "tilepack.h"
+#include "taskscheduler.h"
+
+#include <cstring>
+#include <vector>
+#include <QByteArray>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+namespace
+{
+    constexpr uint32_t TILE_PACK_MAGIC = 0x50544751U; // "QGTP" in a little-endian file
+    constexpr uint32_t TILE_PACK_FILE_VERSION = 1U;
+
+    constexpr auto RGBA8888_BYTES_PER_PIXEL = 4U;
+
+    // Deep enough for a 2^21 texel face with 128 texel tiles, and keeps the index count well inside 64 bits
+    constexpr auto MAXIMUM_NUMBER_OF_LEVELS = 15U;
+
+    // Tiles read and encoded on the task scheduler between writes, bounding the builder's memory use
+    constexpr auto TILES_PER_WRITE = 256U;
+
+    constexpr uint64_t FNV_OFFSET_BASIS = 0xCBF29CE484222325ULL;
+    constexpr uint64_t FNV_PRIME = 0x100000001B3ULL;
+
+    struct TilePackHeader
+    {
+        uint32_t magic;
+        uint32_t fileVersion;
+        uint32_t tileSize;
+        uint32_t tileBorder;
+        uint32_t numberOfLevels;
+        uint32_t numberOfFaces;
+        uint32_t encoding;
+        uint32_t reserved;
+        uint64_t indexOffset;
+        uint64_t numberOfTiles;
+        uint64_t payloadOffset;
+        uint64_t payloadBytes;
+    };
+
+    // One per tile, faces in the GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order, then levels, then rows of tiles
+    struct TilePackEntry
+    {
+        uint64_t offset;
+        uint32_t bytes;
+        uint32_t checksum;
+    };
+
+    static_assert(sizeof(TilePackHeader) == 64, "The tile pack header is read and written as raw bytes");
+    static_assert(sizeof(TilePackEntry) == 16, "The tile pack index is read and written as raw bytes");
+}
+
+/**
+ * \brief FNV-1a over a tile payload, eight bytes per step with a byte-wise tail, folded down to 32 bits
+ */
+static uint32_t tile_checksum(const uchar* data, const uint64_t bytes)
+{
+    auto hash = FNV_OFFSET_BASIS;
+
+    auto i = 0ULL;
+    for(; i + sizeof(uint64_t) <= bytes; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * FNV_PRIME;
+    }
+
+    for(; i < bytes; ++i)
+    {
+        hash = (hash ^ data[i]) * FNV_PRIME;
+    }
+
+    return static_cast<uint32_t>(hash ^ (hash >> 32U));
+}
+
+/**
+ * \brief Number of RGBA8 bytes in a decoded tile, border included
+ */
+static uint32_t decoded_tile_bytes(const uint32_t tileSize)
+{
+    const auto borderedSize = tileSize + (2U * VIRTUAL_TEXTURE_TILE_BORDER);
+    return borderedSize * borderedSize * RGBA8888_BYTES_PER_PIXEL;
+}
+
+/**
+ * \brief Number of tiles in one face of a pyramid with the given number of levels, 1 + 4 + 16 + ...
+ */
+uint64_t tilePackTilesPerFace(const uint32_t numberOfLevels)
+{
+    return ((1ULL << (2U * numberOfLevels)) - 1U) / 3U;
+}
+
+/**
+ * \brief Position of a tile in the index. Every tile has a fixed slot, so finding one is a single multiply-add
+ *        rather than a search.
+ */
+uint64_t tilePackTileIndex(const TileKey& key, const uint32_t numberOfLevels)
+{
+    return (key.face * tilePackTilesPerFace(numberOfLevels)) +
+           tilePackTilesPerFace(key.level) +
+           (static_cast<uint64_t>(key.y) << key.level) + key.x;
+}
+
+/**
+ * \brief Constructor for the tile pack. Nothing is mapped until load() is called.
+ */
+TilePack::TilePack() :
+    m_file{},
+    m_mapping{nullptr},
+    m_fileSize{0},
+    m_tileSize{0},
+    m_numberOfLevels{0},
+    m_encoding{TilePackEncoding::Raw},
+    m_indexOffset{0}
+{
+
+}
+
+/**
+ * \brief Unmaps the file
+ */
+TilePack::~TilePack()
+{
+    release();
+}
+
+/**
+ * \brief Maps the file and checks its header. Returns false, leaving nothing mapped, if it isn't a tile pack
+ *        this build can read or the index runs past the end of the file. Tiles are checked as they are read.
+ */
+bool TilePack::load(const QString& path)
+{
+    release();
+
+    m_file.setFileName(path);
+    if(!m_file.open(QIODevice::ReadOnly))
+    {
+        qDebug() << "Could not open tile pack" << path;
+        return false;
+    }
+
+    m_fileSize = static_cast<uint64_t>(m_file.size());
+    if(m_fileSize < sizeof(TilePackHeader))
+    {
+        qDebug() << "Tile pack is truncated" << path;
+        release();
+        return false;
+    }
+
+    m_mapping = m_file.map(0, m_file.size());
+    if(m_mapping == nullptr)
+    {
+        qDebug() << "Could not map tile pack" << path;
+        release();
+        return false;
+    }
+
+    TilePackHeader header;
+    std::memcpy(&header, m_mapping, sizeof(header));
+
+    const auto validLevels = header.numberOfLevels > 0U && header.numberOfLevels <= MAXIMUM_NUMBER_OF_LEVELS;
+    const auto validIndex = validLevels &&
+                            header.numberOfTiles == KTX_CUBE_MAP_FACES * tilePackTilesPerFace(header.numberOfLevels) &&
+                            header.indexOffset >= sizeof(TilePackHeader) &&
+                            header.indexOffset + (header.numberOfTiles * sizeof(TilePackEntry)) <= m_fileSize;
+
+    if(header.magic != TILE_PACK_MAGIC || header.fileVersion != TILE_PACK_FILE_VERSION ||
+       header.numberOfFaces != KTX_CUBE_MAP_FACES || header.tileBorder != VIRTUAL_TEXTURE_TILE_BORDER ||
+       header.tileSize == 0U || header.encoding > static_cast<uint32_t>(TilePackEncoding::Deflate) || !validIndex)
+    {
+        qDebug() << "Not a tile pack this build can read" << path;
+        release();
+        return false;
+    }
+
+    m_tileSize = header.tileSize;
+    m_numberOfLevels = header.numberOfLevels;
+    m_encoding = static_cast<TilePackEncoding>(header.encoding);
+    m_indexOffset = header.indexOffset;
+
+    return true;
+}
+
+/**
+ * \brief Unmaps and closes the file. Tile data returned earlier is invalid afterwards.
+ */
+void TilePack::release()
+{
+    if(m_mapping != nullptr)
+    {
+        m_file.unmap(m_mapping);
+        m_mapping = nullptr;
+    }
+
+    if(m_file.isOpen())
+    {
+        m_file.close();
+    }
+
+    m_fileSize = 0U;
+    m_tileSize = 0U;
+    m_numberOfLevels = 0U;
+}
+
+/**
+ * \brief Accessor for the number of texels along each side of a tile, border excluded
+ */
+uint32_t TilePack::tileSize() const
+{
+    return m_tileSize;
+}
+
+/**
+ * \brief Accessor for the number of levels in the pyramid
+ */
+uint32_t TilePack::numberOfLevels() const
+{
+    return m_numberOfLevels;
+}
+
+/**
+ * \brief Accessor for the encoding of the tile payloads
+ */
+TilePackEncoding TilePack::encoding() const
+{
+    return m_encoding;
+}
+
+/**
+ * \brief Encoded payload of a tile straight out of the mapping, or nullptr if the tile is out of range, its entry
+ *        points outside the file or its checksum doesn't match
+ */
+const uchar* TilePack::tileData(const TileKey& key, uint32_t& bytes) const
+{
+    bytes = 0U;
+
+    if(m_mapping == nullptr || key.face >= KTX_CUBE_MAP_FACES || key.level >= m_numberOfLevels ||
+       key.x >= (1U << key.level) || key.y >= (1U << key.level))
+    {
+        return nullptr;
+    }
+
+    TilePackEntry entry;
+    std::memcpy(&entry,
+                m_mapping + m_indexOffset + (tilePackTileIndex(key, m_numberOfLevels) * sizeof(TilePackEntry)),
+                sizeof(entry));
+
+    if(entry.offset > m_fileSize || entry.bytes > m_fileSize - entry.offset ||
+       tile_checksum(m_mapping + entry.offset, entry.bytes) != entry.checksum)
+    {
+        return nullptr;
+    }
+
+    bytes = entry.bytes;
+    return m_mapping + entry.offset;
+}
+
+/**
+ * \brief Decodes one tile. Safe to call from several threads at once, since it only reads the mapping.
+ */
+bool TilePack::readTile(const TileKey& key, uint8_t* rgba) const
+{
+    uint32_t bytes = 0U;
+    const auto* data = tileData(key, bytes);
+    if(data == nullptr)
+    {
+        return false;
+    }
+
+    const auto expectedBytes = decoded_tile_bytes(m_tileSize);
+
+    if(m_encoding == TilePackEncoding::Deflate)
+    {
+        const auto texels = qUncompress(data, bytes);
+        if(static_cast<uint64_t>(texels.size()) != expectedBytes)
+        {
+            return false;
+        }
+
+        std::memcpy(rgba, texels.constData(), expectedBytes);
+        return true;
+    }
+
+    if(bytes != expectedBytes)
+    {
+        return false;
+    }
+
+    std::memcpy(rgba, data, expectedBytes);
+    return true;
+}
+
+/**
+ * \brief Writes every tile of the source to a tile pack at path, replacing any existing file only once all of it
+ *        has been written. Tiles are read and encoded on the task scheduler a batch at a time and written face by
+ *        face, coarsest level first, so the coarse levels sit together at the front of the file. Returns false,
+ *        leaving any existing file alone, if the source fails to read a tile, rather than writing a pack with holes.
+ */
+bool writeTilePack(const QString& path, const TileSource& source, const TilePackEncoding encoding)
+{
+    const auto numberOfLevels = source.numberOfLevels();
+    if(numberOfLevels == 0U || numberOfLevels > MAXIMUM_NUMBER_OF_LEVELS)
+    {
+        qDebug() << "Cannot write a tile pack with" << numberOfLevels << "levels";
+        return false;
+    }
+
+    if(!QDir().mkpath(QFileInfo(path).absolutePath()))
+    {
+        qDebug() << "Could not create the directory for" << path;
+        return false;
+    }
+
+    QSaveFile file(path);
+    if(!file.open(QIODevice::WriteOnly))
+    {
+        qDebug() << "Could not create tile pack" << path;
+        return false;
+    }
+
+    const auto tilesPerFace = tilePackTilesPerFace(numberOfLevels);
+
+    auto header = TilePackHeader{};
+    header.magic = TILE_PACK_MAGIC;
+    header.fileVersion = TILE_PACK_FILE_VERSION;
+    header.tileSize = source.tileSize();
+    header.tileBorder = VIRTUAL_TEXTURE_TILE_BORDER;
+    header.numberOfLevels = numberOfLevels;
+    header.numberOfFaces = KTX_CUBE_MAP_FACES;
+    header.encoding = static_cast<uint32_t>(encoding);
+    header.indexOffset = sizeof(TilePackHeader);
+    header.numberOfTiles = KTX_CUBE_MAP_FACES * tilesPerFace;
+    header.payloadOffset = header.indexOffset + (header.numberOfTiles * sizeof(TilePackEntry));
+
+    // The index is written as zeros first and again with the real offsets once every payload is in place
+    std::vector<TilePackEntry> index(header.numberOfTiles, TilePackEntry{});
+
+    auto written = file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header) &&
+                   file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(TilePackEntry)) ==
+                   static_cast<qint64>(index.size() * sizeof(TilePackEntry));
+
+    const auto decodedBytes = decoded_tile_bytes(source.tileSize());
+    std::vector<uint8_t> texels(static_cast<size_t>(decodedBytes) * TILES_PER_WRITE);
+    std::vector<QByteArray> payloads(TILES_PER_WRITE);
+    std::vector<uint8_t> tileRead(TILES_PER_WRITE, 0U);
+    std::vector<TileKey> batch;
+    batch.reserve(TILES_PER_WRITE);
+
+    auto offset = header.payloadOffset;
+
+    const auto writeBatch = [&]()
+    {
+        TaskScheduler::instance().parallelFor(0U, static_cast<uint32_t>(batch.size()), 1U,
+                                              [&](const uint32_t first, const uint32_t last)
+        {
+            for(auto i = first; i < last; ++i)
+            {
+                auto* tile = texels.data() + (static_cast<size_t>(i) * decodedBytes);
+                tileRead[i] = source.readTile(batch[i], tile) ? 1U : 0U;
+                if(tileRead[i] == 0U)
+                {
+                    continue;
+                }
+
+                payloads[i] = (encoding == TilePackEncoding::Deflate)
+                            ? qCompress(tile, decodedBytes)
+                            : QByteArray(reinterpret_cast<const char*>(tile), decodedBytes);
+            }
+        });
+
+        // Reported here rather than on the workers, so the messages come out in order
+        for(auto i = 0U; i < batch.size(); ++i)
+        {
+            if(tileRead[i] == 0U)
+            {
+                qDebug() << "Could not read tile" << batch[i].face << batch[i].level << batch[i].x << batch[i].y
+                         << "for the tile pack";
+                written = false;
+            }
+        }
+
+        for(auto i = 0U; i < batch.size() && written; ++i)
+        {
+            const auto& payload = payloads[i];
+            auto& entry = index[tilePackTileIndex(batch[i], numberOfLevels)];
+
+            entry.offset = offset;
+            entry.bytes = static_cast<uint32_t>(payload.size());
+            entry.checksum = tile_checksum(reinterpret_cast<const uchar*>(payload.constData()), entry.bytes);
+
+            written = file.write(payload) == payload.size();
+            offset += entry.bytes;
+        }
+
+        batch.clear();
+    };
+
+    for(auto face = 0U; face < KTX_CUBE_MAP_FACES && written; ++face)
+    {
+        for(auto level = 0U; level < numberOfLevels && written; ++level)
+        {
+            for(auto y = 0U; y < (1U << level) && written; ++y)
+            {
+                for(auto x = 0U; x < (1U << level); ++x)
+                {
+                    batch.push_back({ face, level, x, y });
+                    if(batch.size() == TILES_PER_WRITE)
+                    {
+                        writeBatch();
+                    }
+                }
+            }
+        }
+    }
+
+    if(!batch.empty() && written)
+    {
+        writeBatch();
+    }
+
+    header.payloadBytes = offset - header.payloadOffset;
+
+    written = written &&
+              file.seek(0) &&
+              file.write(reinterpret_cast<const char*>(&header), sizeof(header)) == sizeof(header) &&
+              file.write(reinterpret_cast<const char*>(index.data()), index.size() * sizeof(TilePackEntry)) ==
+              static_cast<qint64>(index.size() * sizeof(TilePackEntry));
+
+    if(!written || !file.commit())
+    {
+        qDebug() << "Could not write tile pack" << path;
+        file.cancelWriting();
+        return false;
+    }
+
+    return true;
+}
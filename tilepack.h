@@ -0,0 +1,60 @@
+#ifndef TILEPACK_H
+#define TILEPACK_H
+
+#include <cstdint>
+#include <QFile>
+#include <QString>
+
+#include "tilesource.h"
+
+/**
+ * \brief How each tile payload is stored. Either way a tile decodes on its own, without reading any other tile.
+ */
+enum class TilePackEncoding : uint32_t
+{
+    Raw = 0U, // (tile size + 2 * border)^2 RGBA8 texels
+    Deflate   // the same texels compressed with qCompress()
+};
+
+/**
+ * \brief Read-only, memory mapped tile pyramid. The file is a header, an index with an offset, size and checksum
+ *        for every tile of every level of every face, and the tile payloads. load() only checks the header and
+ *        that the index fits in the file, and a tile is found with a single index lookup, so reading one touches
+ *        nothing but its own index entry and payload.
+ */
+class TilePack : public TileSource
+{
+public:
+    TilePack();
+    ~TilePack() override;
+
+    TilePack(const TilePack&) = delete;
+    TilePack& operator=(const TilePack&) = delete;
+
+    bool load(const QString& path);
+    void release();
+
+    uint32_t tileSize() const override;
+    uint32_t numberOfLevels() const override;
+    bool readTile(const TileKey& key, uint8_t* rgba) const override;
+
+    TilePackEncoding encoding() const;
+    const uchar* tileData(const TileKey& key, uint32_t& bytes) const;
+
+private:
+    QFile m_file;
+    uchar* m_mapping;
+    uint64_t m_fileSize;
+
+    uint32_t m_tileSize;
+    uint32_t m_numberOfLevels;
+    TilePackEncoding m_encoding;
+    uint64_t m_indexOffset;
+};
+
+uint64_t tilePackTilesPerFace(uint32_t numberOfLevels);
+uint64_t tilePackTileIndex(const TileKey& key, uint32_t numberOfLevels);
+
+bool writeTilePack(const QString& path, const TileSource& source, TilePackEncoding encoding);
+
+#endif // TILEPACK_H
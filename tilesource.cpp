@@ -0,0 +1,144 @@
+#include "tilesource.h"
+
+#include <cstring>
+#include <QtGlobal>
+
+namespace
+{
+    constexpr auto RGBA8888_BYTES_PER_PIXEL = 4U;
+
+    constexpr auto FACE_KEY_SHIFT  = 61U;
+    constexpr auto LEVEL_KEY_SHIFT = 56U;
+    constexpr auto X_KEY_SHIFT     = 28U;
+}
+
+/**
+ * \brief Packs the face, level and tile coordinates into a single value to use as a map key
+ */
+uint64_t TileKey::key() const
+{
+    return (static_cast<uint64_t>(face)  << FACE_KEY_SHIFT)  |
+           (static_cast<uint64_t>(level) << LEVEL_KEY_SHIFT) |
+           (static_cast<uint64_t>(x)     << X_KEY_SHIFT)     |
+            static_cast<uint64_t>(y);
+}
+
+/**
+ * \brief The tile one level up that covers this one. Must not be called on a level 0 tile.
+ */
+TileKey TileKey::parent() const
+{
+    Q_ASSERT(level > 0U);
+
+    return { face, level - 1U, x >> 1U, y >> 1U };
+}
+
+/**
+ * \brief Constructor for a cubemap tile source reading from a loaded or mapped RGBA8 KTX file
+ */
+CubeMapTileSource::CubeMapTileSource(std::unique_ptr<KtxCubeMap> mipChain, const uint32_t tileSize) :
+    CubeMapTileSource({}, mipChain->width(), mipChain->height(), tileSize)
+{
+    Q_ASSERT(mipChain->glInternalFormat() == KTX_GL_RGBA8);
+
+    m_numberOfMipLevels = mipChain->mipLevels();
+    m_mipChain = std::move(mipChain);
+}
+
+/**
+ * \brief Constructor for a cubemap tile source holding its mip levels in memory. The pyramid gets as many levels
+ *        as halving the face leaves room for a whole tile, always at least one.
+ */
+CubeMapTileSource::CubeMapTileSource(std::vector<KtxCubeMapLevel> levels,
+                                     const uint32_t width,
+                                     const uint32_t height,
+                                     const uint32_t tileSize) :
+    m_mipChain{nullptr},
+    m_levels{std::move(levels)},
+    m_numberOfMipLevels{static_cast<uint32_t>(m_levels.size())},
+    m_width{width},
+    m_height{height},
+    m_tileSize{tileSize},
+    m_numberOfLevels{1U}
+{
+    while((static_cast<uint64_t>(m_tileSize) << m_numberOfLevels) <= qMin(m_width, m_height))
+    {
+        ++m_numberOfLevels;
+    }
+}
+
+/**
+ * \brief Accessor for the number of texels along each side of a tile, border excluded
+ */
+uint32_t CubeMapTileSource::tileSize() const
+{
+    return m_tileSize;
+}
+
+/**
+ * \brief Accessor for the number of levels in the pyramid
+ */
+uint32_t CubeMapTileSource::numberOfLevels() const
+{
+    return m_numberOfLevels;
+}
+
+/**
+ * \brief Copies a tile and its border out of the mip level closest to it in size. Texels past the edge of the
+ *        face repeat the edge, like a cubemap sampled with clamp to edge. Returns false if the face is missing.
+ */
+bool CubeMapTileSource::readTile(const TileKey& key, uint8_t* rgba) const
+{
+    Q_ASSERT(key.face < KTX_CUBE_MAP_FACES && key.level < m_numberOfLevels);
+
+    // Texels across the whole face at this level of the pyramid
+    const auto pyramidSize = static_cast<int64_t>(m_tileSize) << key.level;
+
+    auto mip = 0U;
+    while(mip + 1U < m_numberOfMipLevels && (m_width >> (mip + 1U)) >= pyramidSize && (m_height >> (mip + 1U)) >= pyramidSize)
+    {
+        ++mip;
+    }
+
+    const auto mipWidth = static_cast<int64_t>(qMax(m_width >> mip, 1U));
+    const auto mipHeight = static_cast<int64_t>(qMax(m_height >> mip, 1U));
+
+    const auto* texels = faceTexels(mip, key.face, static_cast<size_t>(mipWidth * mipHeight * RGBA8888_BYTES_PER_PIXEL));
+    if(texels == nullptr)
+    {
+        return false;
+    }
+
+    const auto borderedSize = m_tileSize + (2U * VIRTUAL_TEXTURE_TILE_BORDER);
+    const auto firstColumn = (static_cast<int64_t>(key.x) * m_tileSize) - VIRTUAL_TEXTURE_TILE_BORDER;
+    const auto firstRow = (static_cast<int64_t>(key.y) * m_tileSize) - VIRTUAL_TEXTURE_TILE_BORDER;
+
+    for(auto row = 0U; row < borderedSize; ++row)
+    {
+        const auto sourceRow = qBound<int64_t>(0, ((firstRow + row) * mipHeight) / pyramidSize, mipHeight - 1);
+        const auto* source = texels + (sourceRow * mipWidth * RGBA8888_BYTES_PER_PIXEL);
+
+        for(auto column = 0U; column < borderedSize; ++column)
+        {
+            const auto sourceColumn = qBound<int64_t>(0, ((firstColumn + column) * mipWidth) / pyramidSize, mipWidth - 1);
+            std::memcpy(rgba, source + (sourceColumn * RGBA8888_BYTES_PER_PIXEL), RGBA8888_BYTES_PER_PIXEL);
+            rgba += RGBA8888_BYTES_PER_PIXEL;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * \brief Texels of one face of a mip level, or nullptr if the face doesn't hold the expected number of bytes
+ */
+const uint8_t* CubeMapTileSource::faceTexels(const uint32_t level, const uint32_t face, const size_t bytes) const
+{
+    if(m_mipChain != nullptr)
+    {
+        return (m_mipChain->faceSize(level) == bytes) ? m_mipChain->faceData(level, face) : nullptr;
+    }
+
+    const auto& texels = m_levels[level][face];
+    return (texels.size() == bytes) ? texels.data() : nullptr;
+}
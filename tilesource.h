@@ -0,0 +1,75 @@
+#ifndef TILESOURCE_H
+#define TILESOURCE_H
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ktxcubemap.h"
+
+// Texels copied from the neighbouring tile around each side of a tile, so bilinear filtering at the tile edge
+// never reads from an unrelated tile in the atlas
+constexpr auto VIRTUAL_TEXTURE_TILE_BORDER = 1U;
+
+/**
+ * \brief One tile of the pyramid. Level 0 covers a whole cube face with a single tile and each level below it
+ *        splits every tile of the one above into four. The face follows the GL_TEXTURE_CUBE_MAP_POSITIVE_X + i
+ *        order, and x and y count tiles along the s and t cubemap coordinates of that face.
+ */
+struct TileKey
+{
+    uint64_t key() const;
+    TileKey parent() const;
+
+    uint32_t face;
+    uint32_t level;
+    uint32_t x;
+    uint32_t y;
+};
+
+/**
+ * \brief Where the texels of the tile pyramid come from. readTile() is called from worker threads and has to
+ *        write (tileSize() + 2 * VIRTUAL_TEXTURE_TILE_BORDER)^2 RGBA8 texels, border included.
+ */
+class TileSource
+{
+public:
+    virtual ~TileSource() = default;
+
+    virtual uint32_t tileSize() const = 0;
+    virtual uint32_t numberOfLevels() const = 0;
+    virtual bool readTile(const TileKey& key, uint8_t* rgba) const = 0;
+};
+
+/**
+ * \brief Tile source cut out of a cubemap and its mip chain. Each tile is taken from the smallest mip level that
+ *        still has at least as many texels as the tile needs, so the finest level of the pyramid is as detailed as
+ *        the base level of the cubemap. Given a memory mapped RGBA8 KTX file, tiles are read from it on demand and
+ *        only the pages they touch are ever resident. Levels held in memory are meant as a fallback for small
+ *        cubemaps; large imagery should go through a TilePack, which is also mapped and stores tiles contiguously.
+ */
+class CubeMapTileSource : public TileSource
+{
+public:
+    CubeMapTileSource(std::unique_ptr<KtxCubeMap> mipChain, uint32_t tileSize);
+    CubeMapTileSource(std::vector<KtxCubeMapLevel> levels, uint32_t width, uint32_t height, uint32_t tileSize);
+
+    uint32_t tileSize() const override;
+    uint32_t numberOfLevels() const override;
+    bool readTile(const TileKey& key, uint8_t* rgba) const override;
+
+private:
+    const uint8_t* faceTexels(uint32_t level, uint32_t face, size_t bytes) const;
+
+private:
+    std::unique_ptr<KtxCubeMap> m_mipChain; // nullptr when the levels are held in m_levels instead
+    std::vector<KtxCubeMapLevel> m_levels;
+    uint32_t m_numberOfMipLevels;
+
+    uint32_t m_width;
+    uint32_t m_height;
+    uint32_t m_tileSize;
+    uint32_t m_numberOfLevels;
+};
+
+#endif // TILESOURCE_H
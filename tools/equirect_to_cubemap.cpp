@@ -0,0 +1,386 @@
+#include "cubemapprojection.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QImageReader>
+#include <QTemporaryFile>
+
+namespace
+{
+    constexpr auto RGBA8888_BYTES_PER_PIXEL = 4U;
+    constexpr auto RGB_BYTES_PER_PIXEL = 3U;
+    constexpr auto DEFAULT_BAND_ROWS = 512U;
+
+    // Must match CUBEMAP_*_PATH in globewidget.cpp, in the GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+    const char* const CUBE_MAP_FACE_NAMES[CUBE_MAP_PROJECTION_FACES] = {
+        "asia.png", "americas.png",
+        "arctic.png", "antarctica.png",
+        "africa.png", "pacific.png"
+    };
+}
+
+/**
+ * \brief Reads an equirectangular image a band of rows at a time. Binary PPM files are read straight from disk,
+ *        other formats through QImageReader with a clip rectangle when the format can decode one without the
+ *        rest of the image, and otherwise decoded once in full.
+ */
+class BandReader
+{
+public:
+    BandReader();
+
+    bool open(const QString& path);
+
+    QSize size() const;
+    bool streams() const;
+    bool read(uint32_t firstRow, uint32_t numberOfRows, std::vector<uint8_t>& rgba);
+
+private:
+    bool openPpm();
+
+private:
+    QString m_path;
+    QFile m_file;
+    QSize m_size;
+    qint64 m_ppmDataOffset; // -1 unless the image is a binary PPM read straight from disk
+    bool m_clipRect;
+    QImage m_whole;
+};
+
+/**
+ * \brief Reads the next whitespace separated header field of a PPM file, skipping # comments
+ */
+static bool read_ppm_field(QFile& file, uint32_t& value)
+{
+    char character = ' ';
+
+    while(file.getChar(&character))
+    {
+        if(character == '#')
+        {
+            while(file.getChar(&character) && character != '\n')
+            {
+            }
+        }
+        else if(character != ' ' && character != '\t' && character != '\r' && character != '\n')
+        {
+            break;
+        }
+    }
+
+    if(character < '0' || character > '9')
+    {
+        return false;
+    }
+
+    value = 0U;
+    do
+    {
+        value = (value * 10U) + static_cast<uint32_t>(character - '0');
+    }
+    while(file.getChar(&character) && character >= '0' && character <= '9');
+
+    // A single whitespace character separates the last field from the texels, and has just been consumed
+    return true;
+}
+
+/**
+ * \brief Constructor for the band reader. Nothing is read until open() is called.
+ */
+BandReader::BandReader() :
+    m_path(),
+    m_file(),
+    m_size(),
+    m_ppmDataOffset{-1},
+    m_clipRect{false},
+    m_whole()
+{
+
+}
+
+/**
+ * \brief Opens the image and reads its size, picking how bands will be read. Returns false if the image can't be
+ *        read at all.
+ */
+bool BandReader::open(const QString& path)
+{
+    m_path = path;
+    m_file.setFileName(path);
+
+    if(m_file.open(QIODevice::ReadOnly) && openPpm())
+    {
+        return true;
+    }
+    m_file.close();
+
+    QImageReader reader(path);
+    m_size = reader.size();
+    if(!m_size.isValid())
+    {
+        return false;
+    }
+
+    m_clipRect = reader.supportsOption(QImageIOHandler::ClipRect);
+    return true;
+}
+
+/**
+ * \brief Parses the header of a binary PPM file with 8-bit channels from the open m_file and checks that all of
+ *        its texels are there. Returns false for anything else, which is then read through QImageReader.
+ */
+bool BandReader::openPpm()
+{
+    char magic[2];
+    if(m_file.read(magic, 2) != 2 || magic[0] != 'P' || magic[1] != '6')
+    {
+        return false;
+    }
+
+    uint32_t width = 0U;
+    uint32_t height = 0U;
+    uint32_t maximum = 0U;
+    if(!read_ppm_field(m_file, width) || !read_ppm_field(m_file, height) || !read_ppm_field(m_file, maximum) ||
+       maximum != 255U)
+    {
+        return false;
+    }
+
+    const auto dataOffset = m_file.pos();
+    if(m_file.size() < dataOffset + (static_cast<qint64>(width) * height * RGB_BYTES_PER_PIXEL))
+    {
+        return false;
+    }
+
+    m_size = QSize(static_cast<int>(width), static_cast<int>(height));
+    m_ppmDataOffset = dataOffset;
+    return true;
+}
+
+/**
+ * \brief Accessor for the size of the image, invalid until open() succeeds
+ */
+QSize BandReader::size() const
+{
+    return m_size;
+}
+
+/**
+ * \brief Returns true if bands are read without ever decoding the whole image
+ */
+bool BandReader::streams() const
+{
+    return m_ppmDataOffset >= 0 || m_clipRect;
+}
+
+/**
+ * \brief Reads the rows [firstRow, firstRow + numberOfRows) as tightly packed RGBA8888
+ */
+bool BandReader::read(const uint32_t firstRow, const uint32_t numberOfRows, std::vector<uint8_t>& rgba)
+{
+    const auto width = static_cast<size_t>(m_size.width());
+    const auto rowBytes = width * RGBA8888_BYTES_PER_PIXEL;
+    rgba.resize(rowBytes * numberOfRows);
+
+    if(m_ppmDataOffset >= 0)
+    {
+        std::vector<uint8_t> rgb(width * RGB_BYTES_PER_PIXEL * numberOfRows);
+        if(!m_file.seek(m_ppmDataOffset + static_cast<qint64>(firstRow * width * RGB_BYTES_PER_PIXEL)) ||
+           m_file.read(reinterpret_cast<char*>(rgb.data()), static_cast<qint64>(rgb.size())) !=
+               static_cast<qint64>(rgb.size()))
+        {
+            return false;
+        }
+
+        for(auto i = size_t{0}; i < width * numberOfRows; ++i)
+        {
+            std::copy(rgb.data() + (i * RGB_BYTES_PER_PIXEL), rgb.data() + ((i + 1U) * RGB_BYTES_PER_PIXEL),
+                      rgba.data() + (i * RGBA8888_BYTES_PER_PIXEL));
+            rgba[(i * RGBA8888_BYTES_PER_PIXEL) + 3U] = 255U;
+        }
+
+        return true;
+    }
+
+    QImage band;
+    if(m_clipRect)
+    {
+        QImageReader reader(m_path);
+        reader.setClipRect(QRect(0, static_cast<int>(firstRow), m_size.width(), static_cast<int>(numberOfRows)));
+        band = reader.read();
+    }
+    else
+    {
+        if(m_whole.isNull())
+        {
+            m_whole = QImageReader(m_path).read();
+            m_whole.convertTo(QImage::Format_RGBA8888);
+        }
+        band = m_whole.copy(0, static_cast<int>(firstRow), m_size.width(), static_cast<int>(numberOfRows));
+    }
+
+    if(band.isNull() || band.height() != static_cast<int>(numberOfRows))
+    {
+        return false;
+    }
+
+    band.convertTo(QImage::Format_RGBA8888);
+    for(auto row = 0U; row < numberOfRows; ++row)
+    {
+        const auto* line = band.constScanLine(static_cast<int>(row));
+        std::copy(line, line + rowBytes, rgba.data() + (row * rowBytes));
+    }
+
+    return true;
+}
+
+/**
+ * \brief Reprojects an equirectangular image, such as the Blue Marble, onto the six cubemap faces the engine
+ *        loads. The source is read in bands of rows and the faces are assembled in memory mapped scratch files
+ *        next to the output, so neither has to fit in memory however large the source is.
+ */
+int main(int argc, char* argv[])
+{
+    QCoreApplication application(argc, argv);
+    auto arguments = application.arguments();
+    arguments.removeFirst();
+
+    auto faceSize = 0U;
+    auto bandRows = DEFAULT_BAND_ROWS;
+    auto filter = ReprojectionFilter::Bilinear;
+
+    // Options may appear anywhere, whatever is left are the source and the output folder
+    for(auto i = 0; i < arguments.size();)
+    {
+        if(arguments.at(i) == QStringLiteral("--bicubic"))
+        {
+            filter = ReprojectionFilter::Bicubic;
+            arguments.removeAt(i);
+        }
+        else if(arguments.at(i) == QStringLiteral("--face-size") && i + 1 < arguments.size())
+        {
+            faceSize = arguments.at(i + 1).toUInt();
+            arguments.removeAt(i);
+            arguments.removeAt(i);
+        }
+        else if(arguments.at(i) == QStringLiteral("--band-rows") && i + 1 < arguments.size())
+        {
+            bandRows = arguments.at(i + 1).toUInt();
+            arguments.removeAt(i);
+            arguments.removeAt(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    if(arguments.size() != 2 || bandRows == 0U)
+    {
+        std::fprintf(stderr, "usage: equirect_to_cubemap [--face-size n] [--bicubic] [--band-rows n] "
+                             "<equirectangular image> <output folder>\n");
+        return 1;
+    }
+
+    // Large sources are the point, so lift Qt's decoding allocation limit
+    QImageReader::setAllocationLimit(0);
+
+    BandReader reader;
+    if(!reader.open(arguments.at(0)))
+    {
+        std::fprintf(stderr, "could not read %s\n", qPrintable(arguments.at(0)));
+        return 1;
+    }
+
+    const auto sourceWidth = static_cast<uint32_t>(reader.size().width());
+    const auto sourceHeight = static_cast<uint32_t>(reader.size().height());
+
+    // A face spans a quarter of the equator, which keeps the texel density of the source there
+    if(faceSize == 0U)
+    {
+        faceSize = qMax(sourceWidth / 4U, 1U);
+    }
+
+    if(!reader.streams())
+    {
+        std::fprintf(stderr, "%s cannot be decoded in bands and will be read whole, convert it to a binary PPM "
+                             "to stream it\n", qPrintable(arguments.at(0)));
+    }
+
+    const QDir output(arguments.at(1));
+    if(!output.exists() && !QDir().mkpath(output.path()))
+    {
+        std::fprintf(stderr, "could not create %s\n", qPrintable(output.path()));
+        return 1;
+    }
+
+    const auto faceBytes = static_cast<qint64>(faceSize) * faceSize * RGBA8888_BYTES_PER_PIXEL;
+
+    std::array<std::unique_ptr<QTemporaryFile>, CUBE_MAP_PROJECTION_FACES> scratch;
+    std::array<uint8_t*, CUBE_MAP_PROJECTION_FACES> faces;
+
+    for(auto face = 0U; face < CUBE_MAP_PROJECTION_FACES; ++face)
+    {
+        scratch[face] = std::make_unique<QTemporaryFile>(output.filePath(QStringLiteral("%1.XXXXXX.rgba")
+                                                                         .arg(QString::fromLatin1(CUBE_MAP_FACE_NAMES[face]))));
+        faces[face] = nullptr;
+
+        if(scratch[face]->open() && scratch[face]->resize(faceBytes))
+        {
+            faces[face] = scratch[face]->map(0, faceBytes);
+        }
+
+        if(faces[face] == nullptr)
+        {
+            std::fprintf(stderr, "could not map a %lld byte scratch file in %s\n", static_cast<long long>(faceBytes),
+                         qPrintable(output.path()));
+            return 1;
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    const CubeMapReprojector reprojector(sourceWidth, sourceHeight, faceSize, filter);
+    std::vector<uint8_t> rows;
+
+    for(auto firstOwnedRow = 0U; firstOwnedRow < sourceHeight; firstOwnedRow += bandRows)
+    {
+        auto band = reprojector.band(firstOwnedRow, qMin(firstOwnedRow + bandRows, sourceHeight));
+        if(!reader.read(band.firstRow, band.numberOfRows, rows))
+        {
+            std::fprintf(stderr, "could not read rows %u to %u of %s\n", band.firstRow,
+                         band.firstRow + band.numberOfRows, qPrintable(arguments.at(0)));
+            return 1;
+        }
+
+        band.rgba = rows.data();
+        reprojector.reprojectBand(band, faces);
+    }
+
+    const auto reprojectionTime = timer.restart();
+
+    for(auto face = 0U; face < CUBE_MAP_PROJECTION_FACES; ++face)
+    {
+        const QImage image(faces[face], static_cast<int>(faceSize), static_cast<int>(faceSize),
+                           static_cast<qsizetype>(faceSize) * RGBA8888_BYTES_PER_PIXEL, QImage::Format_RGBA8888);
+
+        const auto path = output.filePath(QString::fromLatin1(CUBE_MAP_FACE_NAMES[face]));
+        if(!image.save(path))
+        {
+            std::fprintf(stderr, "could not write %s\n", qPrintable(path));
+            return 1;
+        }
+    }
+
+    std::printf("%ux%u source to %ux%u faces (%s) in %lld ms, encoded in %lld ms\n", sourceWidth, sourceHeight,
+                faceSize, faceSize, (filter == ReprojectionFilter::Bicubic) ? "bicubic" : "bilinear",
+                static_cast<long long>(reprojectionTime), static_cast<long long>(timer.elapsed()));
+
+    return 0;
+}
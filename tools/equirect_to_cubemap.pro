@@ -0,0 +1,17 @@
+QT       += core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = equirect_to_cubemap
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    equirect_to_cubemap.cpp \
+    ../cubemapprojection.cpp \
+    ../taskscheduler.cpp
+
+HEADERS += \
+    ../cubemapprojection.h \
+    ../taskscheduler.h
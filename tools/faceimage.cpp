@@ -0,0 +1,35 @@
+#include "faceimage.h"
+
+#include <algorithm>
+#include <QImage>
+
+namespace
+{
+    constexpr auto RGBA8888_BYTES_PER_PIXEL = 4U;
+}
+
+/**
+ * \brief Loads a cubemap face image and converts it to tightly packed RGBA8888. Returns an empty vector, leaving
+ *        size untouched, if the image can't be read.
+ */
+std::vector<uint8_t> loadFaceImage(const QString& path, QSize& size)
+{
+    QImage image(path);
+    if(image.isNull())
+    {
+        return {};
+    }
+
+    image.convertTo(QImage::Format_RGBA8888);
+    size = image.size();
+
+    const auto rowBytes = static_cast<size_t>(image.width()) * RGBA8888_BYTES_PER_PIXEL;
+
+    std::vector<uint8_t> texels(rowBytes * image.height());
+    for(auto row = 0; row < image.height(); ++row)
+    {
+        std::copy(image.constScanLine(row), image.constScanLine(row) + rowBytes, texels.data() + (row * rowBytes));
+    }
+
+    return texels;
+}
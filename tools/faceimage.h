@@ -0,0 +1,11 @@
+#ifndef FACEIMAGE_H
+#define FACEIMAGE_H
+
+#include <cstdint>
+#include <vector>
+#include <QSize>
+#include <QString>
+
+std::vector<uint8_t> loadFaceImage(const QString& path, QSize& size);
+
+#endif // FACEIMAGE_H
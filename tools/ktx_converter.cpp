@@ -0,0 +1,99 @@
+#include "faceimage.h"
+#include "ktxcubemap.h"
+#include "mipchain.h"
+#include "taskscheduler.h"
+#include "texturecompression.h"
+
+#include <cstdio>
+#include <QCoreApplication>
+
+namespace
+{
+    constexpr auto RGBA8888_BYTES_PER_PIXEL = 4U;
+}
+
+/**
+ * \brief Converts six cubemap face images into a BC1 compressed KTX file with a full mip chain, so the engine
+ *        can upload it with no decoding at startup. The faces are given in the order +X, -X, +Y, -Y, +Z, -Z.
+ */
+int main(int argc, char* argv[])
+{
+    QCoreApplication application(argc, argv);
+    const auto arguments = application.arguments();
+
+    if(arguments.size() != static_cast<int>(KTX_CUBE_MAP_FACES) + 2)
+    {
+        std::fprintf(stderr, "usage: ktx_converter <+x> <-x> <+y> <-y> <+z> <-z> <output.ktx>\n");
+        return 1;
+    }
+
+    std::array<std::vector<uint8_t>, KTX_CUBE_MAP_FACES> faces;
+    std::array<QSize, KTX_CUBE_MAP_FACES> sizes;
+
+    TaskScheduler::instance().parallelFor(0U, KTX_CUBE_MAP_FACES, 1U, [&](const uint32_t first, const uint32_t last)
+    {
+        for(auto face = first; face < last; ++face)
+        {
+            faces[face] = loadFaceImage(arguments.at(face + 1), sizes[face]);
+        }
+    });
+
+    for(auto face = 0U; face < KTX_CUBE_MAP_FACES; ++face)
+    {
+        if(faces[face].empty() || sizes[face] != sizes[0])
+        {
+            std::fprintf(stderr, "%s is missing or not the same size as the first face\n",
+                         qPrintable(arguments.at(face + 1)));
+            return 1;
+        }
+    }
+
+    const auto width = static_cast<uint32_t>(sizes[0].width());
+    const auto height = static_cast<uint32_t>(sizes[0].height());
+
+    const auto numberOfLevels = mipLevelCount(width, height);
+    auto uncompressedBytes = 0ULL;
+
+    std::vector<KtxCubeMapLevel> levels(numberOfLevels);
+
+    // Each face builds its own gamma-correct mip chain and compresses every level of it
+    TaskScheduler::instance().parallelFor(0U, KTX_CUBE_MAP_FACES, 1U, [&](const uint32_t first, const uint32_t last)
+    {
+        for(auto face = first; face < last; ++face)
+        {
+            const auto chain = generateMipChain(faces[face].data(), width, height);
+            levels[0][face] = compressBc1(faces[face].data(), width, height);
+
+            for(auto level = 1U; level < numberOfLevels; ++level)
+            {
+                levels[level][face] = compressBc1(chain[level - 1U].data(),
+                                                  qMax(width >> level, 1U),
+                                                  qMax(height >> level, 1U));
+            }
+        }
+    });
+
+    for(auto level = 0U; level < numberOfLevels; ++level)
+    {
+        uncompressedBytes += static_cast<uint64_t>(qMax(width >> level, 1U)) * qMax(height >> level, 1U) *
+                             RGBA8888_BYTES_PER_PIXEL * KTX_CUBE_MAP_FACES;
+    }
+
+    const auto& output = arguments.at(KTX_CUBE_MAP_FACES + 1);
+    if(!writeKtxCubeMap(output, KTX_FORMAT_BC1, width, height, levels))
+    {
+        std::fprintf(stderr, "could not write %s\n", qPrintable(output));
+        return 1;
+    }
+
+    auto compressedBytes = 0ULL;
+    for(const auto& level : levels)
+    {
+        compressedBytes += level[0].size() * KTX_CUBE_MAP_FACES;
+    }
+
+    std::printf("%ux%u, %zu mip levels: %.1f MB as RGBA8, %.1f MB as BC1\n", width, height, levels.size(),
+                uncompressedBytes / (1024.0 * 1024.0), compressedBytes / (1024.0 * 1024.0));
+
+    return 0;
+}
@@ -0,0 +1,23 @@
+QT       += core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = ktx_converter
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    faceimage.cpp \
+    ktx_converter.cpp \
+    ../ktxcubemap.cpp \
+    ../mipchain.cpp \
+    ../taskscheduler.cpp \
+    ../texturecompression.cpp
+
+HEADERS += \
+    faceimage.h \
+    ../ktxcubemap.h \
+    ../mipchain.h \
+    ../taskscheduler.h \
+    ../texturecompression.h
@@ -0,0 +1,112 @@
+#include "faceimage.h"
+#include "ktxcubemap.h"
+#include "mipchain.h"
+#include "taskscheduler.h"
+#include "tilepack.h"
+
+#include <cstdio>
+#include <QCoreApplication>
+#include <QFileInfo>
+
+namespace
+{
+    constexpr auto DEFAULT_TILE_SIZE = 128U;
+}
+
+/**
+ * \brief Cuts six cubemap face images into a tile pack for the virtual texture. Every level of the pyramid comes
+ *        from the gamma-correct mip chain of the faces, which are given in the order +X, -X, +Y, -Y, +Z, -Z.
+ */
+int main(int argc, char* argv[])
+{
+    QCoreApplication application(argc, argv);
+    auto arguments = application.arguments();
+    arguments.removeFirst();
+
+    auto tileSize = DEFAULT_TILE_SIZE;
+    auto encoding = TilePackEncoding::Raw;
+
+    // Options may appear anywhere, whatever is left are the faces and the output
+    for(auto i = 0; i < arguments.size();)
+    {
+        if(arguments.at(i) == QStringLiteral("--deflate"))
+        {
+            encoding = TilePackEncoding::Deflate;
+            arguments.removeAt(i);
+        }
+        else if(arguments.at(i) == QStringLiteral("--tile-size") && i + 1 < arguments.size())
+        {
+            tileSize = arguments.at(i + 1).toUInt();
+            arguments.removeAt(i);
+            arguments.removeAt(i);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    if(arguments.size() != static_cast<int>(KTX_CUBE_MAP_FACES) + 1 || tileSize == 0U)
+    {
+        std::fprintf(stderr, "usage: tilepack_builder [--tile-size n] [--deflate] <+x> <-x> <+y> <-y> <+z> <-z> "
+                             "<output.tilepack>\n");
+        return 1;
+    }
+
+    std::array<std::vector<uint8_t>, KTX_CUBE_MAP_FACES> faces;
+    std::array<QSize, KTX_CUBE_MAP_FACES> sizes;
+
+    TaskScheduler::instance().parallelFor(0U, KTX_CUBE_MAP_FACES, 1U, [&](const uint32_t first, const uint32_t last)
+    {
+        for(auto face = first; face < last; ++face)
+        {
+            faces[face] = loadFaceImage(arguments.at(face), sizes[face]);
+        }
+    });
+
+    for(auto face = 0U; face < KTX_CUBE_MAP_FACES; ++face)
+    {
+        if(faces[face].empty() || sizes[face] != sizes[0])
+        {
+            std::fprintf(stderr, "%s is missing or not the same size as the first face\n",
+                         qPrintable(arguments.at(face)));
+            return 1;
+        }
+    }
+
+    const auto width = static_cast<uint32_t>(sizes[0].width());
+    const auto height = static_cast<uint32_t>(sizes[0].height());
+    const auto numberOfLevels = mipLevelCount(width, height);
+
+    std::vector<KtxCubeMapLevel> levels(numberOfLevels);
+
+    TaskScheduler::instance().parallelFor(0U, KTX_CUBE_MAP_FACES, 1U, [&](const uint32_t first, const uint32_t last)
+    {
+        for(auto face = first; face < last; ++face)
+        {
+            auto chain = generateMipChain(faces[face].data(), width, height);
+            levels[0][face] = std::move(faces[face]);
+
+            for(auto level = 1U; level < numberOfLevels; ++level)
+            {
+                levels[level][face] = std::move(chain[level - 1U]);
+            }
+        }
+    });
+
+    const CubeMapTileSource source(std::move(levels), width, height, tileSize);
+
+    const auto& output = arguments.at(KTX_CUBE_MAP_FACES);
+    if(!writeTilePack(output, source, encoding))
+    {
+        std::fprintf(stderr, "could not write %s\n", qPrintable(output));
+        return 1;
+    }
+
+    std::printf("%ux%u faces, %u x %u texel tiles, %u levels, %llu tiles: %.1f MB\n", width, height, tileSize,
+                tileSize, source.numberOfLevels(),
+                static_cast<unsigned long long>(KTX_CUBE_MAP_FACES * tilePackTilesPerFace(source.numberOfLevels())),
+                QFileInfo(output).size() / (1024.0 * 1024.0));
+
+    return 0;
+}
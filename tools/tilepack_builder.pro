@@ -0,0 +1,25 @@
+QT       += core gui
+
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = tilepack_builder
+
+INCLUDEPATH += ..
+
+SOURCES += \
+    faceimage.cpp \
+    tilepack_builder.cpp \
+    ../ktxcubemap.cpp \
+    ../mipchain.cpp \
+    ../taskscheduler.cpp \
+    ../tilepack.cpp \
+    ../tilesource.cpp
+
+HEADERS += \
+    faceimage.h \
+    ../ktxcubemap.h \
+    ../mipchain.h \
+    ../taskscheduler.h \
+    ../tilepack.h \
+    ../tilesource.h
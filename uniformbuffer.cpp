@@ -0,0 +1,108 @@
+#include "uniformbuffer.h"
+
+#include <cstring>
+#include <QDebug>
+#include <QOpenGLContext>
+#include <QOpenGLExtraFunctions>
+
+/**
+ * \brief Standard constructor for the UniformBuffer, no OpenGL initialization is done until create()
+ */
+UniformBuffer::UniformBuffer() :
+    m_buffer{0},
+    m_contents{},
+    m_hasContents{false}
+{
+
+}
+
+/**
+ * \brief The context the buffer was created in must be current
+ */
+UniformBuffer::~UniformBuffer()
+{
+    destroy();
+}
+
+/**
+ * \brief Allocates a buffer of the given size and binds it to the binding point, where it stays. Returns false if
+ *        the buffer could not be created.
+ */
+bool UniformBuffer::create(const GLuint bindingPoint, const uint32_t size)
+{
+    // Make sure that a context has been created prior to calling this function
+    Q_ASSERT(QOpenGLContext::currentContext() != nullptr);
+
+    destroy();
+
+    auto* functions = QOpenGLContext::currentContext()->extraFunctions();
+
+    functions->glGenBuffers(1, &m_buffer);
+    if(m_buffer == 0)
+    {
+        qDebug() << "Unable to create a uniform buffer";
+        return false;
+    }
+
+    functions->glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    functions->glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+    functions->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    functions->glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, m_buffer);
+
+    m_contents.assign(size, 0U);
+    m_hasContents = false;
+
+    return true;
+}
+
+/**
+ * \brief Deletes the buffer, if there is one
+ */
+void UniformBuffer::destroy()
+{
+    if(m_buffer == 0 || QOpenGLContext::currentContext() == nullptr)
+    {
+        return;
+    }
+
+    QOpenGLContext::currentContext()->functions()->glDeleteBuffers(1, &m_buffer);
+
+    m_buffer = 0;
+    m_contents.clear();
+    m_hasContents = false;
+}
+
+/**
+ * \brief Returns true once create() has made the buffer and until destroy() deletes it
+ */
+bool UniformBuffer::isCreated() const
+{
+    return m_buffer != 0;
+}
+
+/**
+ * \brief Replaces the contents of the buffer with the given data. Nothing is uploaded if the data is what the buffer
+ *        already holds.
+ */
+void UniformBuffer::update(const void* data, const uint32_t size)
+{
+    Q_ASSERT(size == m_contents.size());
+
+    if(m_buffer == 0)
+    {
+        return;
+    }
+
+    if(m_hasContents && std::memcmp(m_contents.data(), data, size) == 0)
+    {
+        return;
+    }
+
+    std::memcpy(m_contents.data(), data, size);
+    m_hasContents = true;
+
+    auto* functions = QOpenGLContext::currentContext()->functions();
+    functions->glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+    functions->glBufferSubData(GL_UNIFORM_BUFFER, 0, size, data);
+    functions->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,46 @@
+#ifndef UNIFORMBUFFER_H
+#define UNIFORMBUFFER_H
+
+#include <cstdint>
+#include <vector>
+#include <QOpenGLFunctions>
+
+// Binding point of the FrameUniforms block, every program's block is pointed at it with bindUniformBlock()
+constexpr auto FRAME_UNIFORMS_BINDING = 0U;
+constexpr auto FRAME_UNIFORMS_BLOCK_NAME = "FrameUniforms";
+
+/**
+ * \brief Data that changes once per frame and is the same for every program drawing it. Laid out to match the
+ *        std140 FrameUniforms block declared by the shaders, so members must stay 16 byte aligned.
+ */
+struct FrameUniforms
+{
+    float modelViewProjection[16]; // column major, as QMatrix4x4::constData() gives it
+};
+
+/**
+ * \brief A uniform buffer kept bound to one binding point, which every program with a block pointed at that
+ *        point reads from. Only contents that differ from the last update are uploaded.
+ */
+class UniformBuffer
+{
+public:
+    UniformBuffer();
+    ~UniformBuffer();
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    bool create(GLuint bindingPoint, uint32_t size);
+    void destroy();
+
+    bool isCreated() const;
+    void update(const void* data, uint32_t size);
+
+private:
+    GLuint m_buffer;
+    std::vector<uint8_t> m_contents;
+    bool m_hasContents;
+};
+
+#endif // UNIFORMBUFFER_H
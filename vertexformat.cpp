@@ -0,0 +1,157 @@
+#include "vertexformat.h"
+
+#include <cmath>
+#include <QtGlobal>
+
+namespace
+{
+    constexpr auto COMPONENTS_PER_VERTEX = 3U;
+    constexpr auto COMPONENTS_PER_ENCODED_VERTEX = 2U;
+
+    constexpr auto SNORM16_SCALE = 32767.0f;
+}
+
+/**
+ * \brief Sign function that treats zero as positive. The octahedral fold must send +0 and -0 the same way.
+ */
+static float sign_not_zero(const float value)
+{
+    return (value >= 0.0f) ? 1.0f : -1.0f;
+}
+
+/**
+ * \brief Maps a 16-bit snorm value back to [-1, 1] the same way OpenGL does for normalized attributes
+ */
+static float snorm16_to_float(const int16_t value)
+{
+    return qMax(static_cast<float>(value) / SNORM16_SCALE, -1.0f);
+}
+
+/**
+ * \brief Angle between a unit vector and the decoded form of a candidate encoding
+ */
+static float angular_error(const float* vertex, const int16_t* encoded)
+{
+    float decoded[COMPONENTS_PER_VERTEX];
+    decodeOctahedral(encoded, decoded);
+
+    // acos() loses everything below about 1e-4 radians in float, so use the cross/dot form in double instead
+    const double crossX = (static_cast<double>(vertex[1]) * decoded[2]) - (static_cast<double>(vertex[2]) * decoded[1]);
+    const double crossY = (static_cast<double>(vertex[2]) * decoded[0]) - (static_cast<double>(vertex[0]) * decoded[2]);
+    const double crossZ = (static_cast<double>(vertex[0]) * decoded[1]) - (static_cast<double>(vertex[1]) * decoded[0]);
+    const double dot = (static_cast<double>(vertex[0]) * decoded[0]) +
+                       (static_cast<double>(vertex[1]) * decoded[1]) +
+                       (static_cast<double>(vertex[2]) * decoded[2]);
+
+    return static_cast<float>(std::atan2(std::sqrt((crossX * crossX) + (crossY * crossY) + (crossZ * crossZ)), dot));
+}
+
+/**
+ * \brief Encodes every vertex of an xyz float buffer as an octahedral unit vector. The vertices must lie on the
+ *        unit sphere. Of the four snorm values surrounding the exact projection the one that decodes closest
+ *        to the original is kept, which roughly halves the error of plain rounding.
+ */
+std::vector<int16_t> encodeOctahedral(const std::vector<float>& vertices)
+{
+    const auto numberOfVertices = vertices.size() / COMPONENTS_PER_VERTEX;
+
+    std::vector<int16_t> encoded(numberOfVertices * COMPONENTS_PER_ENCODED_VERTEX);
+
+    for(auto v = 0UL; v < numberOfVertices; ++v)
+    {
+        const auto* vertex = &vertices[v * COMPONENTS_PER_VERTEX];
+
+        // Project onto the octahedron |x| + |y| + |z| = 1, then fold the lower half over the upper one
+        const auto l1Norm = std::fabs(vertex[0]) + std::fabs(vertex[1]) + std::fabs(vertex[2]);
+        auto u = vertex[0] / l1Norm;
+        auto w = vertex[1] / l1Norm;
+
+        if(vertex[2] < 0.0f)
+        {
+            const auto foldedU = (1.0f - std::fabs(w)) * sign_not_zero(u);
+            const auto foldedW = (1.0f - std::fabs(u)) * sign_not_zero(w);
+            u = foldedU;
+            w = foldedW;
+        }
+
+        const auto floorU = std::floor(qBound(-1.0f, u, 1.0f) * SNORM16_SCALE);
+        const auto floorW = std::floor(qBound(-1.0f, w, 1.0f) * SNORM16_SCALE);
+
+        auto bestError = -1.0f;
+        for(auto corner = 0U; corner < 4U; ++corner)
+        {
+            const int16_t candidate[COMPONENTS_PER_ENCODED_VERTEX] =
+            {
+                static_cast<int16_t>(qBound(-SNORM16_SCALE, floorU + (corner & 1U), SNORM16_SCALE)),
+                static_cast<int16_t>(qBound(-SNORM16_SCALE, floorW + (corner >> 1U), SNORM16_SCALE))
+            };
+
+            const auto error = angular_error(vertex, candidate);
+            if(bestError < 0.0f || error < bestError)
+            {
+                bestError = error;
+                encoded[(v * COMPONENTS_PER_ENCODED_VERTEX) + 0U] = candidate[0];
+                encoded[(v * COMPONENTS_PER_ENCODED_VERTEX) + 1U] = candidate[1];
+            }
+        }
+    }
+
+    return encoded;
+}
+
+/**
+ * \brief CPU version of the decoder in cube-map.vert. Writes a normalized xyz vector.
+ */
+void decodeOctahedral(const int16_t* encoded, float* decoded)
+{
+    const auto u = snorm16_to_float(encoded[0]);
+    const auto w = snorm16_to_float(encoded[1]);
+
+    auto x = u;
+    auto y = w;
+    const auto z = 1.0f - std::fabs(u) - std::fabs(w);
+
+    if(z < 0.0f)
+    {
+        x = (1.0f - std::fabs(w)) * sign_not_zero(u);
+        y = (1.0f - std::fabs(u)) * sign_not_zero(w);
+    }
+
+    const auto length = std::sqrt((x * x) + (y * y) + (z * z));
+
+    decoded[0] = x / length;
+    decoded[1] = y / length;
+    decoded[2] = z / length;
+}
+
+/**
+ * \brief Measures what the octahedral encoding costs in accuracy and saves in memory
+ */
+VertexEncodingReport octahedralEncodingReport(const std::vector<float>& vertices, const std::vector<int16_t>& encoded)
+{
+    const auto numberOfVertices = vertices.size() / COMPONENTS_PER_VERTEX;
+    Q_ASSERT(encoded.size() == numberOfVertices * COMPONENTS_PER_ENCODED_VERTEX);
+
+    VertexEncodingReport report;
+    report.bytesBefore = static_cast<uint32_t>(vertices.size() * sizeof(float));
+    report.bytesAfter = static_cast<uint32_t>(encoded.size() * sizeof(int16_t));
+    report.maximumAngularError = 0.0f;
+    report.meanAngularError = 0.0f;
+
+    auto totalError = 0.0;
+    for(auto v = 0UL; v < numberOfVertices; ++v)
+    {
+        const auto error = angular_error(&vertices[v * COMPONENTS_PER_VERTEX],
+                                         &encoded[v * COMPONENTS_PER_ENCODED_VERTEX]);
+
+        report.maximumAngularError = qMax(report.maximumAngularError, error);
+        totalError += error;
+    }
+
+    if(numberOfVertices > 0UL)
+    {
+        report.meanAngularError = static_cast<float>(totalError / numberOfVertices);
+    }
+
+    return report;
+}
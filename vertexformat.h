@@ -0,0 +1,32 @@
+#ifndef VERTEXFORMAT_H
+#define VERTEXFORMAT_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * \brief Encodings the planet mesh can be uploaded in. The values are passed to cube-map.vert as is.
+ */
+enum class VertexFormat : int32_t
+{
+    Float32 = 0,         // Three 32-bit floats, 12 bytes per vertex
+    Octahedral16 = 1,    // Unit vector folded onto an octahedron, two 16-bit snorm values, 4 bytes per vertex
+    InstancedPatch = 2,  // Chunks only, one shared grid patch placed and projected per instance by the shader
+    Procedural = 3,      // Nothing uploaded, positions are built from gl_VertexID, gl_InstanceID and the subdivisions
+    ProceduralEdges = 4  // Same as Procedural, laid out as the wireframe's line list
+};
+
+struct VertexEncodingReport
+{
+    uint32_t bytesBefore;
+    uint32_t bytesAfter;
+    float maximumAngularError; // radians
+    float meanAngularError;    // radians
+};
+
+std::vector<int16_t> encodeOctahedral(const std::vector<float>& vertices);
+void decodeOctahedral(const int16_t* encoded, float* decoded);
+
+VertexEncodingReport octahedralEncodingReport(const std::vector<float>& vertices, const std::vector<int16_t>& encoded);
+
+#endif // VERTEXFORMAT_H
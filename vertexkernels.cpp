@@ -0,0 +1,250 @@
+#include "vertexkernels.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define VERTEX_KERNELS_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 instructions inside functions that opt in. MSVC allows intrinsics anywhere.
+#if defined(__GNUC__) || defined(__clang__)
+#define VERTEX_KERNEL_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define VERTEX_KERNEL_TARGET_AVX2
+#endif
+
+namespace
+{
+    using RowKernel = void (*)(const float*, const float*, float, uint32_t, float*);
+
+    struct KernelSelection
+    {
+        RowKernel kernel;
+        const char* name;
+    };
+}
+
+/**
+ * \brief Portable kernel, also used for the tail of each row by the vector kernels. Computes the grid points
+ *        rowStart + columnAxis * (j * step) for j in [first, count) and writes them normalized as xyz triples.
+ */
+static void project_row_scalar_from(const float* rowStart,
+                                    const float* columnAxis,
+                                    const float step,
+                                    const uint32_t first,
+                                    const uint32_t count,
+                                    float* output)
+{
+    for(auto j = first; j < count; ++j)
+    {
+        const auto s = static_cast<float>(j) * step;
+        const auto x = rowStart[0] + (columnAxis[0] * s);
+        const auto y = rowStart[1] + (columnAxis[1] * s);
+        const auto z = rowStart[2] + (columnAxis[2] * s);
+
+        const auto inverseLength = 1.0f / std::sqrt((x * x) + (y * y) + (z * z));
+
+        output[(j * 3U) + 0U] = x * inverseLength;
+        output[(j * 3U) + 1U] = y * inverseLength;
+        output[(j * 3U) + 2U] = z * inverseLength;
+    }
+}
+
+#ifndef VERTEX_KERNELS_X86
+
+/**
+ * \brief Scalar entry point with the same signature as the vector kernels
+ */
+static void project_row_scalar(const float* rowStart,
+                               const float* columnAxis,
+                               const float step,
+                               const uint32_t count,
+                               float* output)
+{
+    project_row_scalar_from(rowStart, columnAxis, step, 0U, count, output);
+}
+
+#endif
+
+#ifdef VERTEX_KERNELS_X86
+
+/**
+ * \brief Interleaves four x, four y and four z values into four xyz triples and stores them unaligned
+ */
+static inline void store_xyz_sse(const __m128 x, const __m128 y, const __m128 z, float* output)
+{
+    const auto xy = _mm_unpacklo_ps(x, y);      // x0 y0 x1 y1
+    const auto zxLow = _mm_unpacklo_ps(z, x);   // z0 x0 z1 x1
+    const auto yzLow = _mm_unpacklo_ps(y, z);   // y0 z0 y1 z1
+    const auto xyHigh = _mm_unpackhi_ps(x, y);  // x2 y2 x3 y3
+    const auto zxHigh = _mm_unpackhi_ps(z, x);  // z2 x2 z3 x3
+    const auto yzHigh = _mm_unpackhi_ps(y, z);  // y2 z2 y3 z3
+
+    _mm_storeu_ps(output + 0, _mm_shuffle_ps(xy, zxLow, _MM_SHUFFLE(3, 0, 1, 0)));      // x0 y0 z0 x1
+    _mm_storeu_ps(output + 4, _mm_shuffle_ps(yzLow, xyHigh, _MM_SHUFFLE(1, 0, 3, 2)));  // y1 z1 x2 y2
+    _mm_storeu_ps(output + 8, _mm_shuffle_ps(zxHigh, yzHigh, _MM_SHUFFLE(3, 2, 3, 0))); // z2 x3 y3 z3
+}
+
+/**
+ * \brief Four points per iteration. SSE2 is part of the x86-64 baseline so this kernel is always available there.
+ */
+static void project_row_sse(const float* rowStart,
+                            const float* columnAxis,
+                            const float step,
+                            const uint32_t count,
+                            float* output)
+{
+    const auto startX = _mm_set1_ps(rowStart[0]);
+    const auto startY = _mm_set1_ps(rowStart[1]);
+    const auto startZ = _mm_set1_ps(rowStart[2]);
+    const auto axisX = _mm_set1_ps(columnAxis[0]);
+    const auto axisY = _mm_set1_ps(columnAxis[1]);
+    const auto axisZ = _mm_set1_ps(columnAxis[2]);
+    const auto stepVector = _mm_set1_ps(step);
+    const auto one = _mm_set1_ps(1.0f);
+
+    auto column = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+    const auto columnIncrement = _mm_set1_ps(4.0f);
+
+    auto j = 0U;
+    for(; j + 4U <= count; j += 4U)
+    {
+        const auto s = _mm_mul_ps(column, stepVector);
+        const auto x = _mm_add_ps(startX, _mm_mul_ps(axisX, s));
+        const auto y = _mm_add_ps(startY, _mm_mul_ps(axisY, s));
+        const auto z = _mm_add_ps(startZ, _mm_mul_ps(axisZ, s));
+
+        const auto lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+        const auto inverseLength = _mm_div_ps(one, _mm_sqrt_ps(lengthSquared));
+
+        store_xyz_sse(_mm_mul_ps(x, inverseLength),
+                      _mm_mul_ps(y, inverseLength),
+                      _mm_mul_ps(z, inverseLength),
+                      output + (j * 3U));
+
+        column = _mm_add_ps(column, columnIncrement);
+    }
+
+    project_row_scalar_from(rowStart, columnAxis, step, j, count, output);
+}
+
+/**
+ * \brief Eight points per iteration. The results are interleaved as two halves with the SSE store.
+ */
+VERTEX_KERNEL_TARGET_AVX2
+static void project_row_avx2(const float* rowStart,
+                             const float* columnAxis,
+                             const float step,
+                             const uint32_t count,
+                             float* output)
+{
+    const auto startX = _mm256_set1_ps(rowStart[0]);
+    const auto startY = _mm256_set1_ps(rowStart[1]);
+    const auto startZ = _mm256_set1_ps(rowStart[2]);
+    const auto axisX = _mm256_set1_ps(columnAxis[0]);
+    const auto axisY = _mm256_set1_ps(columnAxis[1]);
+    const auto axisZ = _mm256_set1_ps(columnAxis[2]);
+    const auto stepVector = _mm256_set1_ps(step);
+    const auto one = _mm256_set1_ps(1.0f);
+
+    auto column = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+    const auto columnIncrement = _mm256_set1_ps(8.0f);
+
+    auto j = 0U;
+    for(; j + 8U <= count; j += 8U)
+    {
+        const auto s = _mm256_mul_ps(column, stepVector);
+        const auto x = _mm256_add_ps(startX, _mm256_mul_ps(axisX, s));
+        const auto y = _mm256_add_ps(startY, _mm256_mul_ps(axisY, s));
+        const auto z = _mm256_add_ps(startZ, _mm256_mul_ps(axisZ, s));
+
+        const auto lengthSquared = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)),
+                                                 _mm256_mul_ps(z, z));
+        const auto inverseLength = _mm256_div_ps(one, _mm256_sqrt_ps(lengthSquared));
+
+        const auto normalX = _mm256_mul_ps(x, inverseLength);
+        const auto normalY = _mm256_mul_ps(y, inverseLength);
+        const auto normalZ = _mm256_mul_ps(z, inverseLength);
+
+        store_xyz_sse(_mm256_castps256_ps128(normalX),
+                      _mm256_castps256_ps128(normalY),
+                      _mm256_castps256_ps128(normalZ),
+                      output + (j * 3U));
+        store_xyz_sse(_mm256_extractf128_ps(normalX, 1),
+                      _mm256_extractf128_ps(normalY, 1),
+                      _mm256_extractf128_ps(normalZ, 1),
+                      output + ((j + 4U) * 3U));
+
+        column = _mm256_add_ps(column, columnIncrement);
+    }
+
+    project_row_scalar_from(rowStart, columnAxis, step, j, count, output);
+}
+
+/**
+ * \brief Runtime check for AVX2, including the operating system saving the upper halves of the registers
+ */
+static bool cpu_supports_avx2()
+{
+#if defined(_MSC_VER) && !defined(__clang__)
+    int registers[4];
+
+    __cpuid(registers, 1);
+    const auto osSavesAvxState = (registers[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+
+    __cpuidex(registers, 7, 0);
+    return osSavesAvxState && (registers[1] & (1 << 5)) != 0;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif // VERTEX_KERNELS_X86
+
+/**
+ * \brief Picks the widest kernel the CPU supports. Done once, on first use.
+ */
+static const KernelSelection& selected_kernel()
+{
+    static const KernelSelection selection = []() -> KernelSelection
+    {
+#ifdef VERTEX_KERNELS_X86
+        if(cpu_supports_avx2())
+        {
+            return { project_row_avx2, "AVX2" };
+        }
+
+        return { project_row_sse, "SSE2" };
+#else
+        return { project_row_scalar, "Scalar" };
+#endif
+    }();
+
+    return selection;
+}
+
+/**
+ * \brief Projects one row of a cube face grid onto the unit sphere. Point j of the row is
+ *        rowStart + columnAxis * (j * step), and is written normalized to output[3j .. 3j + 2].
+ */
+void projectRowToSphere(const float* rowStart,
+                        const float* columnAxis,
+                        const float step,
+                        const uint32_t count,
+                        float* output)
+{
+    selected_kernel().kernel(rowStart, columnAxis, step, count, output);
+}
+
+/**
+ * \brief Name of the kernel projectRowToSphere() dispatches to, for logging and benchmarks
+ */
+const char* vertexKernelName()
+{
+    return selected_kernel().name;
+}
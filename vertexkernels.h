@@ -0,0 +1,14 @@
+#ifndef VERTEXKERNELS_H
+#define VERTEXKERNELS_H
+
+#include <cstdint>
+
+void projectRowToSphere(const float* rowStart,
+                        const float* columnAxis,
+                        const float step,
+                        const uint32_t count,
+                        float* output);
+
+const char* vertexKernelName();
+
+#endif // VERTEXKERNELS_H
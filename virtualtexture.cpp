@@ -0,0 +1,659 @@
+#include "virtualtexture.h"
+#include "mipchain.h"
+#include "taskscheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <QtMath>
+#include <QDebug>
+
+namespace
+{
+    constexpr auto RGBA8888_BYTES_PER_PIXEL = 4U;
+
+    // Page table texels hold the atlas slot in 8 bits per axis
+    constexpr auto MAXIMUM_ATLAS_TILES_PER_SIDE = 256U;
+
+    // The page table has a texel per tile of the finest level, 24 MB across the six faces at this depth
+    constexpr auto MAXIMUM_NUMBER_OF_LEVELS = 11U;
+
+    constexpr auto NO_SLOT = UINT32_MAX;
+    constexpr uint8_t PAGE_TABLE_ENTRY_VALID = 255U;
+
+    // Each tile also gets a half size copy in the atlas' second level, so minified tiles are filtered. Its texels
+    // line up with the tiles as long as the bordered tile size is even, past that they would straddle two tiles.
+    constexpr auto ATLAS_MIP_LEVELS = 2U;
+}
+
+/**
+ * \brief Page table texel pointing at the given atlas slot
+ */
+static std::array<uint8_t, 4> page_table_entry(const uint32_t slot, const uint32_t level, const uint32_t tilesPerSide)
+{
+    return { static_cast<uint8_t>(slot % tilesPerSide),
+             static_cast<uint8_t>(slot / tilesPerSide),
+             static_cast<uint8_t>(level),
+             PAGE_TABLE_ENTRY_VALID };
+}
+
+/**
+ * \brief The tile at half size, filtered in linear light like the cubemap's mip chain
+ */
+static std::vector<uint8_t> half_size_tile(const uint8_t* rgba, const uint32_t size)
+{
+    auto levels = generateMipChain(rgba, size, size);
+    return std::move(levels.front());
+}
+
+/**
+ * \brief Constructor for the virtual texture. Purely used for assignment, the OpenGL objects are made in create().
+ */
+VirtualTexture::VirtualTexture(std::unique_ptr<TileSource> source,
+                               const uint32_t atlasTilesPerSide,
+                               const uint32_t uploadsPerFrame) :
+    m_source{std::move(source)},
+    m_atlas(QOpenGLTexture::Target2D), // Constructor is pass through, no OpenGL initialization required
+    m_pageTable(QOpenGLTexture::Target2DArray), // Constructor is pass through, no OpenGL initialization required
+    m_atlasTilesPerSide{qMin(atlasTilesPerSide, MAXIMUM_ATLAS_TILES_PER_SIDE)},
+    m_uploadsPerFrame{uploadsPerFrame},
+    m_borderedTileSize{m_source->tileSize() + (2U * VIRTUAL_TEXTURE_TILE_BORDER)},
+    m_atlasMipLevels{(m_borderedTileSize % 2U == 0U) ? ATLAS_MIP_LEVELS : 1U},
+    m_finestLevel{qBound(1U, m_source->numberOfLevels(), MAXIMUM_NUMBER_OF_LEVELS) - 1U},
+    m_residentTiles(),
+    m_leastRecentlyUsed(),
+    m_freeSlots(),
+    m_requests(),
+    m_requestedKeys(),
+    m_unavailableTiles(),
+    m_mappedTiles(),
+    m_pageTableEntries(),
+    m_pageTableFaceDirty(KTX_CUBE_MAP_FACES, false),
+    m_frameNumber{0},
+    m_hasPendingTiles{false}
+{
+
+}
+
+/**
+ * \brief Destructor for the virtual texture. The context the textures were created in must be current.
+ */
+VirtualTexture::~VirtualTexture()
+{
+    destroy();
+}
+
+/**
+ * \brief Allocates the atlas and page table textures and loads the six level 0 tiles, which every other tile
+ *        falls back to. Returns false if the atlas is too small to hold anything past them or the textures
+ *        could not be created.
+ */
+bool VirtualTexture::create()
+{
+    const auto numberOfSlots = m_atlasTilesPerSide * m_atlasTilesPerSide;
+    if(numberOfSlots <= KTX_CUBE_MAP_FACES)
+    {
+        qDebug() << "The virtual texture atlas needs room for more than the six level 0 tiles";
+        return false;
+    }
+
+    m_atlas.create();
+    m_atlas.setSize(atlasSize(), atlasSize());
+    m_atlas.setFormat(QOpenGLTexture::RGBA8_UNorm);
+    m_atlas.setMipLevels(static_cast<int>(m_atlasMipLevels));
+    m_atlas.allocateStorage();
+    m_atlas.setWrapMode(QOpenGLTexture::ClampToEdge);
+    m_atlas.setMinificationFilter((m_atlasMipLevels > 1U) ? QOpenGLTexture::LinearMipMapLinear
+                                                          : QOpenGLTexture::Linear);
+    m_atlas.setMagnificationFilter(QOpenGLTexture::Linear);
+
+    // Integer texels are read with texelFetch(), so the page table is never filtered
+    m_pageTable.create();
+    m_pageTable.setSize(pageTableSize(), pageTableSize());
+    m_pageTable.setLayers(KTX_CUBE_MAP_FACES);
+    m_pageTable.setFormat(QOpenGLTexture::RGBA8U);
+    m_pageTable.setMipLevels(1);
+    m_pageTable.allocateStorage(QOpenGLTexture::RGBA_Integer, QOpenGLTexture::UInt8);
+    m_pageTable.setWrapMode(QOpenGLTexture::ClampToEdge);
+    m_pageTable.setMinificationFilter(QOpenGLTexture::Nearest);
+    m_pageTable.setMagnificationFilter(QOpenGLTexture::Nearest);
+
+    if(!m_atlas.isCreated() || !m_pageTable.isCreated())
+    {
+        qDebug() << "Could not create the virtual texture";
+        destroy();
+        return false;
+    }
+
+    // Handed out from the back, so the atlas fills up from slot 0
+    m_freeSlots.resize(numberOfSlots);
+    for(auto slot = 0U; slot < numberOfSlots; ++slot)
+    {
+        m_freeSlots[slot] = numberOfSlots - slot - 1U;
+    }
+
+    m_pageTableEntries.assign(static_cast<size_t>(pageTableSize()) * pageTableSize() * RGBA8888_BYTES_PER_PIXEL *
+                              KTX_CUBE_MAP_FACES, 0U);
+
+    const auto tileBytes = static_cast<size_t>(m_borderedTileSize) * m_borderedTileSize * RGBA8888_BYTES_PER_PIXEL;
+    std::vector<uint8_t> texels(tileBytes * KTX_CUBE_MAP_FACES, 0U);
+    std::vector<std::vector<uint8_t>> halfTexels(KTX_CUBE_MAP_FACES);
+
+    TaskScheduler::instance().parallelFor(0U, KTX_CUBE_MAP_FACES, 1U, [&](const uint32_t first, const uint32_t last)
+    {
+        for(auto face = first; face < last; ++face)
+        {
+            if(!m_source->readTile({ face, 0U, 0U, 0U }, texels.data() + (face * tileBytes)))
+            {
+                qDebug() << "Could not read the level 0 tile of cubemap face" << face;
+            }
+
+            if(m_atlasMipLevels > 1U)
+            {
+                halfTexels[face] = half_size_tile(texels.data() + (face * tileBytes), m_borderedTileSize);
+            }
+        }
+    });
+
+    // A face that failed to read stays black rather than leaving the page table pointing nowhere
+    for(auto face = 0U; face < KTX_CUBE_MAP_FACES; ++face)
+    {
+        const TileKey key{ face, 0U, 0U, 0U };
+        makeResident(key, allocateSlot(), texels.data() + (face * tileBytes),
+                     halfTexels[face].empty() ? nullptr : halfTexels[face].data());
+        writePageTable(key);
+    }
+
+    uploadPageTable();
+
+    qDebug() << "Virtual texture atlas:" << atlasSize() << "x" << atlasSize() << "texels," << numberOfSlots
+             << "tiles," << m_finestLevel + 1U << "levels";
+
+    return true;
+}
+
+/**
+ * \brief Frees the textures and forgets every resident tile
+ */
+void VirtualTexture::destroy()
+{
+    m_atlas.destroy();
+    m_pageTable.destroy();
+
+    m_residentTiles.clear();
+    m_leastRecentlyUsed.clear();
+    m_freeSlots.clear();
+    for(auto& keys : m_mappedTiles)
+    {
+        keys.clear();
+    }
+    m_pageTableEntries.clear();
+    m_hasPendingTiles = false;
+}
+
+/**
+ * \brief Starts collecting the requests of a new frame. Tiles that go unrequested become candidates for eviction.
+ */
+void VirtualTexture::beginFrame()
+{
+    ++m_frameNumber;
+
+    m_requests.clear();
+    m_requestedKeys.clear();
+}
+
+/**
+ * \brief Requests the tiles covering the given rectangle of a face, in cubemap face coordinates between 0 and 1.
+ *        The level is the coarsest one that puts at least a texel under each of the pixels the area spans.
+ */
+void VirtualTexture::requestArea(const uint32_t face,
+                                 const QPointF& minimum,
+                                 const QPointF& maximum,
+                                 const float pixelsAcross)
+{
+    const auto areaSize = qMax(maximum.x() - minimum.x(), maximum.y() - minimum.y());
+    if(areaSize <= 0.0)
+    {
+        return;
+    }
+
+    const auto tilesAcrossFace = pixelsAcross / (tileSize() * areaSize);
+    const auto level = (tilesAcrossFace <= 1.0) ? 0U
+                                                : qMin(static_cast<uint32_t>(qCeil(std::log2(tilesAcrossFace))),
+                                                       m_finestLevel);
+
+    const auto tilesPerSide = static_cast<int>(1U << level);
+    const auto firstX = qBound(0, qFloor(minimum.x() * tilesPerSide), tilesPerSide - 1);
+    const auto firstY = qBound(0, qFloor(minimum.y() * tilesPerSide), tilesPerSide - 1);
+    const auto lastX = qBound(firstX, qCeil(maximum.x() * tilesPerSide) - 1, tilesPerSide - 1);
+    const auto lastY = qBound(firstY, qCeil(maximum.y() * tilesPerSide) - 1, tilesPerSide - 1);
+
+    for(auto y = firstY; y <= lastY; ++y)
+    {
+        for(auto x = firstX; x <= lastX; ++x)
+        {
+            request({ face, level, static_cast<uint32_t>(x), static_cast<uint32_t>(y) });
+        }
+    }
+}
+
+/**
+ * \brief Requests a tile along with every ancestor of it, so the atlas holds something to fall back to while
+ *        the tile itself is waiting on the upload budget
+ */
+void VirtualTexture::request(const TileKey& key)
+{
+    for(auto tile = key; ; tile = tile.parent())
+    {
+        // Once a tile is in, so are all of its ancestors
+        if(!m_requestedKeys.insert(tile.key()).second)
+        {
+            return;
+        }
+
+        m_requests.push_back(tile);
+
+        if(tile.level == 0U)
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * \brief Marks the requested tiles that are resident as used this frame and loads up to m_uploadsPerFrame of the
+ *        missing ones, coarsest first. The tiles are read on the task scheduler and then copied into the atlas,
+ *        evicting the least recently requested tiles once it is full.
+ */
+void VirtualTexture::update()
+{
+    std::vector<TileKey> missing;
+
+    for(const auto& key : m_requests)
+    {
+        const auto found = m_residentTiles.find(key.key());
+        if(found == m_residentTiles.end())
+        {
+            if(m_unavailableTiles.count(key.key()) == 0U)
+            {
+                missing.push_back(key);
+            }
+            continue;
+        }
+
+        auto& tile = found->second;
+        tile.lastFrameRequested = m_frameNumber;
+
+        if(key.level > 0U)
+        {
+            m_leastRecentlyUsed.splice(m_leastRecentlyUsed.begin(), m_leastRecentlyUsed, tile.lruPosition);
+        }
+    }
+
+    // Coarse tiles first, which sharpens the view progressively and keeps a tile's ancestors ahead of it
+    std::stable_sort(missing.begin(), missing.end(), [](const TileKey& lhs, const TileKey& rhs)
+    {
+        return lhs.level < rhs.level;
+    });
+
+    std::vector<TileKey> loading;
+    std::vector<uint32_t> slots;
+
+    for(const auto& key : missing)
+    {
+        if(loading.size() == m_uploadsPerFrame)
+        {
+            break;
+        }
+
+        const auto slot = allocateSlot();
+        if(slot == NO_SLOT)
+        {
+            break;
+        }
+
+        loading.push_back(key);
+        slots.push_back(slot);
+    }
+
+    // Without a free slot the atlas is full of tiles in view, and later frames won't do any better
+    m_hasPendingTiles = (loading.size() == m_uploadsPerFrame) && (missing.size() > loading.size());
+
+    const auto tileBytes = static_cast<size_t>(m_borderedTileSize) * m_borderedTileSize * RGBA8888_BYTES_PER_PIXEL;
+    std::vector<uint8_t> texels(tileBytes * loading.size());
+    std::vector<std::vector<uint8_t>> halfTexels(loading.size());
+    std::vector<uint8_t> tileRead(loading.size(), 0U);
+
+    TaskScheduler::instance().parallelFor(0U, static_cast<uint32_t>(loading.size()), 1U,
+                                          [&](const uint32_t first, const uint32_t last)
+    {
+        for(auto i = first; i < last; ++i)
+        {
+            tileRead[i] = m_source->readTile(loading[i], texels.data() + (i * tileBytes)) ? 1U : 0U;
+
+            if(tileRead[i] != 0U && m_atlasMipLevels > 1U)
+            {
+                halfTexels[i] = half_size_tile(texels.data() + (i * tileBytes), m_borderedTileSize);
+            }
+        }
+    });
+
+    for(auto i = 0U; i < loading.size(); ++i)
+    {
+        if(tileRead[i] != 0U)
+        {
+            makeResident(loading[i], slots[i], texels.data() + (i * tileBytes),
+                         halfTexels[i].empty() ? nullptr : halfTexels[i].data());
+        }
+        else
+        {
+            // Leave the ancestor in place rather than asking the source again every frame
+            qDebug() << "Could not read virtual texture tile" << loading[i].face << loading[i].level
+                     << loading[i].x << loading[i].y;
+
+            m_unavailableTiles.insert(loading[i].key());
+            m_freeSlots.push_back(slots[i]);
+        }
+    }
+
+    mapRequestedTiles();
+    uploadPageTable();
+}
+
+/**
+ * \brief Returns true when requested tiles were left for later frames by the upload budget
+ */
+bool VirtualTexture::hasPendingTiles() const
+{
+    return m_hasPendingTiles;
+}
+
+/**
+ * \brief Hands out a free atlas slot, evicting the least recently requested tile if there is none. Returns
+ *        NO_SLOT when every evictable tile was requested this frame.
+ */
+uint32_t VirtualTexture::allocateSlot()
+{
+    if(!m_freeSlots.empty())
+    {
+        const auto slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        return slot;
+    }
+
+    if(m_leastRecentlyUsed.empty())
+    {
+        return NO_SLOT;
+    }
+
+    const auto& tile = m_residentTiles.at(m_leastRecentlyUsed.back());
+    if(tile.lastFrameRequested == m_frameNumber)
+    {
+        return NO_SLOT;
+    }
+
+    const auto slot = tile.slot;
+    evict(tile);
+
+    return slot;
+}
+
+/**
+ * \brief Drops a tile from the atlas. Only tiles that weren't requested this frame are evicted, so
+ *        mapRequestedTiles() points the page table texels that showed it back at a requested ancestor before
+ *        the next draw.
+ */
+void VirtualTexture::evict(const ResidentTile& tile)
+{
+    // The tile is erased below, so keep what's needed of it
+    const auto key = tile.key.key();
+
+    m_leastRecentlyUsed.erase(tile.lruPosition);
+    m_residentTiles.erase(key);
+}
+
+/**
+ * \brief Copies a tile, and its half size copy when the atlas has a second level, into its atlas slot. The page
+ *        table only points at it once it is requested, see mapRequestedTiles().
+ */
+void VirtualTexture::makeResident(const TileKey& key, const uint32_t slot, const uint8_t* rgba, const uint8_t* halfRgba)
+{
+    m_atlas.setData((slot % m_atlasTilesPerSide) * m_borderedTileSize,
+                    (slot / m_atlasTilesPerSide) * m_borderedTileSize,
+                    0,
+                    m_borderedTileSize,
+                    m_borderedTileSize,
+                    1,
+                    QOpenGLTexture::RGBA,
+                    QOpenGLTexture::UInt8,
+                    rgba);
+
+    if(halfRgba != nullptr && m_atlasMipLevels > 1U)
+    {
+        const auto halfSize = m_borderedTileSize / 2U;
+        m_atlas.setData((slot % m_atlasTilesPerSide) * halfSize,
+                        (slot / m_atlasTilesPerSide) * halfSize,
+                        0,
+                        halfSize,
+                        halfSize,
+                        1,
+                        1,
+                        QOpenGLTexture::RGBA,
+                        QOpenGLTexture::UInt8,
+                        halfRgba);
+    }
+
+    ResidentTile tile{ key, slot, m_frameNumber, m_leastRecentlyUsed.end() };
+
+    // The level 0 tiles are pinned by never entering the eviction order
+    if(key.level > 0U)
+    {
+        m_leastRecentlyUsed.push_front(key.key());
+        tile.lruPosition = m_leastRecentlyUsed.begin();
+    }
+
+    m_residentTiles.emplace(key.key(), tile);
+}
+
+/**
+ * \brief Points the page table at the tiles requested this frame that are resident, and at nothing finer, so a
+ *        tile left over from a closer view is never drawn minified. Texels under a tile that isn't resident yet
+ *        show its finest resident requested ancestor. A layer is only rebuilt, and uploaded, when the tiles it
+ *        shows differ from the last frame's.
+ */
+void VirtualTexture::mapRequestedTiles()
+{
+    std::array<std::vector<uint64_t>, KTX_CUBE_MAP_FACES> mapped;
+    for(const auto& key : m_requests)
+    {
+        if(key.level > 0U && m_residentTiles.count(key.key()) != 0U)
+        {
+            mapped[key.face].push_back(key.key());
+        }
+    }
+
+    for(auto face = 0U; face < KTX_CUBE_MAP_FACES; ++face)
+    {
+        // Keys order by level ahead of position, so every tile is written after the ones it falls back to
+        auto& keys = mapped[face];
+        std::sort(keys.begin(), keys.end());
+        if(keys == m_mappedTiles[face])
+        {
+            continue;
+        }
+
+        writePageTable({ face, 0U, 0U, 0U });
+        for(const auto key : keys)
+        {
+            writePageTable(m_residentTiles.at(key).key);
+        }
+
+        m_mappedTiles[face] = std::move(keys);
+    }
+}
+
+/**
+ * \brief Points every page table texel under the given resident tile at it, whatever they showed before
+ */
+void VirtualTexture::writePageTable(const TileKey& key)
+{
+    const auto entry = page_table_entry(m_residentTiles.at(key.key()).slot, key.level, m_atlasTilesPerSide);
+
+    const auto size = pageTableSize();
+    const auto shift = m_finestLevel - key.level;
+    const auto span = 1U << shift;
+
+    auto* faceEntries = m_pageTableEntries.data() +
+                        (static_cast<size_t>(key.face) * size * size * RGBA8888_BYTES_PER_PIXEL);
+
+    for(auto row = key.y << shift; row < (key.y << shift) + span; ++row)
+    {
+        for(auto column = key.x << shift; column < (key.x << shift) + span; ++column)
+        {
+            auto* cell = faceEntries + ((static_cast<size_t>(row) * size + column) * RGBA8888_BYTES_PER_PIXEL);
+            std::memcpy(cell, entry.data(), entry.size());
+        }
+    }
+
+    m_pageTableFaceDirty[key.face] = true;
+}
+
+/**
+ * \brief Uploads the layers of the page table that changed since the last upload
+ */
+void VirtualTexture::uploadPageTable()
+{
+    const auto faceBytes = static_cast<size_t>(pageTableSize()) * pageTableSize() * RGBA8888_BYTES_PER_PIXEL;
+
+    for(auto face = 0U; face < KTX_CUBE_MAP_FACES; ++face)
+    {
+        if(m_pageTableFaceDirty[face])
+        {
+            m_pageTable.setData(0, face, QOpenGLTexture::RGBA_Integer, QOpenGLTexture::UInt8,
+                                m_pageTableEntries.data() + (face * faceBytes));
+            m_pageTableFaceDirty[face] = false;
+        }
+    }
+}
+
+/**
+ * \brief The atlas texture the tiles are streamed into, sampled through the page table
+ */
+const QOpenGLTexture& VirtualTexture::atlas() const
+{
+    return m_atlas;
+}
+
+/**
+ * \brief The page table texture, one layer per face
+ */
+const QOpenGLTexture& VirtualTexture::pageTable() const
+{
+    return m_pageTable;
+}
+
+/**
+ * \brief Accessor for the number of texels along each side of a tile, border excluded
+ */
+uint32_t VirtualTexture::tileSize() const
+{
+    return m_source->tileSize();
+}
+
+/**
+ * \brief Number of texels along each side of the atlas
+ */
+uint32_t VirtualTexture::atlasSize() const
+{
+    return m_atlasTilesPerSide * m_borderedTileSize;
+}
+
+/**
+ * \brief Number of texels along each side of a page table layer, one per tile of the finest level
+ */
+uint32_t VirtualTexture::pageTableSize() const
+{
+    return 1U << m_finestLevel;
+}
+
+/**
+ * \brief Number of tiles in the atlas, the pinned level 0 tiles included
+ */
+uint32_t VirtualTexture::numberOfResidentTiles() const
+{
+    return static_cast<uint32_t>(m_residentTiles.size());
+}
+
+/**
+ * \brief Cubemap face the direction points into, in the GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order. The face is
+ *        chosen by the largest component, the same way cube-map.frag picks it.
+ */
+uint32_t cubeMapFace(const QVector3D& direction)
+{
+    const auto x = qAbs(direction.x());
+    const auto y = qAbs(direction.y());
+    const auto z = qAbs(direction.z());
+
+    if(x >= y && x >= z)
+    {
+        return (direction.x() >= 0.0f) ? 0U : 1U;
+    }
+
+    if(y >= z)
+    {
+        return (direction.y() >= 0.0f) ? 2U : 3U;
+    }
+
+    return (direction.z() >= 0.0f) ? 4U : 5U;
+}
+
+/**
+ * \brief Projects the direction onto the plane of the given face and returns the s and t texture coordinates
+ *        there, between 0 and 1 for directions that point into the face. Follows the cubemap face selection
+ *        table of the OpenGL specification.
+ */
+QPointF cubeMapFaceCoordinates(const QVector3D& direction, const uint32_t face)
+{
+    auto s = 0.0f;
+    auto t = 0.0f;
+    auto majorAxis = 0.0f;
+
+    switch(face)
+    {
+    case 0U:
+        s = -direction.z();
+        t = -direction.y();
+        majorAxis = direction.x();
+        break;
+    case 1U:
+        s = direction.z();
+        t = -direction.y();
+        majorAxis = -direction.x();
+        break;
+    case 2U:
+        s = direction.x();
+        t = direction.z();
+        majorAxis = direction.y();
+        break;
+    case 3U:
+        s = direction.x();
+        t = -direction.z();
+        majorAxis = -direction.y();
+        break;
+    case 4U:
+        s = direction.x();
+        t = -direction.y();
+        majorAxis = direction.z();
+        break;
+    default:
+        s = -direction.x();
+        t = -direction.y();
+        majorAxis = -direction.z();
+        break;
+    }
+
+    majorAxis = qMax(majorAxis, std::numeric_limits<float>::min());
+
+    return QPointF(((s / majorAxis) + 1.0f) / 2.0f, ((t / majorAxis) + 1.0f) / 2.0f);
+}
@@ -0,0 +1,101 @@
+#ifndef VIRTUALTEXTURE_H
+#define VIRTUALTEXTURE_H
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <QOpenGLTexture>
+#include <QPointF>
+#include <QVector3D>
+
+#include "tilesource.h"
+
+/**
+ * \brief Streams the tiles the camera needs into a fixed-size atlas texture, so video memory stays the same
+ *        however much detail the tile source holds. The shader finds each tile through a page table, one
+ *        texture array layer per face with a texel for every tile of the finest level. Each texel holds the
+ *        atlas slot and level of the finest tile covering it that was requested this frame and is resident,
+ *        which makes a missing tile fall back to its nearest resident ancestor and keeps finer tiles left over
+ *        from earlier frames from being drawn minified. The six level 0 tiles never leave the atlas, and every
+ *        other tile is evicted least recently requested first.
+ */
+class VirtualTexture
+{
+public:
+    VirtualTexture(std::unique_ptr<TileSource> source, uint32_t atlasTilesPerSide, uint32_t uploadsPerFrame);
+    ~VirtualTexture();
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    bool create();
+    void destroy();
+
+    void beginFrame();
+    void requestArea(uint32_t face, const QPointF& minimum, const QPointF& maximum, float pixelsAcross);
+    void update();
+    bool hasPendingTiles() const;
+
+    const QOpenGLTexture& atlas() const;
+    const QOpenGLTexture& pageTable() const;
+
+    uint32_t tileSize() const;
+    uint32_t atlasSize() const;
+    uint32_t pageTableSize() const;
+    uint32_t numberOfResidentTiles() const;
+
+private:
+    struct ResidentTile
+    {
+        TileKey key;
+        uint32_t slot;
+        uint64_t lastFrameRequested;
+        std::list<uint64_t>::iterator lruPosition;
+    };
+
+    void request(const TileKey& key);
+    uint32_t allocateSlot();
+    void evict(const ResidentTile& tile);
+    void makeResident(const TileKey& key, uint32_t slot, const uint8_t* rgba, const uint8_t* halfRgba);
+    void mapRequestedTiles();
+    void writePageTable(const TileKey& key);
+    void uploadPageTable();
+
+private:
+    std::unique_ptr<TileSource> m_source;
+
+    QOpenGLTexture m_atlas;
+    QOpenGLTexture m_pageTable;
+
+    uint32_t m_atlasTilesPerSide;
+    uint32_t m_uploadsPerFrame;
+    uint32_t m_borderedTileSize;
+    uint32_t m_atlasMipLevels;
+    uint32_t m_finestLevel;
+
+    // Least recently requested tile at the back. The pinned level 0 tiles are resident but not in the list.
+    std::unordered_map<uint64_t, ResidentTile> m_residentTiles;
+    std::list<uint64_t> m_leastRecentlyUsed;
+    std::vector<uint32_t> m_freeSlots;
+
+    std::vector<TileKey> m_requests;
+    std::unordered_set<uint64_t> m_requestedKeys;
+    std::unordered_set<uint64_t> m_unavailableTiles;
+
+    // Keys of the tiles each page table layer was last built from, coarsest first
+    std::array<std::vector<uint64_t>, KTX_CUBE_MAP_FACES> m_mappedTiles;
+    std::vector<uint8_t> m_pageTableEntries;
+    std::vector<bool> m_pageTableFaceDirty;
+
+    uint64_t m_frameNumber;
+    bool m_hasPendingTiles;
+};
+
+uint32_t cubeMapFace(const QVector3D& direction);
+QPointF cubeMapFaceCoordinates(const QVector3D& direction, uint32_t face);
+
+#endif // VIRTUALTEXTURE_H